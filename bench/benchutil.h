@@ -0,0 +1,109 @@
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+#include <QFile>
+#include <QString>
+#include <QtGlobal>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+/**
+ * @brief Helpers shared by the benchmark executables
+ */
+namespace Bench
+{
+    // Peak resident set size of the process in MB, or -1 where unknown
+    inline double peakRssMegabytes()
+    {
+#if defined(Q_OS_MACOS)
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return double(usage.ru_maxrss) / (1024.0 * 1024.0);
+#elif defined(Q_OS_UNIX)
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return double(usage.ru_maxrss) / 1024.0;
+#else
+        return -1.0;
+#endif
+    }
+
+    // Value below which @p fraction of the samples fall
+    inline double percentile(std::vector<double> samples, double fraction)
+    {
+        if (samples.empty())
+            return 0.0;
+        std::size_t index = std::min(samples.size() - 1, std::size_t(fraction * double(samples.size())));
+        std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+        return samples[index];
+    }
+
+    inline void printLatencies(const char *label, const std::vector<double> &microseconds)
+    {
+        double total = 0.0;
+        for (double sample : microseconds)
+            total += sample;
+        std::printf("%s: %zu samples, mean %.2f us, p50 %.2f us, p99 %.2f us, max %.2f us\n",
+                    label, microseconds.size(), microseconds.empty() ? 0.0 : total / double(microseconds.size()),
+                    percentile(microseconds, 0.5), percentile(microseconds, 0.99),
+                    microseconds.empty() ? 0.0 : *std::max_element(microseconds.begin(), microseconds.end()));
+    }
+
+    // Code-like ASCII text of about @p characters, in lines of varying length
+    inline QString sampleText(qsizetype characters)
+    {
+        static const char *const words[] = {
+            "int", "return", "value", "index", "const", "auto", "buffer", "size",
+            "for", "while", "if", "else", "document", "line", "offset", "length",
+            "=", "+", "(", ")", "{", "}", ";", "0", "42", "\"text\"", "// note"};
+        const int wordCount = int(sizeof(words) / sizeof(words[0]));
+
+        QString text;
+        text.reserve(characters + 128);
+        quint32 seed = 0x2545F491u;
+        int lineLength = 0;
+        while (text.size() < characters)
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            text.append(QLatin1String(words[seed % wordCount]));
+            lineLength += 8;
+            if (lineLength > 40 + int(seed % 80))
+            {
+                text.append(QLatin1Char('\n'));
+                lineLength = 0;
+            }
+            else
+            {
+                text.append(QLatin1Char(' '));
+            }
+        }
+        text.truncate(characters);
+        return text;
+    }
+
+    // Writes about @p bytes of sampleText() to @p fileName in large blocks
+    inline bool writeSampleFile(const QString &fileName, qint64 bytes)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+
+        const QByteArray block = sampleText(4 * 1024 * 1024).toLatin1();
+        for (qint64 written = 0; written < bytes; written += block.size())
+        {
+            qint64 size = qMin<qint64>(block.size(), bytes - written);
+            if (file.write(block.constData(), size) != size)
+                return false;
+        }
+        return true;
+    }
+}
+
+#endif // BENCHUTIL_H
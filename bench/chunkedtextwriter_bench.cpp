@@ -0,0 +1,88 @@
+#include "benchutil.h"
+#include "filesaver.h"
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextStream>
+
+// Saves a large QTextDocument two ways: walking its blocks through the
+// fixed-size ChunkedTextWriter buffer, and the old toPlainText() copy
+// written through a QTextStream. Each way runs in a process of its own so
+// the peak RSS of one does not hide the other.
+//
+// Usage: chunkedtextwriter_bench [megabytes = 256] [blocks | plaintext]
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    const QStringList arguments = app.arguments();
+    const qint64 megabytes = arguments.value(1, QStringLiteral("256")).toLongLong();
+    const QString mode = arguments.value(2);
+
+    if (mode.isEmpty())
+    {
+        for (const QString &run : {QStringLiteral("plaintext"), QStringLiteral("blocks")})
+        {
+            QProcess process;
+            process.setProcessChannelMode(QProcess::ForwardedChannels);
+            process.start(app.applicationFilePath(), {QString::number(megabytes), run});
+            if (!process.waitForFinished(-1) || process.exitCode() != 0)
+                return 1;
+        }
+        return 0;
+    }
+
+    // Built in slices so no full-size string is alive before the save
+    QTextDocument document;
+    document.setUndoRedoEnabled(false);
+    {
+        const QString slice = Bench::sampleText(1024 * 1024);
+        QTextCursor cursor(&document);
+        for (qint64 i = 0; i < megabytes; ++i)
+        {
+            cursor.insertText(slice);
+        }
+    }
+    const double before = Bench::peakRssMegabytes();
+
+    QTemporaryDir directory;
+    const QString fileName = directory.filePath(QStringLiteral("saved.txt"));
+    QElapsedTimer timer;
+    timer.start();
+    bool saved = false;
+    if (mode == QLatin1String("blocks"))
+    {
+        FileSaver saver(fileName, &document, FileSaver::NoSync);
+        saved = saver.save();
+    }
+    else
+    {
+        QFile file(fileName);
+        if (file.open(QIODevice::WriteOnly))
+        {
+            QString text = document.toPlainText();
+            QTextStream stream(&file);
+            stream << text;
+            stream.flush();
+            saved = stream.status() == QTextStream::Ok;
+        }
+    }
+    if (!saved)
+    {
+        std::fprintf(stderr, "%s: save failed\n", qPrintable(mode));
+        return 1;
+    }
+
+    const double seconds = timer.nsecsElapsed() / 1e9;
+    const double after = Bench::peakRssMegabytes();
+    std::printf("%-9s: %lld MB document, %.0f ms, %.0f MB/s, peak RSS %.0f MB before save, %.0f MB after (+%.0f MB)\n",
+                qPrintable(mode), megabytes, seconds * 1e3, QFileInfo(fileName).size() / (1024.0 * 1024.0) / seconds,
+                before, after, after - before);
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "benchutil.h"
+#include "encodingdetector.h"
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+namespace
+{
+    // Repeats @p text up to @p bytes, cut at a character boundary
+    QByteArray repeated(const QString &text, qint64 bytes)
+    {
+        const QByteArray unit = text.toUtf8();
+        QByteArray result;
+        result.reserve(bytes);
+        while (result.size() + unit.size() <= bytes)
+        {
+            result.append(unit);
+        }
+        return result;
+    }
+
+    void measure(const char *label, const QByteArray &data, int repetitions)
+    {
+        bool valid = true;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < repetitions; ++i)
+        {
+            valid = EncodingDetector::isValidUtf8(data.constData(), data.size()) && valid;
+        }
+        const double seconds = timer.nsecsElapsed() / 1e9;
+        std::printf("%-12s %s, %.2f GB/s\n", label, valid ? "valid" : "invalid",
+                    double(data.size()) * repetitions / seconds / 1e9);
+    }
+}
+
+// Throughput of the UTF-8 validator on ASCII, mostly-ASCII and
+// mostly-multi-byte text.
+//
+// Usage: encodingdetector_bench [megabytes = 256] [repetitions = 5]
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList arguments = app.arguments();
+    const qint64 bytes = arguments.value(1, QStringLiteral("256")).toLongLong() * 1024 * 1024;
+    const int repetitions = arguments.value(2, QStringLiteral("5")).toInt();
+
+    measure("ascii", Bench::sampleText(1024 * 1024).toLatin1().repeated(int(bytes / (1024 * 1024))), repetitions);
+    measure("latin", repeated(QStringLiteral("Größenänderung für déjà-vu Straße, naïve café. "), bytes), repetitions);
+    measure("cjk", repeated(QStringLiteral("文字コードの検出と検証を行います。日本語のテキスト。"), bytes), repetitions);
+    measure("emoji", repeated(QStringLiteral("log 😀 ok 🚀 done 🎉 "), bytes), repetitions);
+    return 0;
+}
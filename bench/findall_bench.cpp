@@ -0,0 +1,98 @@
+#include "benchutil.h"
+#include "editor.h"
+#include "searchreplace.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QTextCursor>
+#include <random>
+
+namespace
+{
+    // The sample text with the needle, a word it never contains, inserted
+    // every @p spacing characters
+    QString withNeedles(const QString &base, qsizetype spacing, qsizetype &needles)
+    {
+        QString text;
+        text.reserve(base.size() + (base.size() / spacing + 1) * 8);
+        needles = 0;
+        for (qsizetype from = 0; from < base.size(); from += spacing)
+        {
+            text += QStringView(base).mid(from, spacing);
+            text += QLatin1String(" needle ");
+            ++needles;
+        }
+        return text;
+    }
+}
+
+// SearchReplace::findAll over the same text at match densities from sparse to
+// dense. The text is scanned once whatever the density, so past that fixed
+// cost the time should grow linearly with the matches, each located through
+// the piece table's line index rather than a rescan from the start of the
+// text. Edits spread the line index over many pieces first.
+//
+// Usage: findall_bench [megabytes = 16] [edits = 1000] [repetitions = 3]
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    const QStringList arguments = app.arguments();
+    const qint64 megabytes = arguments.value(1, QStringLiteral("16")).toLongLong();
+    const int edits = arguments.value(2, QStringLiteral("1000")).toInt();
+    const int repetitions = arguments.value(3, QStringLiteral("3")).toInt();
+    const qsizetype spacings[] = {1 << 20, 1 << 16, 1 << 12, 1 << 8, 1 << 6};
+
+    const QString base = Bench::sampleText(megabytes * 1024 * 1024);
+    std::printf("text: %lld MB, searching for \"needle\"\n", megabytes);
+
+    double sparsestMs = 0.0;
+    qsizetype sparsestMatches = 0;
+    for (qsizetype spacing : spacings)
+    {
+        qsizetype needles = 0;
+        Editor editor;
+        editor.loadText(withNeedles(base, spacing, needles));
+
+        // Lines inserted apart from the needles leave the match count as is
+        std::mt19937_64 random(42);
+        QTextCursor cursor(editor.document());
+        for (int i = 0; i < edits; ++i)
+        {
+            cursor.setPosition(int(random() % quint64(editor.document()->characterCount())));
+            cursor.movePosition(QTextCursor::StartOfBlock);
+            cursor.insertText(QStringLiteral("edit\n"));
+        }
+
+        SearchReplace search;
+        QVector<SearchResult> results;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < repetitions; ++i)
+        {
+            results = search.findAll(&editor, QStringLiteral("needle"), SearchReplace::CaseSensitive | SearchReplace::WholeWord);
+        }
+        const double ms = timer.nsecsElapsed() / 1e6 / repetitions;
+
+        if (results.size() != needles)
+        {
+            std::fprintf(stderr, "spacing %lld: %lld matches, expected %lld\n", qint64(spacing),
+                         qint64(results.size()), qint64(needles));
+            return 1;
+        }
+
+        if (sparsestMatches == 0)
+        {
+            sparsestMs = ms;
+            sparsestMatches = needles;
+            std::printf("%9lld matches: %9.2f ms\n", qint64(needles), ms);
+        }
+        else
+        {
+            // Time beyond the sparsest run per extra match, which stays about
+            // constant when findAll is linear in the matches
+            std::printf("%9lld matches: %9.2f ms, %.3f us per extra match\n", qint64(needles), ms,
+                        (ms - sparsestMs) * 1000.0 / double(needles - sparsestMatches));
+        }
+    }
+    return 0;
+}
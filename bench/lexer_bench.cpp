@@ -0,0 +1,142 @@
+#include "benchutil.h"
+#include "lexer.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <QStringList>
+
+namespace
+{
+    struct Rule
+    {
+        QRegularExpression pattern;
+        quint8 tokenClass;
+    };
+
+    // The C++ rules the highlighter ran before the lexer: one \bkeyword\b
+    // expression per keyword, then strings, line comments and numbers
+    QVector<Rule> regexRules()
+    {
+        const QStringList keywords = {
+            "auto", "bool", "break", "case", "catch", "char", "class", "const",
+            "continue", "default", "delete", "do", "double", "else", "enum", "explicit",
+            "extern", "false", "float", "for", "friend", "goto", "if", "inline",
+            "int", "long", "mutable", "namespace", "new", "nullptr", "operator",
+            "private", "protected", "public", "register", "return", "short", "signed",
+            "sizeof", "static", "struct", "switch", "template", "this", "throw",
+            "true", "try", "typedef", "typeid", "typename", "union", "unsigned",
+            "virtual", "void", "volatile", "wchar_t", "while"};
+
+        QVector<Rule> rules;
+        for (const QString &keyword : keywords)
+        {
+            rules.append({QRegularExpression("\\b" + keyword + "\\b"), Lexer::Keyword});
+        }
+        rules.append({QRegularExpression("\".*?\""), Lexer::String});
+        rules.append({QRegularExpression("//.*"), Lexer::Comment});
+        rules.append({QRegularExpression("\\b[0-9]+\\b"), Lexer::Number});
+        return rules;
+    }
+
+    // Stands in for setFormat(): the class of every character of the line
+    void applyFormat(QVector<quint8> &formats, qsizetype start, qsizetype length, quint8 tokenClass)
+    {
+        std::fill(formats.begin() + start, formats.begin() + start + length, tokenClass);
+    }
+
+    qint64 checksum(const QVector<quint8> &formats)
+    {
+        qint64 sum = 0;
+        for (quint8 tokenClass : formats)
+            sum += tokenClass;
+        return sum;
+    }
+}
+
+// Re-highlighting a whole C++ document, line by line as highlightBlock does,
+// with the old list of regular expressions against the one-pass lexer.
+// Formats are written to a per-line array in place of the document so only
+// the tokenizing is timed.
+//
+// Usage: lexer_bench [lines = 200000] [repetitions = 3]
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList arguments = app.arguments();
+    const int lineCount = arguments.value(1, QStringLiteral("200000")).toInt();
+    const int repetitions = arguments.value(2, QStringLiteral("3")).toInt();
+
+    // Sample lines average about 40 characters; generate some to spare
+    const QString text = Bench::sampleText(qsizetype(lineCount) * 64);
+    QVector<QStringView> lines;
+    lines.reserve(lineCount);
+    qsizetype lineStart = 0;
+    while (lines.size() < lineCount && lineStart < text.size())
+    {
+        qsizetype lineEnd = text.indexOf(QLatin1Char('\n'), lineStart);
+        if (lineEnd < 0)
+            lineEnd = text.size();
+        lines.append(QStringView(text).mid(lineStart, lineEnd - lineStart));
+        lineStart = lineEnd + 1;
+    }
+    std::printf("%lld lines, %lld characters\n", qint64(lines.size()), qint64(lineStart));
+
+    const QVector<Rule> rules = regexRules();
+    const Lexer *lexer = Lexer::cpp();
+    QVector<quint8> formats;
+    QVector<Token> tokens;
+    double regexMs = 0.0;
+    double lexerMs = 0.0;
+    qint64 regexChecksum = 0;
+    qint64 lexerChecksum = 0;
+
+    for (int i = 0; i < repetitions; ++i)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        regexChecksum = 0;
+        for (QStringView line : std::as_const(lines))
+        {
+            // highlightBlock received a QString, which globalMatch needs
+            const QString block = line.toString();
+            formats.fill(Lexer::TokenClassCount, block.size());
+            for (const Rule &rule : rules)
+            {
+                QRegularExpressionMatchIterator it = rule.pattern.globalMatch(block);
+                while (it.hasNext())
+                {
+                    QRegularExpressionMatch match = it.next();
+                    applyFormat(formats, match.capturedStart(), match.capturedLength(), rule.tokenClass);
+                }
+            }
+            regexChecksum += checksum(formats);
+        }
+        regexMs += timer.nsecsElapsed() / 1e6;
+
+        timer.restart();
+        lexerChecksum = 0;
+        int state = 0;
+        for (QStringView line : std::as_const(lines))
+        {
+            formats.fill(Lexer::TokenClassCount, line.size());
+            tokens.clear();
+            state = lexer->tokenize(line, state, tokens);
+            for (const Token &token : std::as_const(tokens))
+            {
+                applyFormat(formats, token.start, token.length, token.tokenClass);
+            }
+            lexerChecksum += checksum(formats);
+        }
+        lexerMs += timer.nsecsElapsed() / 1e6;
+    }
+    regexMs /= repetitions;
+    lexerMs /= repetitions;
+
+    std::printf("regular expressions: %.1f ms, %.2f us per line\n", regexMs, regexMs * 1000.0 / double(lines.size()));
+    std::printf("lexer:               %.1f ms, %.2f us per line (%.1fx faster)\n", lexerMs,
+                lexerMs * 1000.0 / double(lines.size()), regexMs / qMax(lexerMs, 1e-3));
+    // The two differ where the old rules were wrong, e.g. keywords in strings
+    std::printf("checksums %lld, %lld\n", regexChecksum, lexerChecksum);
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include "benchutil.h"
+#include "literalsearcher.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+
+namespace
+{
+    struct Run
+    {
+        qsizetype matches = -1;
+        double gigabytesPerSecond = 0.0;
+    };
+
+    // @p count makes one pass over the text and returns the matches found
+    template <typename Count>
+    Run measure(const QString &text, int repetitions, Count count)
+    {
+        Run run;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < repetitions; ++i)
+        {
+            run.matches = count();
+        }
+        const double seconds = timer.nsecsElapsed() / 1e9;
+        run.gigabytesPerSecond = double(text.size()) * 2.0 * repetitions / seconds / 1e9;
+        return run;
+    }
+
+    // The pattern SearchReplace::compileRegex() builds for a plain search,
+    // which every literal search went through before LiteralSearcher
+    QRegularExpression escapedRegex(const QString &needle, Qt::CaseSensitivity caseSensitivity, bool wholeWord)
+    {
+        QString pattern = QRegularExpression::escape(needle);
+        if (wholeWord)
+            pattern = QStringLiteral("\\b%1\\b").arg(pattern);
+        QRegularExpression::PatternOptions options = QRegularExpression::UseUnicodePropertiesOption;
+        if (caseSensitivity == Qt::CaseInsensitive)
+            options |= QRegularExpression::CaseInsensitiveOption;
+        return QRegularExpression(pattern, options);
+    }
+
+    bool compare(const char *label, const QString &text, const QString &needle, Qt::CaseSensitivity caseSensitivity,
+                 bool wholeWord, int repetitions)
+    {
+        // Matches do not overlap, as in find all
+        LiteralSearcher searcher(needle, caseSensitivity, wholeWord);
+        Run literal = measure(text, repetitions, [&]()
+                              {
+                                  qsizetype matches = 0;
+                                  for (qsizetype position = searcher.indexIn(text); position >= 0;
+                                       position = searcher.indexIn(text, position + searcher.length()))
+                                      ++matches;
+                                  return matches; });
+
+        const QRegularExpression regex = escapedRegex(needle, caseSensitivity, wholeWord);
+        regex.optimize();
+        Run regexRun = measure(text, repetitions, [&]()
+                               {
+                                   qsizetype matches = 0;
+                                   QRegularExpressionMatchIterator it = regex.globalMatch(text);
+                                   while (it.hasNext())
+                                   {
+                                       it.next();
+                                       ++matches;
+                                   }
+                                   return matches; });
+
+        // QStringView::indexOf has no notion of words
+        Run indexOf;
+        if (!wholeWord)
+        {
+            indexOf = measure(text, repetitions, [&]()
+                              {
+                                  qsizetype matches = 0;
+                                  for (qsizetype position = QStringView(text).indexOf(needle, 0, caseSensitivity); position >= 0;
+                                       position = QStringView(text).indexOf(needle, position + needle.size(), caseSensitivity))
+                                      ++matches;
+                                  return matches; });
+        }
+
+        std::printf("%-28s %8lld matches  LiteralSearcher %6.2f GB/s  escaped regex %6.2f GB/s (%5.1fx)",
+                    label, qint64(literal.matches), literal.gigabytesPerSecond, regexRun.gigabytesPerSecond,
+                    literal.gigabytesPerSecond / regexRun.gigabytesPerSecond);
+        if (wholeWord)
+            std::printf("\n");
+        else
+            std::printf("  indexOf %6.2f GB/s (%5.1fx)\n", indexOf.gigabytesPerSecond,
+                        literal.gigabytesPerSecond / indexOf.gigabytesPerSecond);
+
+        if (literal.matches != regexRun.matches || (!wholeWord && literal.matches != indexOf.matches))
+        {
+            std::fprintf(stderr, "%s: %lld matches against %lld (regex) and %lld (indexOf)\n", label,
+                         qint64(literal.matches), qint64(regexRun.matches), qint64(indexOf.matches));
+            return false;
+        }
+        return true;
+    }
+}
+
+// Throughput of the vectorized literal searcher against the escaped regular
+// expression that plain searches used to compile to, and against
+// QStringView::indexOf, on code-like text: frequent, rare and absent needles,
+// with and without case folding, and whole words.
+//
+// Usage: literalsearcher_bench [megabytes = 64] [repetitions = 5]
+//
+// The default keeps a run short; large files are measured on 1 GB of text,
+// which needs about 1.5 GB of memory:
+//
+//     literalsearcher_bench 1024 3
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList arguments = app.arguments();
+    const qint64 megabytes = arguments.value(1, QStringLiteral("64")).toLongLong();
+    const int repetitions = arguments.value(2, QStringLiteral("5")).toInt();
+
+    // Megabytes of UTF-16, so half as many characters
+    const QString text = Bench::sampleText(megabytes * 512 * 1024);
+
+    bool ok = true;
+    ok = compare("frequent", text, QStringLiteral("buffer"), Qt::CaseSensitive, false, repetitions) && ok;
+    ok = compare("rare", text, QStringLiteral("return document"), Qt::CaseSensitive, false, repetitions) && ok;
+    ok = compare("absent", text, QStringLiteral("nowhere"), Qt::CaseSensitive, false, repetitions) && ok;
+    ok = compare("single character", text, QStringLiteral("{"), Qt::CaseSensitive, false, repetitions) && ok;
+    ok = compare("frequent, no case", text, QStringLiteral("BUFFER"), Qt::CaseInsensitive, false, repetitions) && ok;
+    ok = compare("absent, no case", text, QStringLiteral("NOWHERE"), Qt::CaseInsensitive, false, repetitions) && ok;
+    // Every word of the sample text stands alone, so "in" is only ever found
+    // inside "int", "index" and "line" and every candidate is rejected
+    ok = compare("whole word, frequent", text, QStringLiteral("buffer"), Qt::CaseSensitive, true, repetitions) && ok;
+    ok = compare("whole word, inside words", text, QStringLiteral("in"), Qt::CaseSensitive, true, repetitions) && ok;
+    ok = compare("whole word, no case", text, QStringLiteral("RETURN"), Qt::CaseInsensitive, true, repetitions) && ok;
+    return ok ? 0 : 1;
+}
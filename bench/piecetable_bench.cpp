@@ -0,0 +1,92 @@
+#include "benchutil.h"
+#include "filesaver.h"
+#include "piecetable.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QStringDecoder>
+#include <QTemporaryDir>
+#include <random>
+
+// Opens a large file into a piece table the way the loader streams it,
+// edits it at random offsets and saves it, reporting peak RSS after each
+// phase and the latency of every edit.
+//
+// Usage: piecetable_bench [megabytes = 1024] [edits = 10000]
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList arguments = app.arguments();
+    const qint64 megabytes = arguments.value(1, QStringLiteral("1024")).toLongLong();
+    const int edits = arguments.value(2, QStringLiteral("10000")).toInt();
+    constexpr qint64 ReadChunk = 4 * 1024 * 1024;
+
+    QTemporaryDir directory;
+    const QString source = directory.filePath(QStringLiteral("source.txt"));
+    const QString target = directory.filePath(QStringLiteral("saved.txt"));
+    if (!directory.isValid() || !Bench::writeSampleFile(source, megabytes * 1024 * 1024))
+    {
+        std::fprintf(stderr, "Cannot write the sample file\n");
+        return 1;
+    }
+    std::printf("file: %lld MB, peak RSS before open %.0f MB\n", megabytes, Bench::peakRssMegabytes());
+
+    // Open
+    QElapsedTimer timer;
+    timer.start();
+    PieceTable table;
+    {
+        QFile file(source);
+        if (!file.open(QIODevice::ReadOnly))
+            return 1;
+        QStringDecoder decoder(QStringDecoder::Utf8);
+        QByteArray chunk;
+        while (!(chunk = file.read(ReadChunk)).isEmpty())
+        {
+            QString text = decoder(chunk);
+            table.appendOriginal(text);
+        }
+    }
+    std::printf("open: %.0f ms, %lld lines, peak RSS %.0f MB\n",
+                timer.nsecsElapsed() / 1e6, qint64(table.lineCount()), Bench::peakRssMegabytes());
+
+    // Edit
+    std::mt19937_64 random(42);
+    std::vector<double> editLatencies;
+    std::vector<double> lookupLatencies;
+    editLatencies.reserve(std::size_t(edits));
+    lookupLatencies.reserve(std::size_t(edits));
+    qsizetype checksum = 0;
+    for (int i = 0; i < edits; ++i)
+    {
+        qsizetype position = qsizetype(random() % quint64(table.length() + 1));
+        timer.start();
+        if (i % 2 == 0)
+            table.insert(position, u"edit\n");
+        else
+            table.remove(position, 5);
+        editLatencies.push_back(timer.nsecsElapsed() / 1e3);
+
+        timer.start();
+        checksum += table.lineStart(table.lineAt(position));
+        lookupLatencies.push_back(timer.nsecsElapsed() / 1e3);
+    }
+    Bench::printLatencies("edit", editLatencies);
+    Bench::printLatencies("line lookup", lookupLatencies);
+    std::printf("pieces: %d, table memory %.1f MB, peak RSS %.0f MB (checksum %lld)\n", table.pieceCount(),
+                table.memoryUsage() / (1024.0 * 1024.0), Bench::peakRssMegabytes(), qint64(checksum));
+
+    // Save
+    timer.start();
+    FileSaver saver(target, table.snapshot(), FileSaver::NoSync);
+    if (!saver.save())
+    {
+        std::fprintf(stderr, "save failed: %s\n", qPrintable(saver.errorString()));
+        return 1;
+    }
+    double saveMs = timer.nsecsElapsed() / 1e6;
+    std::printf("save: %.0f ms (%.0f MB/s), peak RSS %.0f MB\n", saveMs,
+                QFileInfo(target).size() / (1024.0 * 1024.0) / (saveMs / 1e3), Bench::peakRssMegabytes());
+    return 0;
+}
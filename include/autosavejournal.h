@@ -0,0 +1,115 @@
+#ifndef AUTOSAVEJOURNAL_H
+#define AUTOSAVEJOURNAL_H
+
+#include "filesaver.h"
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QByteArray>
+#include <QDateTime>
+#include <QTimer>
+#include <QThreadPool>
+#include <QLockFile>
+
+class Editor;
+class QJsonObject;
+
+/**
+ * @brief Crash-safe journal of unsaved edits
+ *
+ * Every tracked editor gets an append-only log of its text changes. Edits
+ * are serialized into memory as they happen and appended to disk when the
+ * flush timer fires, so a keystroke costs a few bytes of buffer. A journal
+ * is based on the file as last loaded or saved (or on nothing for untitled
+ * documents); once its log grows past a threshold, a snapshot of the text
+ * is written on a worker thread and a new log generation starts, so
+ * recovery reads one snapshot and replays only the tail. Journals of
+ * cleanly closed or saved documents are removed. Each editor instance holds
+ * a lock file for its session, and recovery skips journals whose session
+ * is still running, so a second instance never takes over the journals of
+ * the first.
+ */
+class AutosaveJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct RecoveredDocument
+    {
+        QString id;
+        QString fileName;
+        QString text;
+    };
+
+    explicit AutosaveJournal(const QString &directory, QObject *parent = nullptr);
+    ~AutosaveJournal();
+
+    void track(Editor *editor);
+    // Restarts the journal from the file just saved, or from a snapshot
+    // when the document was edited since
+    void rebase(Editor *editor);
+    void untrack(Editor *editor);
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled; }
+    void setFlushInterval(int ms);
+    void setFsyncPolicy(FileSaver::FsyncPolicy policy) { fsyncPolicy = policy; }
+
+    // Journals left behind by a previous session
+    QVector<RecoveredDocument> recover() const;
+    void discard(const QString &id);
+
+    static constexpr qint64 CompactThreshold = 1024 * 1024;
+
+public slots:
+    void flush();
+
+private:
+    enum BaseKind
+    {
+        EmptyBase,
+        FileBase,
+        SnapshotBase
+    };
+
+    struct Journal
+    {
+        QString id;
+        int generation = 0;
+        BaseKind base = EmptyBase;
+        QString fileName;
+        qint64 baseSize = 0;
+        QDateTime baseModified;
+        QByteArray pending;
+        qint64 logSize = 0;
+        bool started = false;
+    };
+
+    void onTextEdited(Editor *editor, int position, int charsRemoved, const QString &insertedText);
+    void resetBase(Editor *editor, Journal &journal);
+    void start(Editor *editor, Journal &journal);
+    void compact(Editor *editor, Journal &journal);
+    bool writeBaseSnapshot(Editor *editor, Journal &journal);
+    bool flushJournal(Editor *editor, Journal &journal);
+    void removeFiles(const QString &id, int belowGeneration = -1) const;
+    bool writeMeta(const Journal &journal) const;
+    bool recoverOne(const QString &id, const QJsonObject &meta, RecoveredDocument &document) const;
+
+    QString metaPath(const QString &id) const;
+    QString logPath(const QString &id, int generation) const;
+    QString snapshotPath(const QString &id, int generation) const;
+    QString lockPath(const QString &session) const;
+
+    QString journalDirectory;
+    QString sessionId;
+    QLockFile sessionLock;
+    FileSaver::FsyncPolicy fsyncPolicy;
+    QHash<Editor *, Journal> journals;
+    QTimer flushTimer;
+    bool enabled;
+    QThreadPool worker;
+};
+
+#endif // AUTOSAVEJOURNAL_H
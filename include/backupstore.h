@@ -0,0 +1,70 @@
+#ifndef BACKUPSTORE_H
+#define BACKUPSTORE_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QVector>
+#include <QThreadPool>
+#include <atomic>
+
+/**
+ * @brief Content-addressed, deduplicated store of file versions
+ *
+ * Files are cut into chunks at content-defined boundaries (a gear rolling
+ * hash), so an edit only changes the chunks around it. Each chunk is
+ * compressed and stored once under its SHA-256; a version is the ordered
+ * list of its chunk hashes, kept in a small manifest per absolute path.
+ * Backups run one at a time on a private worker thread.
+ */
+class BackupStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Version
+    {
+        QDateTime timestamp;
+        qint64 size = 0;
+        QStringList chunks;
+    };
+
+    explicit BackupStore(const QString &directory, QObject *parent = nullptr);
+    ~BackupStore();
+
+    // Queues a backup of the file as it is on disk now
+    void backupFile(const QString &fileName);
+    void waitForDone();
+
+    // Newest version first
+    QVector<Version> versions(const QString &fileName) const;
+    bool restore(const QString &fileName, int version, const QString &targetFileName) const;
+
+    void setMaxVersions(int count) { maxVersionCount.store(qMax(1, count)); }
+    int maxVersions() const { return maxVersionCount.load(); }
+
+    static constexpr qsizetype MinChunkSize = 2 * 1024;
+    static constexpr qsizetype MaxChunkSize = 64 * 1024;
+    // Tested on the high bits, which depend on the last 64 bytes; ~8 KB average
+    static constexpr quint64 ChunkMask = quint64((1u << 13) - 1) << 51;
+    static constexpr qint64 ReadBlockSize = 1024 * 1024;
+
+signals:
+    void backupFinished(const QString &fileName, bool success);
+
+private:
+    bool storeFile(const QString &fileName);
+    bool storeChunk(const QByteArray &chunk, QStringList &chunks);
+    bool writeVersions(const QString &fileName, const QVector<Version> &versions);
+    void collectGarbage();
+
+    QString manifestPath(const QString &fileName) const;
+    QString chunkPath(const QString &hash) const;
+
+    QString storeDirectory;
+    std::atomic<int> maxVersionCount;
+    QThreadPool worker;
+};
+
+#endif // BACKUPSTORE_H
@@ -0,0 +1,54 @@
+#ifndef CHUNKEDTEXTWRITER_H
+#define CHUNKEDTEXTWRITER_H
+
+#include <QStringConverter>
+#include <QStringView>
+#include <memory>
+#include <vector>
+
+class QIODevice;
+class QStringEncoder;
+
+/**
+ * @brief Encodes text through a fixed-size output buffer
+ *
+ * Text is appended piece by piece and encoded straight into one reusable
+ * buffer that is flushed to the device whenever it fills up, so writing a
+ * document never needs a second full-size copy of it. UTF-8 is encoded
+ * here directly: surrogate pairs split across two write() calls are joined
+ * and unpaired surrogates become U+FFFD. Other encodings go through a
+ * QStringEncoder into the same buffer.
+ */
+class ChunkedTextWriter
+{
+public:
+    explicit ChunkedTextWriter(QIODevice *device, qsizetype bufferSize = DefaultBufferSize);
+    ~ChunkedTextWriter();
+
+    // Call before the first write(); the byte order mark is written at once
+    void setEncoding(QStringConverter::Encoding encoding, bool byteOrderMark = false);
+
+    bool write(QStringView text);
+    bool flush();
+
+    qint64 bytesWritten() const { return totalBytes; }
+    bool hasError() const { return failed; }
+    bool hasUnencodableCharacters() const;
+
+    static constexpr qsizetype DefaultBufferSize = 256 * 1024;
+
+private:
+    void encode(char32_t codePoint);
+    bool writeEncoded(QStringView text);
+    bool flushBuffer();
+
+    QIODevice *device;
+    std::unique_ptr<QStringEncoder> encoder;
+    std::vector<char> buffer;
+    qsizetype used;
+    char16_t pendingHighSurrogate;
+    qint64 totalBytes;
+    bool failed;
+};
+
+#endif // CHUNKEDTEXTWRITER_H
@@ -1,12 +1,23 @@
-/tmp/TextEditor/run.sh#ifndef DOCUMENTMANAGER_H
+#ifndef DOCUMENTMANAGER_H
 #define DOCUMENTMANAGER_H
 
 #include <QString>
 #include <QVector>
 #include <QJsonDocument>
+#include <QHash>
+#include <QPointer>
+#include <QThreadPool>
 #include <memory>
 
+#include "filesaver.h"
+#include "backupstore.h"
+#include "autosavejournal.h"
+
 class Editor;
+class LargeFileViewer;
+class FileLoader;
+class LineEndings;
+class QThread;
 
 /**
  * @brief Manages document loading, saving, and file operations
@@ -27,7 +38,22 @@ public:
     bool saveFileAs(Editor *editor, const QString &newFileName);
     bool closeFile(Editor *editor);
 
+    // Background saving on a worker thread
+    bool saveFileAsync(Editor *editor, const QString &fileName);
+    bool isSaving(Editor *editor) const { return pendingSaves.contains(editor); }
+    void waitForPendingSaves();
+
+    // Progressive loading on a thread pool
+    bool openFileAsync(const QString &fileName, Editor *editor);
+    void cancelLoad(Editor *editor);
+    bool isLoading(Editor *editor) const { return pendingLoads.contains(editor); }
+
+    // Read-only viewer mode for huge files
+    bool openReadOnly(const QString &fileName, LargeFileViewer *viewer);
+    bool shouldOpenReadOnly(const QString &fileName) const;
+
     // File info
+    QString fileIdentity(const QString &fileName) const;
     bool fileExists(const QString &fileName) const;
     QString getFileInfo(const QString &fileName) const;
     qint64 getFileSize(const QString &fileName) const;
@@ -41,9 +67,15 @@ public:
 
     // Backup and recovery
     void createBackup(const QString &fileName);
-    QString getBackupFile(const QString &fileName) const;
+    QVector<BackupStore::Version> getBackupVersions(const QString &fileName) const;
+    bool restoreBackup(const QString &fileName, int version, const QString &targetFileName);
     bool hasBackup(const QString &fileName) const;
 
+    // Crash recovery journal
+    void trackEditor(Editor *editor);
+    QVector<AutosaveJournal::RecoveredDocument> recoverDocuments() const;
+    void discardRecoveredDocument(const QString &id);
+
     // Session management
     void saveSession(const QStringList &openFiles);
     QStringList loadSession() const;
@@ -51,8 +83,14 @@ public:
 
     // Settings
     void setMaxRecentFiles(int max) { maxRecentFiles = max; }
-    void setAutoSaveEnabled(bool enabled) { autoSaveEnabled = enabled; }
-    void setAutoSaveInterval(int ms) { autoSaveInterval = ms; }
+    void setAutoSaveEnabled(bool enabled);
+    void setAutoSaveInterval(int ms);
+    void setFsyncPolicy(FileSaver::FsyncPolicy policy);
+    FileSaver::FsyncPolicy getFsyncPolicy() const { return fsyncPolicy; }
+    void setMaxBackupVersions(int count) { backupStore->setMaxVersions(count); }
+    int getMaxBackupVersions() const { return backupStore->maxVersions(); }
+    void setLargeFileThreshold(qint64 bytes) { largeFileThreshold = bytes; }
+    qint64 getLargeFileThreshold() const { return largeFileThreshold; }
 
 signals:
     void fileOpened(const QString &fileName);
@@ -60,13 +98,27 @@ signals:
     void fileModified(const QString &fileName);
     void fileClosed(const QString &fileName);
     void recentFilesChanged();
+    void loadProgress(Editor *editor, int percent);
+    void loadFinished(Editor *editor);
+    void loadFailed(Editor *editor, const QString &errorString);
+    void loadCancelled(Editor *editor);
+    void saveProgress(Editor *editor, int percent);
+    void saveFinished(Editor *editor, const QString &fileName);
+    void saveFailed(Editor *editor, const QString &errorString);
+
+private slots:
+    void onEditorDestroyed(QObject *object);
 
 private:
-    bool readFile(const QString &fileName, QString &content) const;
-    bool writeFile(const QString &fileName, const QString &content);
+    bool readFile(const QString &fileName, QString &content, QString *encoding = nullptr, LineEndings *lineEndings = nullptr,
+                  bool *byteOrderMark = nullptr) const;
+    bool writeFile(Editor *editor, const QString &fileName);
+    void startSave(Editor *editor, const QString &fileName);
+    void finishSave(Editor *editor, const QString &fileName, int revision, bool success, const QString &errorString);
     void updateRecentFiles(const QString &fileName);
     void loadSettings();
     void saveSettings();
+    void finishLoad(Editor *editor);
 
     // File encoding helpers
     QString detectEncoding(const QString &fileName) const;
@@ -77,8 +129,20 @@ private:
     int maxRecentFiles;
     bool autoSaveEnabled;
     int autoSaveInterval;
+    qint64 largeFileThreshold;
+    FileSaver::FsyncPolicy fsyncPolicy;
     QString configDir;
     QString backupDir;
+    std::unique_ptr<BackupStore> backupStore;
+    std::unique_ptr<AutosaveJournal> journal;
+
+    // Loads in progress and the pool running them
+    QHash<Editor *, FileLoader *> pendingLoads;
+    QThreadPool loadPool;
+
+    // Saves in progress, and the latest save requested while one was running
+    QHash<Editor *, QPointer<QThread>> pendingSaves;
+    QHash<Editor *, QString> queuedSaves;
 };
 
 #endif // DOCUMENTMANAGER_H
@@ -2,18 +2,30 @@
 #define EDITOR_H
 
 #include <QPlainTextEdit>
+#include <QPair>
 #include <QVector>
+#include <functional>
 #include <memory>
 
+#include "lineendings.h"
+
 class UndoRedoStack;
 class SyntaxHighlighter;
+class PieceTable;
+class TrigramIndex;
 class QResizeEvent;
+class QTimer;
 
 /**
  * @brief Custom text editor widget with advanced features
  *
  * Extends QPlainTextEdit with line numbers, syntax highlighting,
  * undo/redo support, and other professional features.
+ *
+ * Every edit is mirrored into a PieceTable, which answers line lookups and
+ * hands out cheap snapshots for saving, searching and the autosave journal
+ * off the GUI thread. The view still lays out its own QTextDocument copy of
+ * the text, so files too large for that are opened in LargeFileViewer.
  */
 class Editor : public QPlainTextEdit
 {
@@ -29,6 +41,22 @@ public:
     QString fileExtension() const;
     bool isModified() const;
     void setModified(bool modified);
+    void loadText(const QString &text);
+    void setEncoding(const QString &encoding) { textEncoding = encoding; }
+    QString encoding() const { return textEncoding; }
+    void setByteOrderMark(bool present) { byteOrderMark = present; }
+    bool hasByteOrderMark() const { return byteOrderMark; }
+    void setLineEnding(LineEndings::Style style, bool mixed = false);
+    LineEndings::Style lineEnding() const { return lineEndingStyle; }
+    bool hasMixedLineEndings() const { return mixedLineEndings; }
+    void setLineTerminators(const LineTerminators &terminators) { mixedTerminators = terminators; }
+    const LineTerminators &lineTerminators() const { return mixedTerminators; }
+
+    // Progressive loading
+    void beginLoading();
+    void appendLoadedText(const QString &text, const QVector<qsizetype> &lineFeeds);
+    void endLoading();
+    bool isLoading() const { return loading; }
 
     // Text operations
     int lineCount() const;
@@ -53,6 +81,16 @@ public:
     void redo();
     UndoRedoStack *getUndoRedoStack() const { return undoRedoStack.get(); }
 
+    // Backing store
+    PieceTable *getPieceTable() const { return pieceTable.get(); }
+
+    // Optional trigram index narrowing searches; null while disabled. Search
+    // workers share it read-only and hand back the index they build
+    void setSearchIndexEnabled(bool enabled);
+    void setSearchIndexMemoryLimit(qint64 bytes);
+    std::shared_ptr<const TrigramIndex> getSearchIndex() const { return searchIndex; }
+    void adoptSearchIndex(const std::shared_ptr<TrigramIndex> &index);
+
     // Display options
     void setShowLineNumbers(bool show);
     bool showLineNumbers() const { return displayLineNumbers; }
@@ -65,13 +103,26 @@ public:
     bool syntaxHighlightingEnabled() const { return highlightingEnabled; }
     void updateSyntaxHighlighting();
 
-    // Search highlighting
+    // Search highlighting; only the visible lines and a page either side are
+    // asked for their matches, again whenever the view scrolls past them or
+    // the text changes. A match source returns the [start, end) ranges of the
+    // matches overlapping [from, to), in document order.
+    using MatchSource = std::function<QVector<QPair<int, int>>(int from, int to)>;
+    void setMatchSource(MatchSource source);
     void highlightOccurrences(const QString &text);
     void clearHighlights();
 
+    static constexpr int MaxHighlights = 10000;
+
     // Getters
     QPlainTextEdit::LineWrapMode wordWrapMode() const;
 
+signals:
+    // Text changes as mirrored into the piece table; textReset() means the
+    // whole text was replaced and incremental consumers must start over
+    void textEdited(int position, int charsRemoved, const QString &insertedText);
+    void textReset();
+
 protected:
     void resizeEvent(QResizeEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
@@ -83,11 +134,17 @@ private slots:
     void updateLineNumberArea(const QRect &rect, int dy);
     void onBlockCountChanged(int newBlockCount);
     void onCursorPositionChanged();
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void updateHighlights();
 
 private:
     void lineNumberAreaPaintEvent(QPaintEvent *event);
     int lineNumberAreaWidth() const;
     QString getLineText(int lineNumber) const;
+    void resyncPieceTable();
+    void invalidateSearchIndex();
+    void scheduleHighlights(bool textChanged);
+    void updateVisibleBlocks();
 
     // UI Components
     class LineNumberArea;
@@ -96,12 +153,28 @@ private:
     // Managers
     std::unique_ptr<UndoRedoStack> undoRedoStack;
     std::unique_ptr<SyntaxHighlighter> syntaxHighlighter;
+    std::unique_ptr<PieceTable> pieceTable;
+    std::shared_ptr<TrigramIndex> searchIndex;
+
+    // Search highlighting and the range its selections cover
+    MatchSource matchSource;
+    std::unique_ptr<QTimer> highlightTimer;
+    int highlightFrom;
+    int highlightTo;
+    bool highlightsStale;
 
     // State
     QString currentFileName;
+    QString textEncoding;
+    bool byteOrderMark;
+    LineEndings::Style lineEndingStyle;
+    bool mixedLineEndings;
+    LineTerminators mixedTerminators;
     int currentFontSize;
     bool displayLineNumbers;
     bool highlightingEnabled;
+    bool pieceTableSyncSuspended;
+    bool loading;
 
     friend class LineNumberArea;
 };
@@ -0,0 +1,52 @@
+#ifndef ENCODINGDETECTOR_H
+#define ENCODINGDETECTOR_H
+
+#include <QString>
+#include <QStringConverter>
+
+/**
+ * @brief Guesses the text encoding of a file from a sample of its bytes
+ *
+ * A byte order mark wins when present. Otherwise one pass over the sample
+ * validates UTF-8 and counts NUL and control bytes; the NUL positions tell
+ * UTF-16 without a BOM apart from binary data. With AVX2 the whole sample,
+ * multi-byte sequences included, is validated 32 bytes at a time; with
+ * only SSE2, pure ASCII runs are checked 16 bytes at a time and the rest
+ * byte by byte.
+ */
+class EncodingDetector
+{
+public:
+    enum Encoding
+    {
+        Utf8,
+        Utf16LE,
+        Utf16BE,
+        Utf32LE,
+        Utf32BE,
+        Latin1,
+        Binary
+    };
+
+    struct Result
+    {
+        Encoding encoding = Utf8;
+        int bomLength = 0;
+    };
+
+    // atEnd tells whether the sample reaches the end of the file, so a
+    // multi-byte sequence cut off by the sample size is not an error
+    static Result detect(const char *data, qsizetype size, bool atEnd = true);
+    static Result detectFile(const QString &fileName);
+    static bool isValidUtf8(const char *data, qsizetype size, bool atEnd = true);
+    // Whether the bytes stop inside a character, which a stateful decoder
+    // holds back waiting for the rest instead of reporting it
+    static bool endsMidCharacter(Encoding encoding, const char *data, qsizetype size);
+
+    static QString encodingName(Encoding encoding);
+    static QStringConverter::Encoding converterEncoding(Encoding encoding);
+
+    static constexpr qint64 SampleSize = 1024 * 1024;
+};
+
+#endif // ENCODINGDETECTOR_H
@@ -0,0 +1,71 @@
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QSemaphore>
+#include <atomic>
+
+#include "encodingdetector.h"
+#include "lineendings.h"
+
+/**
+ * @brief Reads and decodes a file in chunks on a worker thread
+ *
+ * The first chunk is kept small so the beginning of the file can be shown
+ * right away; later chunks are larger. Only a few decoded chunks may be in
+ * flight at once: the consumer calls chunkConsumed() after appending each
+ * one, which keeps memory bounded and the GUI event queue short. The
+ * encoding is detected from the first megabyte; binary files are refused.
+ * Line endings are normalized to '\n' and the line feed offsets of each
+ * chunk are sent along with it.
+ */
+class FileLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileLoader(const QString &fileName, QObject *parent = nullptr);
+    ~FileLoader();
+
+    QString fileName() const { return sourceFileName; }
+    QString encoding() const { return detectedEncoding; }
+    bool hasByteOrderMark() const { return byteOrderMark; }
+    const LineEndings &lineEndings() const { return detectedLineEndings; }
+
+    // Thread-safe controls
+    void cancel();
+    bool isCancelled() const { return cancelled.load(); }
+    void chunkConsumed();
+
+    // Blocking read of a whole file with the same decoding as load()
+    static bool readAll(const QString &fileName, QString &content, QString *encoding = nullptr, LineEndings *lineEndings = nullptr,
+                        bool *byteOrderMark = nullptr);
+
+    static constexpr qint64 FirstChunkSize = 64 * 1024;
+    static constexpr qint64 ChunkSize = 1024 * 1024;
+    static constexpr int MaxPendingChunks = 4;
+
+public slots:
+    void load();
+
+signals:
+    void chunkLoaded(const QString &text, const QVector<qsizetype> &lineFeeds);
+    void progress(qint64 bytesRead, qint64 totalBytes);
+    void finished();
+    void failed(const QString &errorString);
+    void aborted();
+
+private:
+    bool waitForFreeSlot();
+    static void appendTruncatedCharacter(QString &text, EncodingDetector::Encoding encoding, const QByteArray &tail);
+
+    QString sourceFileName;
+    QString detectedEncoding;
+    bool byteOrderMark;
+    LineEndings detectedLineEndings;
+    std::atomic<bool> cancelled;
+    QSemaphore freeSlots;
+};
+
+#endif // FILELOADER_H
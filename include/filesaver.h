@@ -0,0 +1,104 @@
+#ifndef FILESAVER_H
+#define FILESAVER_H
+
+#include "piecetable.h"
+#include "lineendings.h"
+
+#include <QObject>
+#include <QString>
+#include <QStringConverter>
+
+class QFile;
+class QIODevice;
+class QTextDocument;
+class ChunkedTextWriter;
+
+/**
+ * @brief Writes a document snapshot to disk with an atomic replace
+ *
+ * The text is encoded into a temporary file next to the target, flushed
+ * according to the fsync policy and then renamed over the target, so the
+ * file on disk is always either the old or the new version. A saver built
+ * from a snapshot can run on a worker thread; one built from a document
+ * walks its blocks directly and must run on the document's thread. Line
+ * feeds are written out as the configured line separator, except on lines
+ * given their own terminator, and the text in
+ * the configured encoding, with a byte order mark when asked for; a save
+ * that would lose characters the encoding cannot represent fails instead.
+ * Saving through a symlink replaces the file it points at, keeping its
+ * owner and mode; a new file gets the mode the umask allows. When no
+ * temporary file can be created next to a writable target, the target is
+ * overwritten in place instead, as QSaveFile's direct write fallback does.
+ */
+class FileSaver : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum FsyncPolicy
+    {
+        NoSync,
+        SyncFile,
+        SyncFileAndDirectory
+    };
+    Q_ENUM(FsyncPolicy)
+
+    FileSaver(const QString &fileName, const PieceTable::Snapshot &snapshot,
+              FsyncPolicy policy = SyncFile, QObject *parent = nullptr);
+    FileSaver(const QString &fileName, const QTextDocument *document,
+              FsyncPolicy policy = SyncFile, QObject *parent = nullptr);
+    ~FileSaver();
+
+    QString fileName() const { return targetFileName; }
+    QString errorString() const { return lastError; }
+    void setLineSeparator(const QString &separator) { lineSeparator = separator; }
+    void setLineTerminators(const LineTerminators &terminators) { lineTerminators = terminators; }
+    void setEncoding(QStringConverter::Encoding encoding, bool byteOrderMark = false)
+    {
+        textEncoding = encoding;
+        writeByteOrderMark = byteOrderMark;
+    }
+
+    // Forces what was written to an open file down to the disk
+    static bool syncFile(QFile &file);
+
+    static constexpr qsizetype ProgressInterval = 1024 * 1024;
+
+public slots:
+    bool save();
+
+signals:
+    void progress(qint64 charactersWritten, qint64 totalCharacters);
+    void finished(bool success, const QString &errorString);
+
+private:
+    bool fail(const QString &message);
+    bool failUnencodable();
+    bool saveInPlace(const QString &targetPath);
+    bool writeFile(QFile &file);
+    bool isEncodable();
+    bool writeContents(QIODevice &device, bool &unencodable);
+    void writeSnapshot(ChunkedTextWriter &writer, qint64 total);
+    void writeDocument(ChunkedTextWriter &writer, qint64 total);
+    void writeWithSeparators(ChunkedTextWriter &writer, QStringView text);
+    QStringView nextSeparator();
+
+    static bool copyAttributes(QFile &file, const QString &original);
+    static bool applyDefaultMode(QFile &file);
+    static bool syncDirectory(const QString &path);
+    static bool replaceFile(const QString &source, const QString &target);
+
+    QString targetFileName;
+    PieceTable::Snapshot contents;
+    const QTextDocument *document;
+    FsyncPolicy fsyncPolicy;
+    QString lineSeparator;
+    LineTerminators lineTerminators;
+    qsizetype linesWritten;
+    qsizetype nextOverride;
+    QStringConverter::Encoding textEncoding;
+    bool writeByteOrderMark;
+    QString lastError;
+};
+
+#endif // FILESAVER_H
@@ -0,0 +1,112 @@
+#ifndef FINDINFILES_H
+#define FINDINFILES_H
+
+#include "searchreplace.h"
+
+#include <QObject>
+#include <QRegularExpression>
+#include <QSemaphore>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class QDir;
+
+/**
+ * @brief One match found by FindInFiles, with the text of its line
+ */
+struct FileMatch
+{
+    int lineNumber;
+    int columnNumber;
+    int length;
+    QString lineText;
+};
+
+/**
+ * @brief Searches every text file under a directory on all cores
+ *
+ * Directories are listed and files searched as separate tasks on a thread
+ * pool, so the walk and the scans overlap. Names matching the ignore list
+ * or a .gitignore along the way are skipped, as are binary files. Each file
+ * is memory-mapped, decoded like an opened document and searched with the
+ * same rules as SearchReplace. Decoded text in flight is capped by a memory
+ * budget and the number of reported matches by MaxResults. Each search
+ * keeps its state in a block shared with its tasks, so a new search starts
+ * at once while the tasks of the one it replaces wind down. Signals come
+ * from the pool threads and carry the generation of the search they belong
+ * to, so results of a replaced search can be told apart.
+ */
+class FindInFiles : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FindInFiles(QObject *parent = nullptr);
+    ~FindInFiles();
+
+    // Cancels any running search without waiting for it; returns the new
+    // generation
+    int start(const QString &directory, const QString &searchText, SearchReplace::SearchOptions options);
+    void cancel();
+    bool isRunning() const { return current && current->pendingTasks.load() > 0; }
+
+    // Wildcard patterns matched against file and directory names
+    void setIgnoredNames(const QStringList &patterns) { ignoredNames = patterns; }
+    QStringList getIgnoredNames() const { return ignoredNames; }
+
+    static constexpr qint64 MemoryBudget = 256 * 1024 * 1024;
+    static constexpr int MaxResults = 100000;
+    static constexpr int MaxLineTextLength = 200;
+    static constexpr int ProgressInterval = 64;
+
+signals:
+    void matchesFound(int generation, const QString &fileName, const QVector<FileMatch> &matches);
+    void progress(int generation, int filesSearched);
+    void finished(int generation, int filesSearched, int totalMatches, bool truncated);
+
+private:
+    struct IgnoreRule
+    {
+        QRegularExpression pattern;
+        bool directoryOnly;
+        bool anchored;
+    };
+
+    // State of one search; the query is fixed while its tasks run
+    struct Search
+    {
+        int generation = 0;
+        QString searchText;
+        SearchReplace::SearchOptions options;
+        QRegularExpression regex;
+        std::atomic<bool> cancelled{false};
+        std::atomic<int> pendingTasks{0};
+        std::atomic<int> filesSearched{0};
+        std::atomic<int> totalMatches{0};
+        std::atomic<bool> truncated{false};
+    };
+    using SearchPointer = std::shared_ptr<Search>;
+
+    void schedule(const SearchPointer &search, std::function<void()> task);
+    void searchDirectory(const SearchPointer &search, const QString &path, const QVector<IgnoreRule> &inheritedRules);
+    void searchFile(const SearchPointer &search, const QString &fileName);
+    void scanFile(const SearchPointer &search, const QString &fileName);
+    void scanText(Search &search, const QString &text, QVector<FileMatch> &matches) const;
+    void taskDone(Search &search);
+
+    static QVector<IgnoreRule> readGitignore(const QDir &dir);
+    static IgnoreRule makeRule(const QString &pattern, bool directoryOnly, bool anchored);
+
+    QThreadPool pool;
+    QStringList ignoredNames;
+    int generation;
+    SearchPointer current;
+    QSemaphore memoryBudget;
+};
+
+#endif // FINDINFILES_H
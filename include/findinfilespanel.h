@@ -0,0 +1,66 @@
+#ifndef FINDINFILESPANEL_H
+#define FINDINFILESPANEL_H
+
+#include <QDockWidget>
+#include <memory>
+
+#include "findinfiles.h"
+
+class QLineEdit;
+class QCheckBox;
+class QPushButton;
+class QLabel;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+/**
+ * @brief Dock panel running FindInFiles and listing its matches by file
+ *
+ * Matches are added as they stream in; activating one asks the main window
+ * to open the file at that position.
+ */
+class FindInFilesPanel : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    explicit FindInFilesPanel(QWidget *parent = nullptr);
+    ~FindInFilesPanel();
+
+    void setDirectory(const QString &directory);
+    void setSearchText(const QString &text);
+
+signals:
+    void openRequested(const QString &fileName, int lineNumber, int columnNumber, int length);
+
+private slots:
+    void onSearchButtonClicked();
+    void onBrowseButtonClicked();
+    void onMatchesFound(int generation, const QString &fileName, const QVector<FileMatch> &matches);
+    void onProgress(int generation, int filesSearched);
+    void onFinished(int generation, int filesSearched, int totalMatches, bool truncated);
+    void onItemActivated(QTreeWidgetItem *item, int column);
+
+private:
+    void createUI();
+    void createConnections();
+    void setSearching(bool searching);
+
+    // UI Components
+    QLineEdit *findLineEdit;
+    QLineEdit *directoryLineEdit;
+    QPushButton *browseButton;
+    QCheckBox *caseSensitiveCheckBox;
+    QCheckBox *wholeWordCheckBox;
+    QCheckBox *regexCheckBox;
+    QPushButton *searchButton;
+    QTreeWidget *resultsTree;
+    QLabel *statusLabel;
+
+    // Engine and the generation of the search being shown
+    std::unique_ptr<FindInFiles> finder;
+    int currentGeneration;
+    int matchCount;
+};
+
+#endif // FINDINFILESPANEL_H
@@ -0,0 +1,68 @@
+#ifndef LARGEFILEVIEWER_H
+#define LARGEFILEVIEWER_H
+
+#include <QAbstractScrollArea>
+#include <QTimer>
+#include <memory>
+
+class MappedDocument;
+
+/**
+ * @brief Read-only viewer for files too large to load into an Editor
+ *
+ * Paints lines straight out of a MappedDocument, decoding only the lines
+ * inside the viewport. The line index is extended in small slices on the
+ * event loop, and the scroll range is refined as more of it becomes known.
+ * Scrolling past the indexed lines shows the estimated part of the file at
+ * once, without line numbers, until the index catches up.
+ */
+class LargeFileViewer : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit LargeFileViewer(QWidget *parent = nullptr);
+    ~LargeFileViewer();
+
+    bool openFile(const QString &fileName);
+    QString fileName() const;
+    MappedDocument *document() const { return mappedDocument.get(); }
+
+    // Navigation
+    void goToLine(qint64 line);
+    qint64 firstVisibleLine() const;
+    qint64 lineCount() const;
+
+    // Display options
+    void setFontSize(int size);
+    int fontSize() const { return currentFontSize; }
+
+signals:
+    void indexingProgress(qint64 bytesIndexed, qint64 totalBytes);
+    void indexingFinished(qint64 lineCount);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private slots:
+    void indexNextSlice();
+
+private:
+    void updateScrollRanges();
+    int visibleLineCount() const;
+    int gutterWidth() const;
+
+    std::unique_ptr<MappedDocument> mappedDocument;
+    QTimer indexTimer;
+    int currentFontSize;
+    int widestLine;
+
+    // Line asked for by goToLine() before the index reached it, or -1
+    qint64 pendingLine;
+};
+
+#endif // LARGEFILEVIEWER_H
@@ -0,0 +1,58 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <QStringView>
+#include <QVector>
+
+/**
+ * @brief Run of characters of one token class within a line
+ */
+struct Token
+{
+    int start;
+    int length;
+    quint8 tokenClass;
+};
+
+/**
+ * @brief Splits a line of source text into classified tokens in one pass
+ *
+ * Identifiers are scanned once and looked up in a keyword table hashed at
+ * compile time; strings, comments and numbers are recognised in the same
+ * pass. Only classified runs are reported; everything else is plain text.
+ *
+ * Each lexer is a small state machine. The state a line ends in, such as
+ * inside a block comment or a triple-quoted string, is where the next line
+ * starts; every line of a document starts from state 0 when it is the
+ * first. Lexers hold no mutable state, so the shared instances may be used
+ * from any thread.
+ */
+class Lexer
+{
+public:
+    enum TokenClass : quint8
+    {
+        Keyword,
+        String,
+        Comment,
+        Number,
+        TokenClassCount
+    };
+
+    virtual ~Lexer() = default;
+
+    // Appends the tokens of @p text and returns the state the next line
+    // starts in
+    virtual int tokenize(QStringView text, int state, QVector<Token> &tokens) const = 0;
+
+    // Shared lexers of the supported languages
+    static const Lexer *cpp();
+    static const Lexer *python();
+    static const Lexer *javaScript();
+    static const Lexer *json();
+    static const Lexer *sql();
+    static const Lexer *markup();
+    static const Lexer *css();
+};
+
+#endif // LEXER_H
@@ -0,0 +1,88 @@
+#ifndef LINEENDINGS_H
+#define LINEENDINGS_H
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Detects and normalizes the line endings of text read from a file
+ *
+ * Documents always hold '\n' internally. normalize() converts CRLF and lone
+ * CR to LF in place while counting each kind and, in the same pass, records
+ * where the resulting line feeds are, so callers do not have to scan for
+ * them again. It can be fed a file chunk by chunk: a CR ending one chunk
+ * pairs with a LF starting the next. Runs of consecutive lines ending in
+ * the same style are recorded so mixed files can be written back as read.
+ */
+class LineEndings
+{
+public:
+    enum Style
+    {
+        LF,
+        CRLF,
+        CR
+    };
+
+    // Lines from @c line up to the next run all end in @c style
+    struct Run
+    {
+        qsizetype line;
+        Style style;
+    };
+
+    LineEndings();
+
+    void normalize(QString &text, QVector<qsizetype> *lineFeeds = nullptr);
+
+    qsizetype count(Style style) const { return counts[style]; }
+    qsizetype lineBreaks() const { return breaks; }
+    Style dominant() const;
+    bool isMixed() const;
+    const QVector<Run> &runs() const { return styleRuns; }
+
+    static QString separator(Style style);
+    static QString name(Style style);
+    static Style nativeStyle();
+
+private:
+    void addBreak(Style style);
+
+    qsizetype counts[3];
+    qsizetype breaks;
+    QVector<Run> styleRuns;
+    bool pendingCarriageReturn;
+};
+
+/**
+ * @brief The lines of a mixed-ending document that end differently
+ *
+ * Only lines whose terminator differs from the dominant style are kept,
+ * by line number, and shifted as edits add and remove lines, so a save
+ * writes every untouched line back with the terminator it was read with.
+ * Line breaks typed by the user take the dominant style.
+ */
+class LineTerminators
+{
+public:
+    struct Override
+    {
+        qsizetype line;
+        LineEndings::Style style;
+    };
+
+    LineTerminators() = default;
+    explicit LineTerminators(const LineEndings &lineEndings);
+
+    bool isEmpty() const { return overrides.isEmpty(); }
+    const QVector<Override> &lines() const { return overrides; }
+
+    // Lines line..line+removed were replaced by lines line..line+added; the
+    // last of them keeps the terminator the old last line had
+    void linesChanged(qsizetype line, qsizetype removed, qsizetype added);
+
+private:
+    QVector<Override> overrides;
+};
+
+#endif // LINEENDINGS_H
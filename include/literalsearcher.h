@@ -0,0 +1,48 @@
+#ifndef LITERALSEARCHER_H
+#define LITERALSEARCHER_H
+
+#include <QString>
+#include <QStringView>
+
+/**
+ * @brief Finds a plain string in UTF-16 text without going through a regex
+ *
+ * Candidates are found by comparing the first and the last character of the
+ * needle against 8 or 16 positions at once with SSE2 or AVX2, and only the
+ * positions where both agree are verified with memcmp. Case-insensitive
+ * search folds ASCII in the same filter; needles with other characters fall
+ * back to QStringView's Unicode case folding. Whole-word matching checks the
+ * same boundaries as \b in a regular expression.
+ */
+class LiteralSearcher
+{
+public:
+    explicit LiteralSearcher(const QString &needle, Qt::CaseSensitivity caseSensitivity = Qt::CaseSensitive,
+                             bool wholeWord = false);
+
+    // Only matches starting before @p to are reported; -1 means the end
+    qsizetype indexIn(QStringView text, qsizetype from = 0, qsizetype to = -1) const;
+    qsizetype length() const { return needle.size(); }
+    bool isEmpty() const { return needle.isEmpty(); }
+
+    static bool isWordCharacter(QChar c) { return c.isLetterOrNumber() || c == QLatin1Char('_'); }
+
+private:
+    qsizetype findCandidate(QStringView text, qsizetype from, qsizetype to) const;
+    qsizetype scanScalar(const char16_t *text, qsizetype from, qsizetype end) const;
+    bool verify(const char16_t *candidate) const;
+    bool isWholeWord(QStringView text, qsizetype position) const;
+
+    QString needle;
+    Qt::CaseSensitivity caseSensitivity;
+    bool wholeWord;
+    bool unicodeFallback;
+
+    // Needle folded to lower case when ASCII folding applies, and the bits
+    // OR-ed into the first and last text character before comparing them
+    QString folded;
+    char16_t firstFold;
+    char16_t lastFold;
+};
+
+#endif // LITERALSEARCHER_H
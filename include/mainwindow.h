@@ -3,16 +3,21 @@
 
 #include <QMainWindow>
 #include <QMap>
+#include <QHash>
 #include <memory>
 
 class Editor;
 class DocumentManager;
 class SearchReplace;
+class FindInFilesPanel;
+class SearchReplaceDialog;
+struct SearchResult;
 class QTabWidget;
 class QToolBar;
 class QStatusBar;
 class QAction;
 class QMenu;
+class QLabel;
 
 /**
  * @brief Main application window for the text editor
@@ -28,6 +33,8 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    void openFiles(const QStringList &fileNames);
+
 protected:
     void closeEvent(QCloseEvent *event) override;
     void dragEnterEvent(QDragEnterEvent *event) override;
@@ -37,7 +44,9 @@ private slots:
     // File operations
     void newFile();
     void openFile();
+    void openReadOnlyFile();
     void openRecent();
+    void cancelLoading();
     void saveFile();
     void saveAsFile();
     void saveAllFiles();
@@ -67,6 +76,9 @@ private slots:
     void openReplaceDialog();
     void findNext();
     void findPrevious();
+    void openFindInFiles();
+    void openSearchHit(const QString &fileName, int lineNumber, int columnNumber, int length);
+    void toggleSearchIndex();
 
     // Help operations
     void showAbout();
@@ -76,6 +88,15 @@ private slots:
     void onTabChanged(int index);
     void onTabCloseRequested(int index);
     void onDocumentModified();
+    void onLoadProgress(Editor *editor, int percent);
+    void onLoadFinished(Editor *editor);
+    void onLoadFailed(Editor *editor, const QString &errorString);
+    void onLoadCancelled(Editor *editor);
+    void onSaveProgress(Editor *editor, int percent);
+    void onSaveFinished(Editor *editor, const QString &fileName);
+    void onSaveFailed(Editor *editor, const QString &errorString);
+    void recoverDocuments();
+    void showOpenFailures();
 
 private:
     void createMenuBar();
@@ -87,6 +108,15 @@ private:
     void loadRecentFiles();
     bool maybeSave();
     bool maybeSaveAll();
+    bool openPath(const QString &fileName, bool readOnly);
+    void reportOpenFailure(const QString &fileName, const QString &reason);
+    bool saveEditor(Editor *editor, bool wait);
+    bool saveEditorAs(Editor *editor, bool wait);
+    void updateTabTitle(Editor *editor, const QString &status = QString());
+    int findTab(const QString &fileName) const;
+    void goToMatch(Editor *editor, int lineNumber, int columnNumber, int length);
+    void applySearchIndex(Editor *editor);
+    void selectMatch(const SearchResult &result);
     Editor *currentEditor() const;
 
     // UI Components
@@ -94,6 +124,7 @@ private:
     QToolBar *fileToolBar;
     QToolBar *editToolBar;
     QToolBar *searchToolBar;
+    QLabel *matchCountLabel;
 
     // Menus
     QMenu *fileMenu;
@@ -106,6 +137,8 @@ private:
     // Actions
     QAction *newAction;
     QAction *openAction;
+    QAction *openReadOnlyAction;
+    QAction *cancelLoadAction;
     QAction *saveAction;
     QAction *saveAsAction;
     QAction *saveAllAction;
@@ -124,12 +157,18 @@ private:
     QAction *replaceAction;
     QAction *findNextAction;
     QAction *findPrevAction;
+    QAction *findInFilesAction;
+    QAction *searchIndexAction;
 
     QAction *lineNumbersAction;
     QAction *wordWrapAction;
     QAction *increaseFontAction;
     QAction *decreaseFontAction;
 
+    // Docks and dialogs
+    FindInFilesPanel *findInFilesPanel;
+    SearchReplaceDialog *searchDialog;
+
     // Managers
     std::unique_ptr<DocumentManager> documentManager;
     std::unique_ptr<SearchReplace> searchReplace;
@@ -138,6 +177,19 @@ private:
     QStringList recentFiles;
     int currentFontSize;
     QString currentTheme;
+    qint64 searchIndexMemoryLimit;
+
+    // Open failures waiting to be reported together
+    QStringList openFailures;
+
+    // Search hits to show once their file has finished loading
+    struct PendingNavigation
+    {
+        int lineNumber;
+        int columnNumber;
+        int length;
+    };
+    QHash<Editor *, PendingNavigation> pendingNavigation;
 };
 
 #endif // MAINWINDOW_H
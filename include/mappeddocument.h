@@ -0,0 +1,77 @@
+#ifndef MAPPEDDOCUMENT_H
+#define MAPPEDDOCUMENT_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Read-only, memory-mapped view of a text file
+ *
+ * Opening only maps the file, so it takes the same time whatever the size.
+ * Line starts are discovered lazily, either on demand or in bounded
+ * increments driven by the caller, and only one checkpoint offset is kept
+ * per CheckpointInterval lines. Lines are decoded one at a time when asked
+ * for, so memory stays bounded by the index plus what is being displayed.
+ *
+ * Nothing blocks on the index: lines past it are reached by byte offset,
+ * from an estimate resynced on the next line start. A file truncated while
+ * mapped, such as a log rotated by copytruncate, must be noticed through
+ * refreshSize() before reading, since pages past its end fault.
+ */
+class MappedDocument
+{
+public:
+    explicit MappedDocument(const QString &fileName);
+    ~MappedDocument();
+
+    bool open();
+    void close();
+    bool isOpen() const { return data != nullptr || (file.isOpen() && fileSize == 0); }
+
+    QString fileName() const { return file.fileName(); }
+    qint64 size() const { return fileSize; }
+
+    // Line index
+    bool isFullyIndexed() const { return indexedBytes >= fileSize; }
+    qint64 indexedBytesCount() const { return indexedBytes; }
+    qint64 knownLineCount() const { return lineStartsFound; }
+    qint64 estimatedLineCount() const;
+    bool isLineIndexed(qint64 line) const { return line < lineStartsFound; }
+    bool indexMore(qint64 maxBytes);
+
+    // Follows a truncation of the file; true when the size changed
+    bool refreshSize();
+
+    // Line access by number, for indexed lines only; -1 otherwise
+    qint64 lineOffset(qint64 line) const;
+    QString lineText(qint64 line, int maxLength = MaxDecodedLineLength) const;
+
+    // Line access by byte offset
+    qint64 approximateOffset(qint64 line) const;
+    qint64 nextLineStart(qint64 offset) const;
+    qint64 lineStartBefore(qint64 offset, int lines) const;
+    bool startsLine(qint64 offset) const { return offset <= 0 || (offset <= fileSize && data[offset - 1] == '\n'); }
+    // Decodes the line at @p offset and returns where the next one starts;
+    // a line longer than the decode window continues from there
+    qint64 readLine(qint64 offset, QString &text, int maxLength = MaxDecodedLineLength) const;
+
+    qint64 memoryUsage() const;
+
+    static constexpr int CheckpointInterval = 64;
+    static constexpr int MaxDecodedLineLength = 64 * 1024;
+
+private:
+    void releaseScannedPages(qint64 from, qint64 to) const;
+
+    QFile file;
+    const uchar *data;
+    qint64 fileSize;
+
+    // Offsets of every CheckpointInterval-th line start
+    QVector<qint64> checkpoints;
+    qint64 lineStartsFound;
+    qint64 indexedBytes;
+};
+
+#endif // MAPPEDDOCUMENT_H
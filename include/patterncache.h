@@ -0,0 +1,49 @@
+#ifndef PATTERNCACHE_H
+#define PATTERNCACHE_H
+
+#include <QCache>
+#include <QMutex>
+#include <QPair>
+#include <QRegularExpression>
+#include <QString>
+
+/**
+ * @brief Process-wide LRU cache of compiled regular expressions
+ *
+ * QRegularExpression compiles its pattern, and JIT-compiles it on first
+ * use, for every new instance. The cache hands out copies of one already
+ * optimized instance per pattern and option set; copies share the compiled
+ * code, so repeated searches and highlighting rules skip the compile. It is
+ * shared by search and highlighting and may be used from any thread.
+ */
+class PatternCache
+{
+public:
+    static PatternCache &instance();
+
+    QRegularExpression pattern(const QString &pattern,
+                               QRegularExpression::PatternOptions options = QRegularExpression::NoPatternOption);
+
+    void setCapacity(int count);
+    int capacity() const;
+    void clear();
+
+    // Statistics
+    qint64 hits() const;
+    qint64 misses() const;
+    void resetStatistics();
+
+    static constexpr int DefaultCapacity = 64;
+
+private:
+    PatternCache();
+
+    using Key = QPair<QString, int>;
+
+    mutable QMutex mutex;
+    QCache<Key, QRegularExpression> patterns;
+    qint64 hitCount;
+    qint64 missCount;
+};
+
+#endif // PATTERNCACHE_H
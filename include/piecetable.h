@@ -0,0 +1,171 @@
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <vector>
+
+/**
+ * @brief Piece-table text storage with a balanced piece tree
+ *
+ * Text is kept in two buffers: the read-only original buffer holding the
+ * file as loaded, and an append-only buffer receiving every insertion.
+ * The document is a sequence of pieces referencing ranges of those buffers,
+ * stored in a treap ordered by document position. Each node caches the
+ * length and line feed count of its subtree, so inserts, removals and
+ * offset/line conversions are O(log n) and memory grows with the edits,
+ * not with the size of the file.
+ */
+class PieceTable
+{
+public:
+    /**
+     * @brief Immutable view of the text at one point in time
+     *
+     * The buffers are implicitly shared, so taking a snapshot only copies
+     * the list of pieces. It can be read from any thread.
+     */
+    class Snapshot
+    {
+    public:
+        qsizetype length() const { return totalLength; }
+        QString toString() const;
+
+        template <typename Visitor>
+        void forEachChunk(Visitor visit) const
+        {
+            for (const Span &span : spans)
+            {
+                QStringView buffer(span.added ? addedBuffer : originalBuffer);
+                visit(buffer.mid(span.start, span.length));
+            }
+        }
+
+    private:
+        friend class PieceTable;
+
+        struct Span
+        {
+            qsizetype start;
+            qsizetype length;
+            bool added;
+        };
+
+        QString originalBuffer;
+        QString addedBuffer;
+        QVector<Span> spans;
+        qsizetype totalLength = 0;
+    };
+
+    PieceTable();
+    explicit PieceTable(const QString &original);
+
+    // Content
+    void setOriginal(const QString &text);
+    void clear();
+    void insert(qsizetype position, QStringView text);
+    void appendOriginal(QStringView text);
+    void appendOriginal(QStringView text, const QVector<qsizetype> &lineFeeds);
+    void remove(qsizetype position, qsizetype length);
+
+    // Queries
+    qsizetype length() const { return subtreeLength(root); }
+    bool isEmpty() const { return length() == 0; }
+    qsizetype lineCount() const { return subtreeLineFeeds(root) + 1; }
+    qsizetype lineStart(qsizetype line) const;
+    qsizetype lineAt(qsizetype position) const;
+    QChar at(qsizetype position) const;
+    QString text() const { return text(0, length()); }
+    QString text(qsizetype position, qsizetype length) const;
+    QString lineText(qsizetype line) const;
+    Snapshot snapshot() const;
+
+    // Statistics
+    int pieceCount() const { return static_cast<int>(nodes.size()) - static_cast<int>(freeNodes.size()); }
+    qint64 memoryUsage() const;
+
+    /**
+     * @brief Calls @p visit with every stored chunk overlapping the range, in order
+     */
+    template <typename Visitor>
+    void forEachChunk(qsizetype position, qsizetype length, Visitor visit) const
+    {
+        visitRange(root, 0, position, position + length, visit);
+    }
+
+private:
+    enum BufferKind : quint8
+    {
+        Original,
+        Added
+    };
+
+    struct Node
+    {
+        qsizetype start;
+        qsizetype length;
+        qsizetype lineFeeds;
+        qsizetype subtreeLength;
+        qsizetype subtreeLineFeeds;
+        quint32 priority;
+        int left;
+        int right;
+        BufferKind buffer;
+    };
+
+    int newNode(BufferKind buffer, qsizetype start, qsizetype length);
+    void freeSubtree(int node);
+    void update(int node);
+    void split(int node, qsizetype position, int &left, int &right);
+    int merge(int left, int right);
+    void collectSpans(int node, QVector<Snapshot::Span> &spans) const;
+    bool extendLastPiece(int node, BufferKind buffer, qsizetype start, qsizetype length, qsizetype lineFeeds);
+
+    qsizetype subtreeLength(int node) const { return node < 0 ? 0 : nodes[node].subtreeLength; }
+    qsizetype subtreeLineFeeds(int node) const { return node < 0 ? 0 : nodes[node].subtreeLineFeeds; }
+    const QString &bufferText(BufferKind buffer) const { return buffer == Original ? originalBuffer : addedBuffer; }
+    const QVector<qsizetype> &bufferLineFeeds(BufferKind buffer) const { return buffer == Original ? originalLineFeeds : addedLineFeeds; }
+    qsizetype countLineFeeds(BufferKind buffer, qsizetype start, qsizetype end) const;
+    quint32 nextPriority();
+
+    template <typename Visitor>
+    void visitRange(int node, qsizetype offset, qsizetype from, qsizetype to, Visitor &visit) const
+    {
+        if (node < 0 || from >= to)
+            return;
+
+        const Node &n = nodes[node];
+        qsizetype leftLength = subtreeLength(n.left);
+        qsizetype pieceBegin = offset + leftLength;
+        qsizetype pieceEnd = pieceBegin + n.length;
+
+        if (from < pieceBegin)
+            visitRange(n.left, offset, from, to, visit);
+
+        qsizetype begin = qMax(from, pieceBegin);
+        qsizetype end = qMin(to, pieceEnd);
+        if (begin < end)
+        {
+            QStringView view(bufferText(n.buffer));
+            visit(view.mid(n.start + (begin - pieceBegin), end - begin));
+        }
+
+        if (to > pieceEnd)
+            visitRange(n.right, pieceEnd, from, to, visit);
+    }
+
+    // Buffers and the offsets of their line feeds
+    QString originalBuffer;
+    QString addedBuffer;
+    QVector<qsizetype> originalLineFeeds;
+    QVector<qsizetype> addedLineFeeds;
+
+    // Piece tree
+    std::vector<Node> nodes;
+    QVector<int> freeNodes;
+    int root;
+    quint32 seed;
+};
+
+#endif // PIECETABLE_H
@@ -5,13 +5,19 @@
 #include <QTextDocument>
 #include <QVector>
 #include <QDialog>
+#include <QRegularExpression>
+#include <QPointer>
+#include <QThreadPool>
 #include <memory>
 
 class Editor;
+class SearchWorker;
+class TrigramIndex;
 class QLineEdit;
 class QCheckBox;
 class QPushButton;
 class QComboBox;
+class QTimer;
 
 /**
  * @brief Search and replace result item
@@ -20,6 +26,7 @@ struct SearchResult
 {
     int lineNumber;
     int columnNumber;
+    // Left empty in the cached matches of a background search
     QString matchedText;
     int startPosition;
     int endPosition;
@@ -30,6 +37,16 @@ struct SearchResult
  *
  * Provides efficient text search with various options including
  * regular expressions, case sensitivity, and whole word matching.
+ * find(), findNext() and findPrevious() scan a snapshot of the document
+ * on a worker thread and report matches as they stream in. The finished
+ * match set stays cached for its editor, query and options; an edit only
+ * rescans the lines it touched. Until the cache can answer, find next and
+ * find previous scan directly from the cursor. Editors with a search index
+ * only search the lines it names as candidates; the worker builds the index
+ * on the first query and hands it back to the editor.
+ * Highlighted matches are taken from the cache around the viewport only.
+ * An incremental search whose query extends the cached one filters the
+ * cached matches instead of scanning again.
  */
 class SearchReplace : public QObject
 {
@@ -53,6 +70,7 @@ public:
     bool find(Editor *editor, const QString &searchText, SearchOptions options = {});
     bool findNext(Editor *editor);
     bool findPrevious(Editor *editor);
+    bool findIncremental(Editor *editor, const QString &searchText, SearchOptions options = {});
     bool replace(Editor *editor, const QString &searchText, const QString &replaceText, SearchOptions options = {});
     int replaceAll(Editor *editor, const QString &searchText, const QString &replaceText, SearchOptions options = {});
 
@@ -71,16 +89,47 @@ public:
     void highlightMatches(Editor *editor, const QString &searchText);
     void clearHighlights(Editor *editor);
 
+    // Regex for a query, from the shared compiled pattern cache
+    static QRegularExpression compileRegex(const QString &searchText, SearchOptions options);
+
+    static constexpr qsizetype DirectScanWindow = 256 * 1024;
+
 signals:
     void matchFound(const SearchResult &result);
     void noMatchFound();
     void matchesUpdated(int totalMatches);
     void replacementMade(int replacements);
 
+private slots:
+    void onResultsReady(int generation, const QVector<SearchResult> &results);
+    void onSearchFinished(int generation, int total);
+    void onIndexBuilt(int generation, const std::shared_ptr<TrigramIndex> &index);
+    void onDocumentEdited(int position, int charsRemoved, const QString &insertedText);
+    void onDocumentReset();
+
 private:
+    // Move waiting for the background scan to reach the match it needs
+    enum PendingMove
+    {
+        NoMove,
+        FirstMatch,
+        NextMatch,
+        PreviousMatch
+    };
+
+    void startSearch(Editor *editor);
+    void cancelSearch();
+    void requestMove(Editor *editor, PendingMove move);
+    void resolvePendingMove();
+    bool scanFromCursor(Editor *editor, PendingMove move);
+    void selectResult(const SearchResult &result);
+    QVector<SearchResult> searchRange(Editor *editor, qsizetype start, qsizetype end) const;
+    QVector<QPair<int, int>> matchesInRange(Editor *editor, int from, int to) const;
+    bool canRefine(Editor *editor, const QString &searchText, SearchOptions options) const;
+    void refineMatches(const QString &searchText);
+    static bool findIndexed(Editor *editor, const QString &searchText, SearchOptions options, QVector<SearchResult> &results);
     SearchResult performSearch(Editor *editor, const QString &searchText, int startPosition);
     bool validateRegex(const QString &pattern) const;
-    QString escapeRegexSpecialChars(const QString &text) const;
 
     Editor *currentEditor;
     SearchOptions searchOptions;
@@ -89,11 +138,32 @@ private:
     int currentMatchIndex;
     QString lastSearchText;
 
+    // Background scan of searchEditor and the matches it has sent so far,
+    // kept for the query and options it was started with
+    QThreadPool searchPool;
+    QPointer<Editor> searchEditor;
+    QPointer<SearchWorker> activeSearch;
+    int searchGeneration;
+    QString cachedSearchText;
+    SearchOptions cachedOptions;
+    qsizetype cachedLineCount;
+    QVector<SearchResult> matches;
+    bool searchComplete;
+    bool replacingAll;
+    PendingMove pendingMove;
+    int pendingPosition;
+
+    // Editor painting the matches of the cached query around its viewport
+    QPointer<Editor> highlightEditor;
+
     friend class SearchReplaceDialog;
 };
 
 /**
  * @brief Find and Replace dialog
+ *
+ * Searches as the user types once the input has been idle for SearchDelay;
+ * toggling an option searches again right away.
  */
 class SearchReplaceDialog : public QDialog
 {
@@ -106,6 +176,8 @@ public:
     void setSearchManager(SearchReplace *manager) { searchManager = manager; }
     void setEditor(Editor *editor) { currentEditor = editor; }
 
+    static constexpr int SearchDelay = 150;
+
 protected:
     void closeEvent(QCloseEvent *event) override;
 
@@ -116,10 +188,12 @@ private slots:
     void onCaseSensitiveToggled(bool checked);
     void onWholeWordToggled(bool checked);
     void onRegexToggled(bool checked);
+    void searchAsYouType();
 
 private:
     void createUI();
     void createConnections();
+    SearchReplace::SearchOptions currentOptions() const;
 
     // UI Components
     QLineEdit *findLineEdit;
@@ -131,10 +205,11 @@ private:
     QPushButton *replaceButton;
     QPushButton *replaceAllButton;
     QPushButton *closeButton;
+    QTimer *searchTimer;
 
     // Managers
     SearchReplace *searchManager;
-    Editor *currentEditor;
+    QPointer<Editor> currentEditor;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(SearchReplace::SearchOptions)
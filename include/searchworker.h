@@ -0,0 +1,84 @@
+#ifndef SEARCHWORKER_H
+#define SEARCHWORKER_H
+
+#include "piecetable.h"
+#include "searchreplace.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+class QRegularExpression;
+class TrigramIndex;
+
+/**
+ * @brief Scans a document snapshot for one query on a worker thread
+ *
+ * Matches are sent in position order and in batches: the first match goes
+ * out on its own so it can be shown right away, later ones are grouped so
+ * the receiving thread handles at most a few batches per frame. The text
+ * is scanned one slice at a time so cancel() takes effect quickly; a regex
+ * match that may run past the end of a slice widens it and is retried.
+ * Every signal carries the generation the worker was started with, letting
+ * the receiver drop results from a search it has since replaced.
+ *
+ * Given a search index, the worker builds it from the snapshot if needed,
+ * hands the built index back through indexBuilt(), and scans only the
+ * candidate lines; when they make up most of the document the full scan is
+ * cheaper and runs instead.
+ */
+class SearchWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    SearchWorker(const PieceTable::Snapshot &snapshot, const QString &searchText,
+                 SearchReplace::SearchOptions options, int generation, QObject *parent = nullptr);
+    ~SearchWorker();
+
+    // Thread-safe controls
+    void cancel();
+    bool isCancelled() const { return cancelled.load(); }
+
+    // Set before run(); the worker only reads an index that is already built
+    void setSearchIndex(const std::shared_ptr<const TrigramIndex> &index) { searchIndex = index; }
+
+    static constexpr qsizetype SliceSize = 1024 * 1024;
+    static constexpr int BatchInterval = 16;
+    static constexpr int MaxBatchSize = 4096;
+
+public slots:
+    void run();
+
+signals:
+    void resultsReady(int generation, const QVector<SearchResult> &results);
+    void finished(int generation, int totalMatches);
+    void indexBuilt(int generation, const std::shared_ptr<TrigramIndex> &index);
+
+private:
+    bool scanIndexed(const QRegularExpression &regex, const QString &text);
+    void scanRegex(const QRegularExpression &regex, const QString &text);
+    void scanLiteral(const QString &text);
+    void addMatch(const QString &text, qsizetype start, qsizetype end);
+    void flushBatch();
+
+    PieceTable::Snapshot contents;
+    QString searchText;
+    SearchReplace::SearchOptions options;
+    int generation;
+    std::atomic<bool> cancelled;
+    std::shared_ptr<const TrigramIndex> searchIndex;
+
+    // Scan state: the pending batch and the line the sweep has reached
+    QVector<SearchResult> batch;
+    QElapsedTimer batchTimer;
+    int totalMatches;
+    qsizetype sweepPosition;
+    qsizetype sweepLine;
+    qsizetype sweepLineStart;
+};
+
+#endif // SEARCHWORKER_H
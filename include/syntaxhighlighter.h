@@ -3,12 +3,20 @@
 
 #include <QSyntaxHighlighter>
 #include <QTextDocument>
-#include <QHash>
 #include <QTextCharFormat>
 #include <QVector>
 #include <QRegularExpression>
+#include <QPointer>
+#include <QThreadPool>
+#include <array>
+#include <memory>
+
+#include "lexer.h"
+#include "tokenizerworker.h"
 
 class Editor;
+class QElapsedTimer;
+class QTimer;
 
 /**
  * @brief Syntax highlighting rule definition
@@ -24,6 +32,29 @@ struct HighlightingRule
  *
  * Supports C++, Python, JavaScript, JSON, XML, and more.
  * Extensible architecture for adding new languages.
+ *
+ * Each language is tokenized by a Lexer in a single pass per block and
+ * each token class is mapped to the theme format.
+ *
+ * Tokenizing is split from applying formats. A TokenizerWorker lexes
+ * snapshots of block text on a pool thread, and the tokens and lexer
+ * states of every block are cached in its user data. highlightBlock() only
+ * maps the cached tokens of a block to formats. An edit marks the blocks
+ * it touched stale and results that arrive for them are dropped. Small
+ * edits are lexed in place so typing shows the right colours at once; if
+ * their end state changed, the blocks below go back to the worker. Its
+ * results are kept only up to the first block whose cached tokens were
+ * lexed from the same start state; from there the cache is still valid
+ * and those blocks keep their tokens and formats.
+ *
+ * Highlighting is lazy: changing the language, theme or rules only marks
+ * the document stale. Slices of at most FrameBudget milliseconds on the
+ * event loop highlight the visible blocks first and fill in the rest in
+ * document order as their tokens arrive.
+ *
+ * Formats are tracked apart from tokens. The theme is an array of formats
+ * indexed by token class, so a theme or rule change only re-applies the
+ * cached tokens through the new array and never runs the lexers again.
  */
 class SyntaxHighlighter : public QSyntaxHighlighter
 {
@@ -55,55 +86,84 @@ public:
     void setTheme(const QString &themeName);
     QString currentThemeName() const { return theme; }
 
-    // Custom rules
+    // Custom rules; patterns come from the shared compiled pattern cache
     void addCustomRule(const HighlightingRule &rule);
+    void addCustomRule(const QString &pattern, const QTextCharFormat &format,
+                       QRegularExpression::PatternOptions options = QRegularExpression::NoPatternOption);
     void clearCustomRules();
 
     // Highlighting control
     void setHighlightingEnabled(bool enabled);
     bool isHighlightingEnabled() const { return enabled; }
 
+    // Re-highlights the whole document lazily, visible blocks first
+    void scheduleRehighlight();
+    // Blocks shown by the view, highlighted ahead of the rest
+    void setVisibleBlocks(int first, int last);
+    // True once every block is tokenized and highlighted
+    bool isHighlightComplete() const;
+
+    static constexpr int FrameBudget = 8;
+    static constexpr int ImmediateBlocks = 128;
+    static constexpr int ImmediateLength = 64 * 1024;
+    static constexpr int BatchBlocks = 4096;
+
 protected:
     void highlightBlock(const QString &text) override;
 
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void highlightPending();
+    void onBlocksTokenized(int request, int firstBlock, int firstState, const QVector<TokenizedBlock> &blocks);
+
 private:
-    void initializeCppRules();
-    void initializePythonRules();
-    void initializeJavaScriptRules();
-    void initializeJsonRules();
-    void initializeXmlRules();
-    void initializeHtmlRules();
-    void initializeCssRules();
-    void initializeSqlRules();
+    bool appliesFormats() const;
+    bool lexes() const;
+    bool isHighlighted(const QTextBlock &block) const;
+    int startState(const QTextBlock &block) const;
+    int endOfValidTokens(QTextBlock block, int number) const;
+    void lexBlock(QTextBlock block);
+    void requestTokens(const QElapsedTimer &elapsed);
+    void cancelTokenizer();
+    void scheduleReformat();
 
     void applyTheme(const QString &themeName);
     void applyLightTheme();
     void applyDarkTheme();
 
-    QTextCharFormat getFormat(const QString &formatType) const;
-    void highlightMultilineComment(const QString &text, const QRegularExpression &startExpression,
-                                   const QRegularExpression &endExpression, int state);
+    // Lexer of the current language, or null for plain text
+    const Lexer *lexer;
 
     // Highlighting rules
-    QVector<HighlightingRule> highlightingRules;
     QVector<HighlightingRule> customRules;
 
-    // Formats
-    QHash<QString, QTextCharFormat> formats;
+    // Theme formats, indexed by Lexer::TokenClass
+    std::array<QTextCharFormat, Lexer::TokenClassCount> tokenFormats;
+
+    // Lazy highlighting; blocks before scanBlock are highlighted and blocks
+    // before stateBlock have current tokens. generation counts changes that
+    // invalidate tokens and formatGeneration those that invalidate formats
+    std::unique_ptr<QTimer> highlightTimer;
+    int generation;
+    int formatGeneration;
+    int scanBlock;
+    int stateBlock;
+
+    // Tokenizing; editedBlock is the first block edited since the active
+    // request was sent
+    QThreadPool tokenizerPool;
+    QPointer<TokenizerWorker> activeTokenizer;
+    int tokenizeRequest;
+    int editedBlock;
+    int knownBlockCount;
+    int firstVisible;
+    int lastVisible;
+    bool formatsApplied;
 
     // State
     Language currentLanguage;
     QString theme;
     bool enabled;
-
-    // Multi-line comment states
-    enum State
-    {
-        Default = 0,
-        InCppComment = 1,
-        InPythonString = 2,
-        InXmlComment = 3
-    };
 };
 
 #endif // SYNTAXHIGHLIGHTER_H
@@ -0,0 +1,56 @@
+#ifndef TOKENIZERWORKER_H
+#define TOKENIZERWORKER_H
+
+#include "lexer.h"
+
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+
+/**
+ * @brief Tokens and end state of one block as lexed by a TokenizerWorker
+ */
+struct TokenizedBlock
+{
+    int endState;
+    QVector<Token> tokens;
+};
+
+/**
+ * @brief Lexes a run of consecutive block texts on a worker thread
+ *
+ * The texts are snapshots taken on the GUI thread. Each block starts in
+ * the state the previous one ended in, so the run comes back as one
+ * result. The request number it was started with lets the receiver drop
+ * results that edits or a language change have made stale.
+ */
+class TokenizerWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    TokenizerWorker(const Lexer *lexer, const QStringList &texts, int startState, int firstBlock,
+                    int request, QObject *parent = nullptr);
+    ~TokenizerWorker();
+
+    // Thread-safe controls
+    void cancel();
+    bool isCancelled() const { return cancelled.load(); }
+
+public slots:
+    void run();
+
+signals:
+    void finished(int request, int firstBlock, int startState, const QVector<TokenizedBlock> &blocks);
+
+private:
+    const Lexer *lexer;
+    QStringList texts;
+    int startState;
+    int firstBlock;
+    int request;
+    std::atomic<bool> cancelled;
+};
+
+#endif // TOKENIZERWORKER_H
@@ -0,0 +1,96 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <atomic>
+#include <vector>
+
+class PieceTable;
+
+/**
+ * @brief Per-line trigram signatures of a document for narrowing searches
+ *
+ * Every line keeps a small Bloom filter of the case-folded trigrams it
+ * contains, sized to about BitsPerTrigram bits per trigram. A query with a
+ * literal of three or more characters tests its trigrams against each line
+ * and only the lines that may hold it have to be searched. Folding makes
+ * the same signatures serve case-sensitive and case-insensitive queries.
+ *
+ * The index is built by the search worker, from the snapshot it scans, on
+ * the first query that can use it, and then follows each edit on the GUI
+ * thread, re-signing only the lines the edit touched. A document whose
+ * index would grow past the memory limit is not indexed and its queries
+ * fall back to a full scan.
+ */
+class TrigramIndex
+{
+public:
+    TrigramIndex();
+    TrigramIndex(const TrigramIndex &other);
+    ~TrigramIndex();
+
+    // Signs every line of @p text; false when over the memory limit or
+    // cancelled, leaving the index unbuilt
+    bool build(QStringView text, const std::atomic<bool> *cancelled = nullptr);
+    // Drops the signatures; the next query rebuilds them
+    void invalidate();
+    // Follows an edit already applied to @p table
+    void update(const PieceTable &table, qsizetype position, qsizetype charsRemoved, QStringView insertedText);
+
+    // Fills @p candidates with the lines that may contain @p literal, in
+    // order, and @p lineStarts with where they begin; false when the index
+    // is not built or cannot narrow the query
+    bool candidateLines(QStringView literal, QVector<int> &candidates, QVector<qsizetype> *lineStarts = nullptr) const;
+
+    // Longest literal every match of a regex must contain, or an empty
+    // string when the pattern may match across lines or has no such literal
+    static QString requiredLiteral(const QString &pattern);
+
+    // Memory
+    qint64 memoryUsage() const;
+    qint64 bytesPerMegabyte() const;
+    void setMemoryLimit(qint64 bytes) { memoryLimit = bytes; }
+    qint64 getMemoryLimit() const { return memoryLimit; }
+    bool isBuilt() const { return built; }
+    qsizetype lineCount() const { return qsizetype(lines.size()); }
+    qsizetype textLength() const { return indexedLength; }
+
+    static constexpr int BitsPerTrigram = 8;
+    static constexpr qint64 DefaultMemoryLimit = 64 * 1024 * 1024;
+
+private:
+    // Short lines keep their single word of bits in place of the pointer
+    struct LineSignature
+    {
+        LineSignature() = default;
+        LineSignature(const LineSignature &other);
+        LineSignature(LineSignature &&other) noexcept;
+        LineSignature &operator=(LineSignature &&other) noexcept;
+        ~LineSignature();
+
+        const quint64 *bits() const { return wordCount > 1 ? words : &inlineWord; }
+
+        int length = 0;
+        int wordCount = 0;
+        union
+        {
+            quint64 inlineWord = 0;
+            quint64 *words;
+        };
+    };
+
+    void drop();
+    LineSignature makeSignature(QStringView line);
+
+    static quint64 trigramHash(char16_t a, char16_t b, char16_t c);
+
+    std::vector<LineSignature> lines;
+    qint64 heapWords;
+    qsizetype indexedLength;
+    qint64 memoryLimit;
+    bool built;
+};
+
+#endif // TRIGRAMINDEX_H
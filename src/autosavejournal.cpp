@@ -0,0 +1,536 @@
+#include "autosavejournal.h"
+#include "editor.h"
+#include "piecetable.h"
+#include "filesaver.h"
+#include "fileloader.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSet>
+#include <QTextDocument>
+#include <QUuid>
+#include <QtEndian>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    // Log record: payload size (u32), CRC-16 of the payload (u16), then
+    // position (i64), removed length (i64), inserted length (u32) and the
+    // inserted UTF-16 code units, all little-endian
+    constexpr qsizetype RecordHeaderSize = 6;
+
+    template <typename T>
+    void appendLittleEndian(QByteArray &bytes, T value)
+    {
+        T stored = qToLittleEndian(value);
+        bytes.append(reinterpret_cast<const char *>(&stored), sizeof(T));
+    }
+
+    template <typename T>
+    T readLittleEndian(const char *data)
+    {
+        return qFromLittleEndian<T>(data);
+    }
+
+    QString baseName(int kind)
+    {
+        static const char *names[] = {"empty", "file", "snapshot"};
+        return QString::fromLatin1(names[kind]);
+    }
+
+    // Generation number of a journal file named <id>.<generation>.<suffix>
+    int generationOf(const QString &fileName)
+    {
+        QStringList parts = fileName.split(QLatin1Char('.'));
+        if (parts.size() != 3 || (parts[2] != "log" && parts[2] != "snap"))
+            return -1;
+        return parts[1].toInt();
+    }
+}
+
+AutosaveJournal::AutosaveJournal(const QString &directory, QObject *parent)
+    : QObject(parent), journalDirectory(directory), sessionId(QUuid::createUuid().toString(QUuid::WithoutBraces)),
+      sessionLock(lockPath(sessionId)), fsyncPolicy(FileSaver::SyncFile), enabled(true)
+{
+    QDir().mkpath(journalDirectory);
+
+    // The lock is held for as long as the session runs, so it must only go
+    // stale when its process is gone, never with age
+    sessionLock.setStaleLockTime(0);
+    if (!sessionLock.tryLock(0))
+    {
+        qWarning() << "AutosaveJournal: cannot lock session" << sessionLock.error();
+    }
+
+    worker.setMaxThreadCount(1);
+    flushTimer.setInterval(5000);
+    connect(&flushTimer, &QTimer::timeout, this, &AutosaveJournal::flush);
+    flushTimer.start();
+}
+
+AutosaveJournal::~AutosaveJournal()
+{
+    worker.waitForDone();
+
+    // Reaching here means a normal exit: the user already decided about
+    // unsaved changes, so nothing needs recovering
+    for (const Journal &journal : std::as_const(journals))
+    {
+        removeFiles(journal.id);
+    }
+}
+
+void AutosaveJournal::track(Editor *editor)
+{
+    if (!editor || journals.contains(editor))
+        return;
+
+    Journal journal;
+    journal.id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    Journal &tracked = *journals.insert(editor, journal);
+    resetBase(editor, tracked);
+
+    connect(editor, &Editor::textEdited, this, [this, editor](int position, int charsRemoved, const QString &insertedText)
+            { onTextEdited(editor, position, charsRemoved, insertedText); });
+    connect(editor, &Editor::textReset, this, [this, editor]()
+            {
+                auto it = journals.find(editor);
+                if (it != journals.end())
+                    resetBase(editor, *it); });
+    connect(editor, &QObject::destroyed, this, [this, editor]()
+            { untrack(editor); });
+}
+
+void AutosaveJournal::rebase(Editor *editor)
+{
+    auto it = journals.find(editor);
+    if (it != journals.end())
+    {
+        resetBase(editor, *it);
+    }
+}
+
+void AutosaveJournal::untrack(Editor *editor)
+{
+    if (!journals.contains(editor))
+        return;
+
+    Journal journal = journals.take(editor);
+    disconnect(editor, nullptr, this, nullptr);
+    removeFiles(journal.id);
+}
+
+void AutosaveJournal::setEnabled(bool enable)
+{
+    if (enabled == enable)
+        return;
+
+    enabled = enable;
+    for (auto it = journals.begin(); it != journals.end(); ++it)
+    {
+        resetBase(it.key(), it.value());
+    }
+
+    if (enabled)
+        flushTimer.start();
+    else
+        flushTimer.stop();
+}
+
+void AutosaveJournal::setFlushInterval(int ms)
+{
+    flushTimer.setInterval(qMax(100, ms));
+}
+
+void AutosaveJournal::flush()
+{
+    for (auto it = journals.begin(); it != journals.end(); ++it)
+    {
+        flushJournal(it.key(), it.value());
+    }
+}
+
+void AutosaveJournal::resetBase(Editor *editor, Journal &journal)
+{
+    // The journal restarts from what is on disk now, or from a snapshot of
+    // the current text when that differs from the file
+    if (journal.started)
+    {
+        removeFiles(journal.id);
+    }
+    journal.generation = 0;
+    journal.pending.clear();
+    journal.logSize = 0;
+    journal.started = false;
+    journal.fileName = editor->fileName();
+
+    QFileInfo info(editor->fileName());
+    if (editor->isModified())
+    {
+        journal.base = SnapshotBase;
+    }
+    else if (info.isFile())
+    {
+        journal.base = FileBase;
+        journal.baseSize = info.size();
+        journal.baseModified = info.lastModified();
+    }
+    else if (editor->document()->isEmpty())
+    {
+        journal.base = EmptyBase;
+    }
+    else
+    {
+        journal.base = SnapshotBase;
+    }
+
+    if (enabled && journal.base == SnapshotBase)
+    {
+        start(editor, journal);
+    }
+}
+
+void AutosaveJournal::start(Editor *editor, Journal &journal)
+{
+    journal.started = true;
+    writeMeta(journal);
+
+    if (journal.base == SnapshotBase)
+    {
+        // Written right away: until a snapshot exists there is nothing to
+        // replay the log onto
+        writeBaseSnapshot(editor, journal);
+    }
+}
+
+bool AutosaveJournal::writeBaseSnapshot(Editor *editor, Journal &journal)
+{
+    ++journal.generation;
+    journal.logSize = 0;
+
+    FileSaver saver(snapshotPath(journal.id, journal.generation), editor->getPieceTable()->snapshot(), fsyncPolicy);
+    if (!saver.save())
+    {
+        qWarning() << "AutosaveJournal:" << saver.errorString();
+        return false;
+    }
+    return true;
+}
+
+void AutosaveJournal::onTextEdited(Editor *editor, int position, int charsRemoved, const QString &insertedText)
+{
+    if (!enabled)
+        return;
+
+    auto it = journals.find(editor);
+    if (it == journals.end())
+        return;
+
+    Journal &journal = *it;
+    if (!journal.started)
+    {
+        start(editor, journal);
+        if (journal.base == SnapshotBase)
+        {
+            // The snapshot already contains this edit
+            return;
+        }
+    }
+
+    QByteArray payload;
+    payload.reserve(20 + insertedText.size() * 2);
+    appendLittleEndian<qint64>(payload, position);
+    appendLittleEndian<qint64>(payload, charsRemoved);
+    appendLittleEndian<quint32>(payload, quint32(insertedText.size()));
+    for (QChar c : insertedText)
+    {
+        appendLittleEndian<quint16>(payload, c.unicode());
+    }
+
+    appendLittleEndian<quint32>(journal.pending, quint32(payload.size()));
+    appendLittleEndian<quint16>(journal.pending, qChecksum(payload));
+    journal.pending.append(payload);
+
+    if (journal.logSize + journal.pending.size() > CompactThreshold)
+    {
+        compact(editor, journal);
+    }
+}
+
+void AutosaveJournal::compact(Editor *editor, Journal &journal)
+{
+    // Older generations stay on disk until the new snapshot is complete
+    flushJournal(editor, journal);
+    ++journal.generation;
+    journal.logSize = 0;
+
+    QString id = journal.id;
+    int generation = journal.generation;
+    QString path = snapshotPath(id, generation);
+    QString meta = metaPath(id);
+    PieceTable::Snapshot snapshot = editor->getPieceTable()->snapshot();
+    FileSaver::FsyncPolicy policy = fsyncPolicy;
+
+    worker.start([this, id, generation, path, meta, snapshot, policy]()
+                 {
+        FileSaver saver(path, snapshot, policy);
+        if (!saver.save())
+            return;
+
+        if (QFile::exists(meta))
+        {
+            removeFiles(id, generation);
+        }
+        else
+        {
+            // Discarded while the snapshot was being written
+            QFile::remove(path);
+        } });
+}
+
+bool AutosaveJournal::flushJournal(Editor *editor, Journal &journal)
+{
+    if (!journal.started)
+        return true;
+
+    if (journal.fileName != editor->fileName())
+    {
+        journal.fileName = editor->fileName();
+        writeMeta(journal);
+    }
+
+    if (journal.pending.isEmpty())
+        return true;
+
+    QFile log(logPath(journal.id, journal.generation));
+    if (!log.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        return false;
+    }
+
+    bool ok = log.write(journal.pending) == journal.pending.size() && log.flush();
+    if (ok && fsyncPolicy != FileSaver::NoSync)
+    {
+        ok = FileSaver::syncFile(log);
+    }
+    journal.logSize += journal.pending.size();
+    journal.pending.clear();
+    return ok;
+}
+
+void AutosaveJournal::removeFiles(const QString &id, int belowGeneration) const
+{
+    QDir directory(journalDirectory);
+    const QStringList entries = directory.entryList({id + ".*"}, QDir::Files);
+    for (const QString &entry : entries)
+    {
+        if (belowGeneration < 0 || (generationOf(entry) >= 0 && generationOf(entry) < belowGeneration))
+        {
+            directory.remove(entry);
+        }
+    }
+}
+
+bool AutosaveJournal::writeMeta(const Journal &journal) const
+{
+    QJsonObject meta;
+    meta["session"] = sessionId;
+    meta["fileName"] = journal.fileName;
+    meta["base"] = baseName(journal.base);
+    meta["baseSize"] = journal.baseSize;
+    meta["baseModified"] = journal.baseModified.toMSecsSinceEpoch();
+
+    QSaveFile file(metaPath(journal.id));
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    file.write(QJsonDocument(meta).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+QVector<AutosaveJournal::RecoveredDocument> AutosaveJournal::recover() const
+{
+    QSet<QString> active;
+    for (const Journal &journal : journals)
+    {
+        active.insert(journal.id);
+    }
+
+    // A session whose lock is still held belongs to a running instance; the
+    // locks of crashed sessions are stale and are held until recovery ends
+    QHash<QString, bool> sessionRunning;
+    std::vector<std::unique_ptr<QLockFile>> staleLocks;
+
+    QVector<RecoveredDocument> documents;
+    const QStringList metas = QDir(journalDirectory).entryList({"*.meta"}, QDir::Files);
+    for (const QString &metaName : metas)
+    {
+        QString id = metaName.section(QLatin1Char('.'), 0, 0);
+        if (active.contains(id))
+            continue;
+
+        QFile metaFile(metaPath(id));
+        if (!metaFile.open(QIODevice::ReadOnly))
+            continue;
+        QJsonObject meta = QJsonDocument::fromJson(metaFile.readAll()).object();
+
+        QString session = meta["session"].toString();
+        if (!session.isEmpty())
+        {
+            auto found = sessionRunning.constFind(session);
+            if (found == sessionRunning.constEnd())
+            {
+                auto lock = std::make_unique<QLockFile>(lockPath(session));
+                lock->setStaleLockTime(0);
+                bool running = !lock->tryLock(0);
+                if (!running)
+                {
+                    staleLocks.push_back(std::move(lock));
+                }
+                found = sessionRunning.insert(session, running);
+            }
+            if (*found)
+                continue;
+        }
+
+        RecoveredDocument document;
+        if (recoverOne(id, meta, document))
+        {
+            documents.append(document);
+        }
+        else
+        {
+            qWarning() << "AutosaveJournal: cannot recover journal" << id;
+        }
+    }
+    return documents;
+}
+
+void AutosaveJournal::discard(const QString &id)
+{
+    removeFiles(id);
+}
+
+bool AutosaveJournal::recoverOne(const QString &id, const QJsonObject &meta, RecoveredDocument &document) const
+{
+    document.id = id;
+    document.fileName = meta["fileName"].toString();
+
+    QVector<int> logs;
+    int snapshotGeneration = -1;
+    const QStringList entries = QDir(journalDirectory).entryList({id + ".*"}, QDir::Files);
+    for (const QString &entry : entries)
+    {
+        int generation = generationOf(entry);
+        if (generation < 0)
+            continue;
+        if (entry.endsWith(".log"))
+            logs.append(generation);
+        else if (entry.endsWith(".snap"))
+            snapshotGeneration = qMax(snapshotGeneration, generation);
+    }
+    std::sort(logs.begin(), logs.end());
+
+    // Start from the newest complete snapshot, or from the journal's base
+    PieceTable text;
+    if (snapshotGeneration >= 0)
+    {
+        QFile snapshot(snapshotPath(id, snapshotGeneration));
+        if (!snapshot.open(QIODevice::ReadOnly))
+            return false;
+        text.setOriginal(QString::fromUtf8(snapshot.readAll()));
+    }
+    else if (meta["base"].toString() == baseName(FileBase))
+    {
+        QFileInfo info(document.fileName);
+        if (info.size() != meta["baseSize"].toInteger() ||
+            info.lastModified().toMSecsSinceEpoch() != meta["baseModified"].toInteger())
+        {
+            // The file changed on disk; the edits no longer apply to it
+            return false;
+        }
+
+        QString content;
+        if (!FileLoader::readAll(document.fileName, content))
+            return false;
+        text.setOriginal(content);
+    }
+    else if (meta["base"].toString() == baseName(SnapshotBase))
+    {
+        return false;
+    }
+
+    // Replay the tail; a torn record at the end of a log ends the replay
+    for (int generation : std::as_const(logs))
+    {
+        if (generation < snapshotGeneration)
+            continue;
+
+        QFile log(logPath(id, generation));
+        if (!log.open(QIODevice::ReadOnly))
+            return false;
+
+        const QByteArray bytes = log.readAll();
+        const char *data = bytes.constData();
+        qsizetype offset = 0;
+        while (offset + RecordHeaderSize <= bytes.size())
+        {
+            quint32 size = readLittleEndian<quint32>(data + offset);
+            quint16 checksum = readLittleEndian<quint16>(data + offset + 4);
+            if (size < 20 || offset + RecordHeaderSize + size > bytes.size())
+                break;
+
+            QByteArrayView payload(data + offset + RecordHeaderSize, size);
+            if (qChecksum(payload) != checksum)
+                break;
+
+            qint64 position = readLittleEndian<qint64>(payload.data());
+            qint64 removed = readLittleEndian<qint64>(payload.data() + 8);
+            quint32 inserted = readLittleEndian<quint32>(payload.data() + 16);
+            if (20 + qsizetype(inserted) * 2 != size || position < 0 || removed < 0 ||
+                position + removed > text.length())
+                break;
+
+            QString insertedText(qsizetype(inserted), Qt::Uninitialized);
+            for (quint32 i = 0; i < inserted; ++i)
+            {
+                insertedText[i] = QChar(readLittleEndian<quint16>(payload.data() + 20 + i * 2));
+            }
+
+            text.remove(position, removed);
+            text.insert(position, insertedText);
+            offset += RecordHeaderSize + size;
+        }
+    }
+
+    document.text = text.text();
+    return true;
+}
+
+QString AutosaveJournal::metaPath(const QString &id) const
+{
+    return journalDirectory + "/" + id + ".meta";
+}
+
+QString AutosaveJournal::logPath(const QString &id, int generation) const
+{
+    return journalDirectory + "/" + id + "." + QString::number(generation) + ".log";
+}
+
+QString AutosaveJournal::lockPath(const QString &session) const
+{
+    return journalDirectory + "/" + session + ".lock";
+}
+
+QString AutosaveJournal::snapshotPath(const QString &id, int generation) const
+{
+    return journalDirectory + "/" + id + "." + QString::number(generation) + ".snap";
+}
@@ -0,0 +1,307 @@
+#include "backupstore.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSet>
+#include <array>
+
+namespace
+{
+    // Fixed pseudo-random table for the gear hash; it must never change or
+    // chunk boundaries of existing backups would shift
+    constexpr std::array<quint64, 256> makeGearTable()
+    {
+        std::array<quint64, 256> table{};
+        quint64 state = 0x9E3779B97F4A7C15ull;
+        for (quint64 &entry : table)
+        {
+            state += 0x9E3779B97F4A7C15ull;
+            quint64 z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            entry = z ^ (z >> 31);
+        }
+        return table;
+    }
+
+    constexpr std::array<quint64, 256> GearTable = makeGearTable();
+
+    QJsonObject versionToJson(const BackupStore::Version &version)
+    {
+        QJsonObject object;
+        object["timestamp"] = version.timestamp.toString(Qt::ISODateWithMs);
+        object["size"] = version.size;
+        object["chunks"] = QJsonArray::fromStringList(version.chunks);
+        return object;
+    }
+
+    BackupStore::Version versionFromJson(const QJsonObject &object)
+    {
+        BackupStore::Version version;
+        version.timestamp = QDateTime::fromString(object["timestamp"].toString(), Qt::ISODateWithMs);
+        version.size = object["size"].toInteger();
+        for (const QJsonValue &chunk : object["chunks"].toArray())
+        {
+            version.chunks.append(chunk.toString());
+        }
+        return version;
+    }
+}
+
+BackupStore::BackupStore(const QString &directory, QObject *parent)
+    : QObject(parent), storeDirectory(directory), maxVersionCount(10)
+{
+    QDir().mkpath(storeDirectory + "/chunks");
+    QDir().mkpath(storeDirectory + "/versions");
+
+    // One backup at a time keeps manifest updates and garbage collection simple
+    worker.setMaxThreadCount(1);
+}
+
+BackupStore::~BackupStore()
+{
+    waitForDone();
+}
+
+void BackupStore::backupFile(const QString &fileName)
+{
+    QString absolutePath = QFileInfo(fileName).absoluteFilePath();
+    worker.start([this, absolutePath]()
+                 { emit backupFinished(absolutePath, storeFile(absolutePath)); });
+}
+
+void BackupStore::waitForDone()
+{
+    worker.waitForDone();
+}
+
+QVector<BackupStore::Version> BackupStore::versions(const QString &fileName) const
+{
+    QVector<Version> result;
+
+    QFile manifest(manifestPath(fileName));
+    if (!manifest.open(QIODevice::ReadOnly))
+    {
+        return result;
+    }
+
+    // Stored oldest first
+    const QJsonArray array = QJsonDocument::fromJson(manifest.readAll()).object()["versions"].toArray();
+    for (qsizetype i = array.size() - 1; i >= 0; --i)
+    {
+        result.append(versionFromJson(array[i].toObject()));
+    }
+    return result;
+}
+
+bool BackupStore::restore(const QString &fileName, int version, const QString &targetFileName) const
+{
+    QVector<Version> available = versions(fileName);
+    if (version < 0 || version >= available.size())
+    {
+        return false;
+    }
+
+    QSaveFile target(targetFileName);
+    if (!target.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    for (const QString &hash : std::as_const(available[version].chunks))
+    {
+        QFile chunk(chunkPath(hash));
+        if (!chunk.open(QIODevice::ReadOnly))
+        {
+            target.cancelWriting();
+            return false;
+        }
+
+        QByteArray data = qUncompress(chunk.readAll());
+        if (data.isEmpty() || target.write(data) != data.size())
+        {
+            target.cancelWriting();
+            return false;
+        }
+    }
+
+    if (target.size() != available[version].size)
+    {
+        target.cancelWriting();
+        return false;
+    }
+    return target.commit();
+}
+
+bool BackupStore::storeFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    Version version;
+    version.timestamp = QDateTime::currentDateTimeUtc();
+
+    QByteArray current;
+    current.reserve(MaxChunkSize);
+    quint64 hash = 0;
+
+    while (!file.atEnd())
+    {
+        QByteArray block = file.read(ReadBlockSize);
+        if (block.isEmpty() && file.error() != QFileDevice::NoError)
+        {
+            return false;
+        }
+        version.size += block.size();
+
+        const uchar *data = reinterpret_cast<const uchar *>(block.constData());
+        qsizetype segmentStart = 0;
+        for (qsizetype i = 0; i < block.size(); ++i)
+        {
+            hash = (hash << 1) + GearTable[data[i]];
+            qsizetype length = current.size() + (i - segmentStart + 1);
+
+            if ((length >= MinChunkSize && (hash & ChunkMask) == 0) || length >= MaxChunkSize)
+            {
+                current.append(block.constData() + segmentStart, i - segmentStart + 1);
+                if (!storeChunk(current, version.chunks))
+                    return false;
+                current.clear();
+                hash = 0;
+                segmentStart = i + 1;
+            }
+        }
+        current.append(block.constData() + segmentStart, block.size() - segmentStart);
+    }
+
+    if (!current.isEmpty() && !storeChunk(current, version.chunks))
+    {
+        return false;
+    }
+
+    QVector<Version> history = versions(fileName);
+    if (!history.isEmpty() && history.first().chunks == version.chunks)
+    {
+        // Unchanged since the last backup
+        return true;
+    }
+
+    history.prepend(version);
+    bool pruned = false;
+    while (history.size() > maxVersions())
+    {
+        history.removeLast();
+        pruned = true;
+    }
+
+    if (!writeVersions(fileName, history))
+    {
+        return false;
+    }
+
+    if (pruned)
+    {
+        collectGarbage();
+    }
+    return true;
+}
+
+bool BackupStore::storeChunk(const QByteArray &chunk, QStringList &chunks)
+{
+    QString hash = QString::fromLatin1(QCryptographicHash::hash(chunk, QCryptographicHash::Sha256).toHex());
+    chunks.append(hash);
+
+    QString path = chunkPath(hash);
+    if (QFile::exists(path))
+    {
+        return true;
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    file.write(qCompress(chunk));
+    return file.commit();
+}
+
+bool BackupStore::writeVersions(const QString &fileName, const QVector<Version> &history)
+{
+    QJsonArray array;
+    for (qsizetype i = history.size() - 1; i >= 0; --i)
+    {
+        array.append(versionToJson(history[i]));
+    }
+
+    QJsonObject manifest;
+    manifest["path"] = fileName;
+    manifest["versions"] = array;
+
+    QSaveFile file(manifestPath(fileName));
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    file.write(QJsonDocument(manifest).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+void BackupStore::collectGarbage()
+{
+    // Chunks are shared between versions and files; drop the ones no
+    // manifest refers to any more
+    QSet<QString> referenced;
+    QDirIterator manifests(storeDirectory + "/versions", {"*.json"}, QDir::Files);
+    while (manifests.hasNext())
+    {
+        QFile manifest(manifests.next());
+        if (!manifest.open(QIODevice::ReadOnly))
+        {
+            // An unreadable manifest may still need its chunks
+            return;
+        }
+
+        const QJsonArray array = QJsonDocument::fromJson(manifest.readAll()).object()["versions"].toArray();
+        for (const QJsonValue &value : array)
+        {
+            for (const QJsonValue &chunk : value.toObject()["chunks"].toArray())
+            {
+                referenced.insert(chunk.toString());
+            }
+        }
+    }
+
+    QDirIterator chunks(storeDirectory + "/chunks", QDir::Files, QDirIterator::Subdirectories);
+    while (chunks.hasNext())
+    {
+        QString path = chunks.next();
+        if (!referenced.contains(QFileInfo(path).fileName()))
+        {
+            QFile::remove(path);
+        }
+    }
+}
+
+QString BackupStore::manifestPath(const QString &fileName) const
+{
+    // Keyed by absolute path, so files sharing a name do not collide
+    QByteArray key = QCryptographicHash::hash(QFileInfo(fileName).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+    return storeDirectory + "/versions/" + QString::fromLatin1(key) + ".json";
+}
+
+QString BackupStore::chunkPath(const QString &hash) const
+{
+    return storeDirectory + "/chunks/" + hash.left(2) + "/" + hash;
+}
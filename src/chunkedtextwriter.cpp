@@ -0,0 +1,214 @@
+#include "chunkedtextwriter.h"
+
+#include <QIODevice>
+#include <QStringEncoder>
+
+namespace
+{
+    constexpr char32_t ReplacementCharacter = 0xFFFD;
+
+    bool isHighSurrogate(char16_t c) { return c >= 0xD800 && c <= 0xDBFF; }
+    bool isLowSurrogate(char16_t c) { return c >= 0xDC00 && c <= 0xDFFF; }
+}
+
+ChunkedTextWriter::ChunkedTextWriter(QIODevice *device, qsizetype bufferSize)
+    : device(device), buffer(size_t(qMax<qsizetype>(bufferSize, 16))), used(0), pendingHighSurrogate(0), totalBytes(0), failed(false)
+{
+}
+
+ChunkedTextWriter::~ChunkedTextWriter()
+{
+    flush();
+}
+
+void ChunkedTextWriter::setEncoding(QStringConverter::Encoding encoding, bool byteOrderMark)
+{
+    if (encoding == QStringConverter::Utf8)
+    {
+        encoder.reset();
+    }
+    else
+    {
+        encoder = std::make_unique<QStringEncoder>(encoding);
+    }
+
+    if (byteOrderMark)
+    {
+        write(u"\uFEFF");
+    }
+}
+
+bool ChunkedTextWriter::hasUnencodableCharacters() const
+{
+    return encoder && encoder->hasError();
+}
+
+bool ChunkedTextWriter::write(QStringView text)
+{
+    if (encoder)
+    {
+        return writeEncoded(text);
+    }
+
+    const char16_t *data = text.utf16();
+    const qsizetype size = text.size();
+    const qsizetype capacity = qsizetype(buffer.size());
+    qsizetype i = 0;
+
+    if (pendingHighSurrogate && size > 0)
+    {
+        char16_t high = pendingHighSurrogate;
+        pendingHighSurrogate = 0;
+        if (isLowSurrogate(data[0]))
+        {
+            encode(0x10000 + ((char32_t(high) - 0xD800) << 10) + (data[0] - 0xDC00));
+            i = 1;
+        }
+        else
+        {
+            encode(ReplacementCharacter);
+        }
+    }
+
+    while (i < size && !failed)
+    {
+        // ASCII runs are copied without per-character bookkeeping
+        qsizetype room = capacity - used;
+        qsizetype end = qMin(size, i + room);
+        char *out = buffer.data() + used;
+        qsizetype start = i;
+        while (i < end && data[i] < 0x80)
+        {
+            *out++ = char(data[i++]);
+        }
+        used += i - start;
+
+        if (i == size)
+            break;
+        if (used == capacity)
+        {
+            flushBuffer();
+            continue;
+        }
+
+        char16_t c = data[i++];
+        if (isHighSurrogate(c))
+        {
+            if (i == size)
+            {
+                // The low half may arrive with the next write()
+                pendingHighSurrogate = c;
+                break;
+            }
+            if (isLowSurrogate(data[i]))
+            {
+                encode(0x10000 + ((char32_t(c) - 0xD800) << 10) + (data[i] - 0xDC00));
+                ++i;
+                continue;
+            }
+            encode(ReplacementCharacter);
+        }
+        else if (isLowSurrogate(c))
+        {
+            encode(ReplacementCharacter);
+        }
+        else
+        {
+            encode(c);
+        }
+    }
+
+    return !failed;
+}
+
+bool ChunkedTextWriter::writeEncoded(QStringView text)
+{
+    const qsizetype capacity = qsizetype(buffer.size());
+
+    while (!text.isEmpty() && !failed)
+    {
+        // Take only as much text as is sure to fit in the room left; no
+        // supported encoding needs more than four bytes per UTF-16 unit
+        qsizetype room = capacity - used;
+        qsizetype length = qMin(text.size(), room / 4);
+        while (length > 0 && encoder->requiredSpace(length) > room)
+        {
+            length /= 2;
+        }
+        if (length == 0)
+        {
+            flushBuffer();
+            continue;
+        }
+
+        char *end = encoder->appendToBuffer(buffer.data() + used, text.first(length));
+        used = end - buffer.data();
+        text = text.sliced(length);
+    }
+
+    return !failed;
+}
+
+bool ChunkedTextWriter::flush()
+{
+    if (pendingHighSurrogate)
+    {
+        pendingHighSurrogate = 0;
+        encode(ReplacementCharacter);
+    }
+    return flushBuffer();
+}
+
+bool ChunkedTextWriter::flushBuffer()
+{
+    if (used > 0 && !failed)
+    {
+        qint64 written = device->write(buffer.data(), used);
+        if (written != used)
+        {
+            failed = true;
+        }
+        else
+        {
+            totalBytes += written;
+        }
+    }
+    used = 0;
+    return !failed;
+}
+
+void ChunkedTextWriter::encode(char32_t codePoint)
+{
+    if (qsizetype(buffer.size()) - used < 4)
+    {
+        flushBuffer();
+    }
+
+    char *out = buffer.data() + used;
+    if (codePoint < 0x80)
+    {
+        out[0] = char(codePoint);
+        used += 1;
+    }
+    else if (codePoint < 0x800)
+    {
+        out[0] = char(0xC0 | (codePoint >> 6));
+        out[1] = char(0x80 | (codePoint & 0x3F));
+        used += 2;
+    }
+    else if (codePoint < 0x10000)
+    {
+        out[0] = char(0xE0 | (codePoint >> 12));
+        out[1] = char(0x80 | ((codePoint >> 6) & 0x3F));
+        out[2] = char(0x80 | (codePoint & 0x3F));
+        used += 3;
+    }
+    else
+    {
+        out[0] = char(0xF0 | (codePoint >> 18));
+        out[1] = char(0x80 | ((codePoint >> 12) & 0x3F));
+        out[2] = char(0x80 | ((codePoint >> 6) & 0x3F));
+        out[3] = char(0x80 | (codePoint & 0x3F));
+        used += 4;
+    }
+}
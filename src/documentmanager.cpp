@@ -1,17 +1,37 @@
 #include "documentmanager.h"
 #include "editor.h"
+#include "largefileviewer.h"
+#include "fileloader.h"
+#include "encodingdetector.h"
+#include "backupstore.h"
 
 #include <QFile>
 #include <QFileInfo>
-#include <QTextStream>
 #include <QStandardPaths>
 #include <QDir>
 #include <QSettings>
 #include <QDebug>
 #include <QDateTime>
+#include <QThread>
+#include <optional>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    // Files are written back in the encoding they were read in
+    void applyEncoding(FileSaver &saver, const Editor *editor)
+    {
+        std::optional<QStringConverter::Encoding> encoding =
+            QStringConverter::encodingForName(editor->encoding().toLatin1().constData());
+        saver.setEncoding(encoding.value_or(QStringConverter::Utf8), editor->hasByteOrderMark());
+    }
+}
 
 DocumentManager::DocumentManager(QObject *parent)
-    : QObject(parent), maxRecentFiles(10), autoSaveEnabled(false), autoSaveInterval(60000)
+    : QObject(parent), maxRecentFiles(10), autoSaveEnabled(true), autoSaveInterval(5000), largeFileThreshold(256 * 1024 * 1024), fsyncPolicy(FileSaver::SyncFile)
 {
     configDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
     backupDir = configDir + "/backups";
@@ -20,12 +40,32 @@ DocumentManager::DocumentManager(QObject *parent)
     QDir().mkpath(configDir);
     QDir().mkpath(backupDir);
 
+    backupStore = std::make_unique<BackupStore>(backupDir);
+    journal = std::make_unique<AutosaveJournal>(configDir + "/journal");
+
+    // Several files open in parallel, bounded by the number of cores
+    loadPool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+
     loadSettings();
+    journal->setEnabled(autoSaveEnabled);
+    journal->setFlushInterval(autoSaveInterval);
+    journal->setFsyncPolicy(fsyncPolicy);
 }
 
 DocumentManager::~DocumentManager()
 {
     saveSettings();
+
+    // Worker threads are children of this object and must not outlive it
+    for (FileLoader *loader : std::as_const(pendingLoads))
+    {
+        loader->cancel();
+    }
+    loadPool.waitForDone();
+    for (QThread *thread : findChildren<QThread *>())
+    {
+        thread->wait();
+    }
 }
 
 bool DocumentManager::openFile(const QString &fileName, Editor *editor)
@@ -34,14 +74,22 @@ bool DocumentManager::openFile(const QString &fileName, Editor *editor)
         return false;
 
     QString content;
-    if (!readFile(fileName, content))
+    QString encoding;
+    LineEndings lineEndings;
+    bool byteOrderMark = false;
+    if (!readFile(fileName, content, &encoding, &lineEndings, &byteOrderMark))
     {
         return false;
     }
 
-    editor->setPlainText(content);
+    editor->loadText(content);
+    editor->setEncoding(encoding);
+    editor->setByteOrderMark(byteOrderMark);
+    editor->setLineEnding(lineEndings.dominant(), lineEndings.isMixed());
+    editor->setLineTerminators(LineTerminators(lineEndings));
     editor->setFileName(fileName);
     editor->document()->setModified(false);
+    journal->track(editor);
 
     addRecentFile(fileName);
     emit fileOpened(fileName);
@@ -60,7 +108,7 @@ bool DocumentManager::saveFile(Editor *editor)
         return false;
     }
 
-    return writeFile(fileName, editor->toPlainText());
+    return writeFile(editor, fileName);
 }
 
 bool DocumentManager::saveFileAs(Editor *editor, const QString &newFileName)
@@ -68,14 +116,7 @@ bool DocumentManager::saveFileAs(Editor *editor, const QString &newFileName)
     if (!editor)
         return false;
 
-    if (writeFile(newFileName, editor->toPlainText()))
-    {
-        editor->setFileName(newFileName);
-        addRecentFile(newFileName);
-        emit fileSaved(newFileName);
-        return true;
-    }
-    return false;
+    return writeFile(editor, newFileName);
 }
 
 bool DocumentManager::closeFile(Editor *editor)
@@ -87,6 +128,213 @@ bool DocumentManager::closeFile(Editor *editor)
     return true;
 }
 
+bool DocumentManager::saveFileAsync(Editor *editor, const QString &fileName)
+{
+    if (!editor || editor->isLoading() || fileName.isEmpty())
+        return false;
+
+    // Only one save per document runs at a time; keep the latest request
+    if (pendingSaves.contains(editor))
+    {
+        queuedSaves.insert(editor, fileName);
+        return true;
+    }
+
+    startSave(editor, fileName);
+    return true;
+}
+
+void DocumentManager::waitForPendingSaves()
+{
+    for (const QPointer<QThread> &thread : std::as_const(pendingSaves))
+    {
+        if (thread)
+            thread->wait();
+    }
+}
+
+void DocumentManager::startSave(Editor *editor, const QString &fileName)
+{
+    QThread *thread = new QThread(this);
+    FileSaver *saver = new FileSaver(fileName, editor->getPieceTable()->snapshot(), fsyncPolicy);
+    saver->setLineSeparator(LineEndings::separator(editor->lineEnding()));
+    saver->setLineTerminators(editor->lineTerminators());
+    applyEncoding(*saver, editor);
+    saver->moveToThread(thread);
+    pendingSaves.insert(editor, thread);
+
+    // Edits made while saving keep the document modified
+    int revision = editor->document()->revision();
+
+    connect(thread, &QThread::started, saver, &FileSaver::save);
+    connect(saver, &FileSaver::progress, editor, [this, editor](qint64 written, qint64 total)
+            { emit saveProgress(editor, total > 0 ? int(written * 100 / total) : 100); });
+    connect(saver, &FileSaver::finished, editor, [this, editor, fileName, revision](bool success, const QString &errorString)
+            { finishSave(editor, fileName, revision, success, errorString); });
+    connect(editor, &QObject::destroyed, this, &DocumentManager::onEditorDestroyed, Qt::UniqueConnection);
+
+    // Quit straight from the worker so waitForPendingSaves() cannot deadlock
+    connect(saver, &FileSaver::finished, thread, &QThread::quit, Qt::DirectConnection);
+    connect(thread, &QThread::finished, saver, &QObject::deleteLater);
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+
+    thread->start();
+}
+
+void DocumentManager::onEditorDestroyed(QObject *object)
+{
+    // Only used as a key; the editor is already gone
+    Editor *editor = static_cast<Editor *>(object);
+    cancelLoad(editor);
+    pendingSaves.remove(editor);
+    queuedSaves.remove(editor);
+}
+
+void DocumentManager::finishSave(Editor *editor, const QString &fileName, int revision, bool success, const QString &errorString)
+{
+    pendingSaves.remove(editor);
+
+    if (success)
+    {
+        if (editor->fileName() != fileName)
+        {
+            editor->setFileName(fileName);
+            addRecentFile(fileName);
+        }
+        if (editor->document()->revision() == revision)
+        {
+            editor->setModified(false);
+        }
+        // The old base no longer matches the file on disk; edits made during
+        // the save keep the document modified and move it to a snapshot
+        journal->rebase(editor);
+        createBackup(fileName);
+        emit fileSaved(fileName);
+        emit saveFinished(editor, fileName);
+    }
+    else
+    {
+        emit saveFailed(editor, errorString);
+    }
+
+    if (queuedSaves.contains(editor))
+    {
+        startSave(editor, queuedSaves.take(editor));
+    }
+}
+
+bool DocumentManager::openFileAsync(const QString &fileName, Editor *editor)
+{
+    if (!editor || pendingLoads.contains(editor))
+        return false;
+
+    QFileInfo fileInfo(fileName);
+    if (!fileInfo.isFile() || !fileInfo.isReadable())
+    {
+        return false;
+    }
+
+    editor->setFileName(fileName);
+    editor->beginLoading();
+
+    // The loader lives on this thread; only load() runs on the pool, so its
+    // signals reach the editor queued and in order
+    FileLoader *loader = new FileLoader(fileName);
+    pendingLoads.insert(editor, loader);
+
+    connect(loader, &FileLoader::chunkLoaded, editor, [editor, loader](const QString &text, const QVector<qsizetype> &lineFeeds)
+            {
+                editor->appendLoadedText(text, lineFeeds);
+                loader->chunkConsumed(); });
+    connect(loader, &FileLoader::progress, editor, [this, editor](qint64 bytesRead, qint64 totalBytes)
+            { emit loadProgress(editor, totalBytes > 0 ? int(bytesRead * 100 / totalBytes) : 100); });
+    connect(loader, &FileLoader::finished, editor, [this, editor]()
+            { finishLoad(editor); });
+    connect(loader, &FileLoader::failed, editor, [this, editor](const QString &errorString)
+            {
+                pendingLoads.remove(editor);
+                emit loadFailed(editor, errorString); });
+    connect(loader, &FileLoader::aborted, editor, [this, editor]()
+            {
+                pendingLoads.remove(editor);
+                emit loadCancelled(editor); });
+
+    // A tab closed mid-load stops the worker
+    connect(editor, &QObject::destroyed, this, &DocumentManager::onEditorDestroyed, Qt::UniqueConnection);
+
+    loadPool.start([loader]()
+                   {
+        loader->load();
+        loader->deleteLater(); });
+    return true;
+}
+
+void DocumentManager::cancelLoad(Editor *editor)
+{
+    FileLoader *loader = pendingLoads.take(editor);
+    if (loader)
+    {
+        loader->cancel();
+    }
+}
+
+void DocumentManager::finishLoad(Editor *editor)
+{
+    FileLoader *loader = pendingLoads.take(editor);
+    if (loader)
+    {
+        editor->setEncoding(loader->encoding());
+        editor->setByteOrderMark(loader->hasByteOrderMark());
+        editor->setLineEnding(loader->lineEndings().dominant(), loader->lineEndings().isMixed());
+        editor->setLineTerminators(LineTerminators(loader->lineEndings()));
+    }
+    editor->endLoading();
+
+    // Keep the version the user started from
+    createBackup(editor->fileName());
+    journal->track(editor);
+    addRecentFile(editor->fileName());
+    emit loadFinished(editor);
+    emit fileOpened(editor->fileName());
+}
+
+bool DocumentManager::openReadOnly(const QString &fileName, LargeFileViewer *viewer)
+{
+    if (!viewer)
+        return false;
+
+    if (!viewer->openFile(fileName))
+    {
+        return false;
+    }
+
+    addRecentFile(fileName);
+    emit fileOpened(fileName);
+
+    return true;
+}
+
+bool DocumentManager::shouldOpenReadOnly(const QString &fileName) const
+{
+    return largeFileThreshold > 0 && getFileSize(fileName) >= largeFileThreshold;
+}
+
+QString DocumentManager::fileIdentity(const QString &fileName) const
+{
+#ifdef Q_OS_UNIX
+    // Device and inode also match hard links and bind mounts
+    struct stat info;
+    if (::stat(QFile::encodeName(fileName).constData(), &info) == 0)
+    {
+        return QString("%1:%2").arg(qulonglong(info.st_dev)).arg(qulonglong(info.st_ino));
+    }
+#endif
+
+    QFileInfo fileInfo(fileName);
+    QString canonical = fileInfo.canonicalFilePath();
+    return canonical.isEmpty() ? fileInfo.absoluteFilePath() : canonical;
+}
+
 bool DocumentManager::fileExists(const QString &fileName) const
 {
     return QFile::exists(fileName);
@@ -147,32 +395,56 @@ void DocumentManager::createBackup(const QString &fileName)
     if (!QFile::exists(fileName))
         return;
 
-    QFileInfo fileInfo(fileName);
-    QString backupFileName = backupDir + "/" + fileInfo.fileName() + ".bak";
-
-    QFile file(fileName);
-    QFile backup(backupFileName);
+    // Chunked and deduplicated on the backup store's worker thread
+    backupStore->backupFile(fileName);
+}
 
-    if (file.open(QIODevice::ReadOnly))
-    {
-        if (backup.open(QIODevice::WriteOnly | QIODevice::Truncate))
-        {
-            backup.write(file.readAll());
-            backup.close();
-        }
-        file.close();
-    }
+QVector<BackupStore::Version> DocumentManager::getBackupVersions(const QString &fileName) const
+{
+    return backupStore->versions(fileName);
 }
 
-QString DocumentManager::getBackupFile(const QString &fileName) const
+bool DocumentManager::restoreBackup(const QString &fileName, int version, const QString &targetFileName)
 {
-    QFileInfo fileInfo(fileName);
-    return backupDir + "/" + fileInfo.fileName() + ".bak";
+    return backupStore->restore(fileName, version, targetFileName);
 }
 
 bool DocumentManager::hasBackup(const QString &fileName) const
 {
-    return QFile::exists(getBackupFile(fileName));
+    return !backupStore->versions(fileName).isEmpty();
+}
+
+void DocumentManager::trackEditor(Editor *editor)
+{
+    journal->track(editor);
+}
+
+QVector<AutosaveJournal::RecoveredDocument> DocumentManager::recoverDocuments() const
+{
+    return journal->recover();
+}
+
+void DocumentManager::discardRecoveredDocument(const QString &id)
+{
+    journal->discard(id);
+}
+
+void DocumentManager::setAutoSaveEnabled(bool enabled)
+{
+    autoSaveEnabled = enabled;
+    journal->setEnabled(enabled);
+}
+
+void DocumentManager::setAutoSaveInterval(int ms)
+{
+    autoSaveInterval = ms;
+    journal->setFlushInterval(ms);
+}
+
+void DocumentManager::setFsyncPolicy(FileSaver::FsyncPolicy policy)
+{
+    fsyncPolicy = policy;
+    journal->setFsyncPolicy(policy);
 }
 
 void DocumentManager::saveSession(const QStringList &openFiles)
@@ -193,38 +465,41 @@ void DocumentManager::clearSession()
     settings.remove("session/openFiles");
 }
 
-bool DocumentManager::readFile(const QString &fileName, QString &content) const
+bool DocumentManager::readFile(const QString &fileName, QString &content, QString *encoding, LineEndings *lineEndings,
+                               bool *byteOrderMark) const
 {
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        return false;
-    }
-
-    QTextStream in(&file);
-    content = in.readAll();
-    file.close();
-
-    return true;
+    return FileLoader::readAll(fileName, content, encoding, lineEndings, byteOrderMark);
 }
 
-bool DocumentManager::writeFile(const QString &fileName, const QString &content)
+bool DocumentManager::writeFile(Editor *editor, const QString &fileName)
 {
-    // Create backup before writing
-    if (QFile::exists(fileName))
+    // Let a background save of the same document land first
+    QPointer<QThread> pending = pendingSaves.value(editor);
+    if (pending)
     {
-        QFile::copy(fileName, fileName + ".bak");
+        pending->wait();
     }
 
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    // Blocking save through the same atomic path as background saves; on the
+    // GUI thread the document blocks can be encoded directly
+    FileSaver saver(fileName, editor->document(), fsyncPolicy);
+    saver.setLineSeparator(LineEndings::separator(editor->lineEnding()));
+    saver.setLineTerminators(editor->lineTerminators());
+    applyEncoding(saver, editor);
+    if (!saver.save())
     {
+        qWarning() << "DocumentManager:" << saver.errorString();
         return false;
     }
 
-    QTextStream out(&file);
-    out << content;
-    file.close();
+    if (editor->fileName() != fileName)
+    {
+        editor->setFileName(fileName);
+        addRecentFile(fileName);
+    }
+    editor->setModified(false);
+    journal->rebase(editor);
+    createBackup(fileName);
 
     emit fileSaved(fileName);
     return true;
@@ -243,23 +518,13 @@ void DocumentManager::updateRecentFiles(const QString &fileName)
 
 QString DocumentManager::detectEncoding(const QString &fileName) const
 {
-    // TODO: Implement encoding detection
-    return "UTF-8";
+    return EncodingDetector::encodingName(EncodingDetector::detectFile(fileName).encoding);
 }
 
 bool DocumentManager::isTextFile(const QString &fileName) const
 {
-    QFileInfo fileInfo(fileName);
-    QString suffix = fileInfo.suffix().toLower();
-
-    QStringList textExtensions = {
-        "txt", "cpp", "h", "hpp", "c", "cc", "cxx",
-        "py", "js", "ts", "json", "xml", "html", "css",
-        "java", "cs", "rb", "go", "rs", "php", "swift",
-        "sh", "bash", "sql", "md", "yml", "yaml", "toml",
-        "ini", "conf", "config", "gradle", "maven", "cmake"};
-
-    return textExtensions.contains(suffix);
+    // Decided by content rather than by extension
+    return EncodingDetector::detectFile(fileName).encoding != EncodingDetector::Binary;
 }
 
 void DocumentManager::loadSettings()
@@ -267,8 +532,11 @@ void DocumentManager::loadSettings()
     QSettings settings("TextEditor", "TextEditor");
     recentFiles = settings.value("recentFiles", QStringList()).toStringList();
     maxRecentFiles = settings.value("maxRecentFiles", 10).toInt();
-    autoSaveEnabled = settings.value("autoSaveEnabled", false).toBool();
-    autoSaveInterval = settings.value("autoSaveInterval", 60000).toInt();
+    autoSaveEnabled = settings.value("autoSaveEnabled", autoSaveEnabled).toBool();
+    autoSaveInterval = settings.value("autoSaveInterval", autoSaveInterval).toInt();
+    largeFileThreshold = settings.value("largeFileThreshold", largeFileThreshold).toLongLong();
+    fsyncPolicy = static_cast<FileSaver::FsyncPolicy>(settings.value("fsyncPolicy", int(fsyncPolicy)).toInt());
+    backupStore->setMaxVersions(settings.value("backupVersions", backupStore->maxVersions()).toInt());
 }
 
 void DocumentManager::saveSettings()
@@ -278,4 +546,7 @@ void DocumentManager::saveSettings()
     settings.setValue("maxRecentFiles", maxRecentFiles);
     settings.setValue("autoSaveEnabled", autoSaveEnabled);
     settings.setValue("autoSaveInterval", autoSaveInterval);
+    settings.setValue("largeFileThreshold", largeFileThreshold);
+    settings.setValue("fsyncPolicy", int(fsyncPolicy));
+    settings.setValue("backupVersions", backupStore->maxVersions());
 }
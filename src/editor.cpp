@@ -1,6 +1,9 @@
 #include "editor.h"
 #include "undoredostack.h"
 #include "syntaxhighlighter.h"
+#include "piecetable.h"
+#include "trigramindex.h"
+#include "literalsearcher.h"
 
 #include <QPainter>
 #include <QTextEdit>
@@ -12,6 +15,7 @@
 #include <QTextBlock>
 #include <QFont>
 #include <QFontMetrics>
+#include <QTimer>
 #include <QDebug>
 
 /**
@@ -38,7 +42,7 @@ private:
 };
 
 Editor::Editor(QWidget *parent)
-    : QPlainTextEdit(parent), lineNumberArea(std::make_unique<LineNumberArea>(this)), undoRedoStack(std::make_unique<UndoRedoStack>(this)), syntaxHighlighter(std::make_unique<SyntaxHighlighter>(document())), currentFileName("Untitled"), currentFontSize(12), displayLineNumbers(true), highlightingEnabled(true)
+    : QPlainTextEdit(parent), lineNumberArea(std::make_unique<LineNumberArea>(this)), undoRedoStack(std::make_unique<UndoRedoStack>(this)), syntaxHighlighter(std::make_unique<SyntaxHighlighter>(document())), pieceTable(std::make_unique<PieceTable>()), highlightTimer(std::make_unique<QTimer>()), highlightFrom(0), highlightTo(0), highlightsStale(false), currentFileName("Untitled"), textEncoding("UTF-8"), byteOrderMark(false), lineEndingStyle(LineEndings::nativeStyle()), mixedLineEndings(false), currentFontSize(12), displayLineNumbers(true), highlightingEnabled(true), pieceTableSyncSuspended(false), loading(false)
 {
     // Setup font
     QFont font("Courier New", currentFontSize);
@@ -52,6 +56,8 @@ Editor::Editor(QWidget *parent)
             this, &Editor::updateLineNumberArea);
     connect(this, &QPlainTextEdit::cursorPositionChanged,
             this, &Editor::onCursorPositionChanged);
+    connect(document(), &QTextDocument::contentsChange,
+            this, &Editor::onContentsChange);
     connect(document(), &QTextDocument::modificationChanged,
             [this](bool changed)
             {
@@ -61,6 +67,17 @@ Editor::Editor(QWidget *parent)
                 }
             });
 
+    // Search highlights are recomputed once per event loop pass at most
+    highlightTimer->setSingleShot(true);
+    highlightTimer->setInterval(0);
+    connect(highlightTimer.get(), &QTimer::timeout, this, &Editor::updateHighlights);
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [this]()
+            {
+                scheduleHighlights(false);
+                updateVisibleBlocks(); });
+    connect(document(), &QTextDocument::contentsChange, this, [this]()
+            { scheduleHighlights(true); });
+
     // Setup tab width
     QFontMetrics fm(font);
     setTabStopDistance(4 * fm.horizontalAdvance(' '));
@@ -101,6 +118,58 @@ void Editor::setModified(bool modified)
     document()->setModified(modified);
 }
 
+void Editor::setLineEnding(LineEndings::Style style, bool mixed)
+{
+    lineEndingStyle = style;
+    mixedLineEndings = mixed;
+}
+
+void Editor::loadText(const QString &text)
+{
+    // The piece table shares the loaded buffer as its original piece, so
+    // the document change below must not be mirrored a second time
+    pieceTable->setOriginal(text);
+    pieceTableSyncSuspended = true;
+    setPlainText(text);
+    pieceTableSyncSuspended = false;
+    invalidateSearchIndex();
+    emit textReset();
+}
+
+void Editor::beginLoading()
+{
+    loading = true;
+    pieceTable->clear();
+    invalidateSearchIndex();
+    pieceTableSyncSuspended = true;
+    clear();
+    pieceTableSyncSuspended = false;
+
+    // Chunks are not undoable and the user cannot edit a half-loaded file
+    document()->setUndoRedoEnabled(false);
+    setReadOnly(true);
+}
+
+void Editor::appendLoadedText(const QString &text, const QVector<qsizetype> &lineFeeds)
+{
+    pieceTable->appendOriginal(text, lineFeeds);
+    invalidateSearchIndex();
+
+    pieceTableSyncSuspended = true;
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(text);
+    pieceTableSyncSuspended = false;
+}
+
+void Editor::endLoading()
+{
+    loading = false;
+    setReadOnly(false);
+    document()->setUndoRedoEnabled(true);
+    document()->setModified(false);
+}
+
 int Editor::lineCount() const
 {
     return blockCount();
@@ -274,6 +343,51 @@ void Editor::setFontSize(int size)
     updateLineNumberAreaWidth(0);
 }
 
+void Editor::setSearchIndexEnabled(bool enabled)
+{
+    // The index is built by the first search that uses it
+    if (enabled && !searchIndex)
+    {
+        searchIndex = std::make_shared<TrigramIndex>();
+    }
+    else if (!enabled)
+    {
+        searchIndex.reset();
+    }
+}
+
+void Editor::setSearchIndexMemoryLimit(qint64 bytes)
+{
+    if (!searchIndex || searchIndex->getMemoryLimit() == bytes)
+        return;
+
+    // A new limit takes effect when the index is next built
+    auto index = std::make_shared<TrigramIndex>();
+    index->setMemoryLimit(bytes);
+    searchIndex = index;
+}
+
+void Editor::adoptSearchIndex(const std::shared_ptr<TrigramIndex> &index)
+{
+    // Only an index of the current text replaces one that is not built yet
+    if (!searchIndex || searchIndex->isBuilt() || !index || index->textLength() != pieceTable->length())
+        return;
+
+    index->setMemoryLimit(searchIndex->getMemoryLimit());
+    searchIndex = index;
+}
+
+void Editor::invalidateSearchIndex()
+{
+    if (!searchIndex || !searchIndex->isBuilt())
+        return;
+
+    // Replaced rather than cleared, in case a search worker is reading it
+    auto index = std::make_shared<TrigramIndex>();
+    index->setMemoryLimit(searchIndex->getMemoryLimit());
+    searchIndex = index;
+}
+
 void Editor::setSyntaxHighlighting(bool enabled)
 {
     highlightingEnabled = enabled;
@@ -289,17 +403,110 @@ void Editor::setSyntaxHighlighting(bool enabled)
 
 void Editor::updateSyntaxHighlighting()
 {
-    syntaxHighlighter->rehighlight();
+    syntaxHighlighter->scheduleRehighlight();
+}
+
+void Editor::setMatchSource(MatchSource source)
+{
+    matchSource = std::move(source);
+    if (matchSource)
+    {
+        scheduleHighlights(true);
+    }
+    else
+    {
+        highlightTimer->stop();
+        setExtraSelections({});
+    }
 }
 
 void Editor::highlightOccurrences(const QString &text)
 {
-    // TODO: Implement occurrence highlighting
+    if (text.isEmpty())
+    {
+        clearHighlights();
+        return;
+    }
+
+    LiteralSearcher searcher(text, Qt::CaseInsensitive);
+    setMatchSource([this, searcher](int from, int to)
+                   {
+        QVector<QPair<int, int>> ranges;
+        if (pieceTable->length() != document()->characterCount() - 1)
+            return ranges;
+
+        QString window = pieceTable->text(from, to - from);
+        for (qsizetype position = searcher.indexIn(window); position >= 0;
+             position = searcher.indexIn(window, position + searcher.length()))
+        {
+            ranges.append(qMakePair(int(from + position), int(from + position + searcher.length())));
+        }
+        return ranges; });
 }
 
 void Editor::clearHighlights()
 {
-    // TODO: Implement highlight clearing
+    setMatchSource(nullptr);
+}
+
+void Editor::scheduleHighlights(bool textChanged)
+{
+    if (!matchSource)
+        return;
+
+    highlightsStale = highlightsStale || textChanged;
+    highlightTimer->start();
+}
+
+void Editor::updateHighlights()
+{
+    if (!matchSource)
+        return;
+
+    // Visible blocks, then a page of margin either way so short scrolls
+    // stay within the lines already highlighted
+    QTextBlock first = firstVisibleBlock();
+    QTextBlock last = first;
+    int visibleLines = 0;
+    qreal top = blockBoundingGeometry(first).translated(contentOffset()).top();
+    for (QTextBlock block = first; block.isValid() && top <= viewport()->height(); block = block.next())
+    {
+        last = block;
+        top += blockBoundingRect(block).height();
+        ++visibleLines;
+    }
+
+    int visibleFrom = first.position();
+    int visibleTo = last.position() + last.length() - 1;
+    if (!highlightsStale && visibleFrom >= highlightFrom && visibleTo <= highlightTo)
+        return;
+
+    QTextBlock fromBlock = document()->findBlockByNumber(qMax(0, first.blockNumber() - visibleLines));
+    QTextBlock toBlock = document()->findBlockByNumber(qMin(blockCount() - 1, last.blockNumber() + visibleLines));
+    highlightFrom = fromBlock.position();
+    highlightTo = toBlock.position() + toBlock.length() - 1;
+    highlightsStale = false;
+
+    const QVector<QPair<int, int>> ranges = matchSource(highlightFrom, highlightTo);
+
+    QTextCharFormat format;
+    format.setBackground(QColor(255, 230, 80));
+
+    QList<QTextEdit::ExtraSelection> selections;
+    selections.reserve(qMin<qsizetype>(ranges.size(), MaxHighlights));
+    for (const QPair<int, int> &range : ranges)
+    {
+        if (selections.size() >= MaxHighlights)
+            break;
+
+        QTextEdit::ExtraSelection selection;
+        selection.cursor = QTextCursor(document());
+        selection.cursor.setPosition(range.first);
+        selection.cursor.setPosition(range.second, QTextCursor::KeepAnchor);
+        selection.format = format;
+        selections.append(selection);
+    }
+    setExtraSelections(selections);
 }
 
 void Editor::resizeEvent(QResizeEvent *event)
@@ -310,6 +517,17 @@ void Editor::resizeEvent(QResizeEvent *event)
     lineNumberArea->setGeometry(
         cr.left(), cr.top(),
         lineNumberAreaWidth(), cr.height());
+
+    scheduleHighlights(false);
+    updateVisibleBlocks();
+}
+
+void Editor::updateVisibleBlocks()
+{
+    // Every block takes at least one line, which bounds the last visible one
+    int first = firstVisibleBlock().blockNumber();
+    int lines = viewport()->height() / qMax(1, fontMetrics().height()) + 1;
+    syntaxHighlighter->setVisibleBlocks(first, first + lines);
 }
 
 void Editor::keyPressEvent(QKeyEvent *event)
@@ -390,6 +608,59 @@ void Editor::onCursorPositionChanged()
     // Could emit signal with current position
 }
 
+void Editor::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    if (pieceTableSyncSuspended)
+        return;
+
+    // QTextDocument may count its implicit final paragraph separator in the
+    // reported ranges, so clamp both sides to the real text length
+    qsizetype documentLength = document()->characterCount() - 1;
+    qsizetype removed = qMin<qsizetype>(charsRemoved, pieceTable->length() - position);
+    qsizetype added = qMin<qsizetype>(charsAdded, documentLength - position);
+
+    QString text;
+    if (added > 0)
+    {
+        QTextCursor cursor(document());
+        cursor.setPosition(position);
+        cursor.setPosition(position + added, QTextCursor::KeepAnchor);
+        text = cursor.selectedText();
+        text.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+    }
+
+    // Format-only changes (e.g. from the highlighter) report equal removed
+    // and added counts over unchanged text
+    if (removed == added && pieceTable->text(position, removed) == text)
+        return;
+
+    if (!mixedTerminators.isEmpty())
+    {
+        qsizetype line = pieceTable->lineAt(position);
+        mixedTerminators.linesChanged(line, pieceTable->lineAt(position + removed) - line, text.count(QLatin1Char('\n')));
+    }
+
+    pieceTable->remove(position, removed);
+    pieceTable->insert(position, text);
+
+    if (pieceTable->length() != documentLength)
+    {
+        resyncPieceTable();
+        return;
+    }
+
+    if (searchIndex && searchIndex->isBuilt())
+    {
+        // A search worker may still be reading the index; copying it would
+        // stall typing, so the next query rebuilds it on its worker instead
+        if (searchIndex.use_count() > 1)
+            invalidateSearchIndex();
+        else
+            searchIndex->update(*pieceTable, position, removed, text);
+    }
+    emit textEdited(position, int(removed), text);
+}
+
 void Editor::lineNumberAreaPaintEvent(QPaintEvent *event)
 {
     if (!displayLineNumbers)
@@ -440,10 +711,17 @@ int Editor::lineNumberAreaWidth() const
 
 QString Editor::getLineText(int lineNumber) const
 {
-    QTextBlock block = document()->findBlockByNumber(lineNumber);
-    if (block.isValid())
+    if (lineNumber >= 0 && lineNumber < pieceTable->lineCount())
     {
-        return block.text();
+        return pieceTable->lineText(lineNumber);
     }
     return "";
 }
+
+void Editor::resyncPieceTable()
+{
+    qWarning() << "Editor: piece table out of sync, rebuilding from document";
+    pieceTable->setOriginal(toPlainText());
+    invalidateSearchIndex();
+    emit textReset();
+}
@@ -0,0 +1,497 @@
+#include "encodingdetector.h"
+
+#include <QFile>
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENCODINGDETECTOR_SSE2
+#include <emmintrin.h>
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ENCODINGDETECTOR_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace
+{
+    /**
+     * @brief Incremental UTF-8 validator working one byte at a time
+     *
+     * Tracks how many continuation bytes are still expected and the allowed
+     * range of the next one, which rejects overlong forms, surrogates and
+     * code points above U+10FFFF.
+     */
+    struct Utf8State
+    {
+        int remaining = 0;
+        uchar lower = 0x80;
+        uchar upper = 0xBF;
+        bool valid = true;
+
+        void feed(uchar byte)
+        {
+            if (remaining > 0)
+            {
+                if (byte < lower || byte > upper)
+                {
+                    valid = false;
+                    remaining = 0;
+                    return;
+                }
+                --remaining;
+                lower = 0x80;
+                upper = 0xBF;
+                return;
+            }
+
+            if (byte < 0x80)
+                return;
+
+            if (byte >= 0xC2 && byte <= 0xDF)
+            {
+                remaining = 1;
+            }
+            else if (byte == 0xE0)
+            {
+                remaining = 2;
+                lower = 0xA0;
+            }
+            else if (byte == 0xED)
+            {
+                remaining = 2;
+                upper = 0x9F;
+            }
+            else if (byte >= 0xE1 && byte <= 0xEF)
+            {
+                remaining = 2;
+            }
+            else if (byte == 0xF0)
+            {
+                remaining = 3;
+                lower = 0x90;
+            }
+            else if (byte == 0xF4)
+            {
+                remaining = 3;
+                upper = 0x8F;
+            }
+            else if (byte >= 0xF1 && byte <= 0xF3)
+            {
+                remaining = 3;
+            }
+            else
+            {
+                valid = false;
+            }
+        }
+    };
+
+    struct ScanStatistics
+    {
+        Utf8State utf8;
+        qsizetype nulEven = 0;
+        qsizetype nulOdd = 0;
+        qsizetype control = 0;
+
+        bool isControl(uchar byte) const
+        {
+            return byte < 0x20 && byte != '\t' && byte != '\n' && byte != '\r' && byte != '\f';
+        }
+
+        void scanScalar(const uchar *data, qsizetype begin, qsizetype end)
+        {
+            for (qsizetype i = begin; i < end; ++i)
+            {
+                uchar byte = data[i];
+                if (byte == 0)
+                {
+                    (i & 1) ? ++nulOdd : ++nulEven;
+                }
+                if (isControl(byte))
+                {
+                    ++control;
+                }
+                utf8.feed(byte);
+            }
+        }
+
+        // Bit i of each mask describes byte i of a block starting at an even offset
+        void countAsciiBlock(quint32 nulMask, quint32 controlMask)
+        {
+            nulEven += qPopulationCount(nulMask & 0x55555555u);
+            nulOdd += qPopulationCount(nulMask & 0xAAAAAAAAu);
+            control += qPopulationCount(controlMask);
+        }
+    };
+
+#ifdef ENCODINGDETECTOR_SSE2
+    qsizetype scanSse2(const uchar *data, qsizetype size, ScanStatistics &stats)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i space = _mm_set1_epi8(0x20);
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i lineFeed = _mm_set1_epi8('\n');
+        const __m128i carriageReturn = _mm_set1_epi8('\r');
+        const __m128i formFeed = _mm_set1_epi8('\f');
+
+        qsizetype i = 0;
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            if (_mm_movemask_epi8(block) != 0 || stats.utf8.remaining > 0)
+            {
+                stats.scanScalar(data, i, i + 16);
+                continue;
+            }
+
+            // All bytes are ASCII, so a signed compare finds the control range
+            __m128i whitespace = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, tab), _mm_cmpeq_epi8(block, lineFeed)),
+                                              _mm_or_si128(_mm_cmpeq_epi8(block, carriageReturn), _mm_cmpeq_epi8(block, formFeed)));
+            __m128i controls = _mm_andnot_si128(whitespace, _mm_cmplt_epi8(block, space));
+            stats.countAsciiBlock(quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero))),
+                                  quint32(_mm_movemask_epi8(controls)));
+        }
+        return i;
+    }
+#endif
+
+#ifdef ENCODINGDETECTOR_AVX2
+    /**
+     * @brief Vectorized UTF-8 validation, 32 bytes at a time
+     *
+     * The lookup algorithm of Keiser and Lemire: three table lookups on
+     * the nibbles of each byte and of the byte before it flag every invalid
+     * two-byte combination, and the bytes two and three back tell where a
+     * continuation is required. Blocks of pure ASCII only have to check that
+     * the previous block did not end inside a character.
+     */
+    namespace Utf8Lookup
+    {
+        constexpr char TooShort = 1 << 0;
+        constexpr char TooLong = 1 << 1;
+        constexpr char Overlong3 = 1 << 2;
+        constexpr char TooLarge = 1 << 3;
+        constexpr char Surrogate = 1 << 4;
+        constexpr char Overlong2 = 1 << 5;
+        constexpr char TooLarge1000 = 1 << 6;
+        constexpr char Overlong4 = 1 << 6;
+        constexpr char TwoContinuations = char(1 << 7);
+        constexpr char Carry = TooShort | TooLong | TwoContinuations;
+
+        __attribute__((target("avx2"))) inline __m256i table(char c0, char c1, char c2, char c3, char c4, char c5, char c6, char c7,
+                                                             char c8, char c9, char c10, char c11, char c12, char c13, char c14, char c15)
+        {
+            return _mm256_setr_epi8(c0, c1, c2, c3, c4, c5, c6, c7, c8, c9, c10, c11, c12, c13, c14, c15,
+                                    c0, c1, c2, c3, c4, c5, c6, c7, c8, c9, c10, c11, c12, c13, c14, c15);
+        }
+
+        __attribute__((target("avx2"))) inline __m256i highNibbles(__m256i bytes)
+        {
+            return _mm256_and_si256(_mm256_srli_epi16(bytes, 4), _mm256_set1_epi8(0x0F));
+        }
+
+        // The input shifted back by N bytes, continuing from the previous block
+        template <int N>
+        __attribute__((target("avx2"))) inline __m256i previous(__m256i input, __m256i previousInput)
+        {
+            return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previousInput, input, 0x21), 16 - N);
+        }
+
+        __attribute__((target("avx2"))) inline __m256i errors(__m256i input, __m256i previousInput)
+        {
+            const __m256i previous1 = previous<1>(input, previousInput);
+            const __m256i byte1High = _mm256_shuffle_epi8(
+                table(TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong,
+                      TwoContinuations, TwoContinuations, TwoContinuations, TwoContinuations,
+                      TooShort | Overlong2, TooShort, TooShort | Overlong3 | Surrogate,
+                      TooShort | TooLarge | TooLarge1000 | Overlong4),
+                highNibbles(previous1));
+            const __m256i byte1Low = _mm256_shuffle_epi8(
+                table(Carry | Overlong3 | Overlong2 | Overlong4, Carry | Overlong2, Carry, Carry,
+                      Carry | TooLarge, Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000,
+                      Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000,
+                      Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000 | Surrogate, Carry | TooLarge | TooLarge1000,
+                      Carry | TooLarge | TooLarge1000),
+                _mm256_and_si256(previous1, _mm256_set1_epi8(0x0F)));
+            const __m256i byte2High = _mm256_shuffle_epi8(
+                table(TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort,
+                      TooLong | Overlong2 | TwoContinuations | Overlong3 | TooLarge1000 | Overlong4,
+                      TooLong | Overlong2 | TwoContinuations | Overlong3 | TooLarge,
+                      TooLong | Overlong2 | TwoContinuations | Surrogate | TooLarge,
+                      TooLong | Overlong2 | TwoContinuations | Surrogate | TooLarge,
+                      TooShort, TooShort, TooShort, TooShort),
+                highNibbles(input));
+            const __m256i special = _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+
+            // Bytes after a three- or four-byte lead must be continuations;
+            // the tables above already flagged the pairs, this the lengths
+            const __m256i third = _mm256_subs_epu8(previous<2>(input, previousInput), _mm256_set1_epi8(char(0xE0 - 0x80)));
+            const __m256i fourth = _mm256_subs_epu8(previous<3>(input, previousInput), _mm256_set1_epi8(char(0xF0 - 0x80)));
+            const __m256i required = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(char(0x80)));
+            return _mm256_xor_si256(required, special);
+        }
+
+        // Nonzero where the block ends inside a character
+        __attribute__((target("avx2"))) inline __m256i incomplete(__m256i input)
+        {
+            const __m256i limits = _mm256_setr_epi8(
+                char(255), char(255), char(255), char(255), char(255), char(255), char(255), char(255),
+                char(255), char(255), char(255), char(255), char(255), char(255), char(255), char(255),
+                char(255), char(255), char(255), char(255), char(255), char(255), char(255), char(255),
+                char(255), char(255), char(255), char(255), char(255), char(0xF0 - 1), char(0xE0 - 1), char(0xC0 - 1));
+            return _mm256_subs_epu8(input, limits);
+        }
+    }
+
+    __attribute__((target("avx2"))) qsizetype scanAvx2(const uchar *data, qsizetype size, ScanStatistics &stats)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i space = _mm256_set1_epi8(0x20);
+        const __m256i tab = _mm256_set1_epi8('\t');
+        const __m256i lineFeed = _mm256_set1_epi8('\n');
+        const __m256i carriageReturn = _mm256_set1_epi8('\r');
+        const __m256i formFeed = _mm256_set1_epi8('\f');
+
+        __m256i error = zero;
+        __m256i previousInput = zero;
+        __m256i previousIncomplete = zero;
+
+        qsizetype i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            quint32 high = quint32(_mm256_movemask_epi8(block));
+            if (high == 0)
+            {
+                error = _mm256_or_si256(error, previousIncomplete);
+                previousIncomplete = zero;
+            }
+            else
+            {
+                error = _mm256_or_si256(error, Utf8Lookup::errors(block, previousInput));
+                previousIncomplete = Utf8Lookup::incomplete(block);
+            }
+            previousInput = block;
+
+            // Bytes of 0x80 and above compare as negative; mask them out
+            __m256i whitespace = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, tab), _mm256_cmpeq_epi8(block, lineFeed)),
+                                                 _mm256_or_si256(_mm256_cmpeq_epi8(block, carriageReturn), _mm256_cmpeq_epi8(block, formFeed)));
+            __m256i controls = _mm256_andnot_si256(whitespace, _mm256_cmpgt_epi8(space, block));
+            stats.countAsciiBlock(quint32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero))),
+                                  quint32(_mm256_movemask_epi8(controls)) & ~high);
+        }
+
+        if (!_mm256_testz_si256(error, error))
+        {
+            stats.utf8.valid = false;
+        }
+
+        // A character cut off by the last block is left to the scalar tail,
+        // which starts over at its lead byte
+        if (i >= 3)
+        {
+            if (data[i - 1] >= 0xC0)
+                return i - 1;
+            if (data[i - 2] >= 0xE0)
+                return i - 2;
+            if (data[i - 3] >= 0xF0)
+                return i - 3;
+        }
+        return i;
+    }
+
+    bool cpuHasAvx2()
+    {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+#endif
+
+    ScanStatistics scan(const uchar *data, qsizetype size)
+    {
+        ScanStatistics stats;
+        qsizetype done = 0;
+
+#if defined(ENCODINGDETECTOR_AVX2)
+        done = cpuHasAvx2() ? scanAvx2(data, size, stats) : scanSse2(data, size, stats);
+#elif defined(ENCODINGDETECTOR_SSE2)
+        done = scanSse2(data, size, stats);
+#endif
+
+        stats.scanScalar(data, done, size);
+        return stats;
+    }
+
+    bool startsWith(const uchar *data, qsizetype size, const char *prefix, qsizetype length)
+    {
+        return size >= length && std::memcmp(data, prefix, size_t(length)) == 0;
+    }
+}
+
+EncodingDetector::Result EncodingDetector::detect(const char *data, qsizetype size, bool atEnd)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    Result result;
+
+    // UTF-32 first: its little-endian BOM starts with the UTF-16 one
+    if (startsWith(bytes, size, "\xEF\xBB\xBF", 3))
+    {
+        result.bomLength = 3;
+    }
+    else if (startsWith(bytes, size, "\xFF\xFE\x00\x00", 4))
+    {
+        result.encoding = Utf32LE;
+        result.bomLength = 4;
+    }
+    else if (startsWith(bytes, size, "\x00\x00\xFE\xFF", 4))
+    {
+        result.encoding = Utf32BE;
+        result.bomLength = 4;
+    }
+    else if (startsWith(bytes, size, "\xFF\xFE", 2))
+    {
+        result.encoding = Utf16LE;
+        result.bomLength = 2;
+    }
+    else if (startsWith(bytes, size, "\xFE\xFF", 2))
+    {
+        result.encoding = Utf16BE;
+        result.bomLength = 2;
+    }
+
+    if (result.bomLength > 0)
+        return result;
+
+    ScanStatistics stats = scan(bytes, size);
+
+    // ASCII-heavy UTF-16 has a NUL in nearly every other byte; binary data
+    // has NULs on both sides
+    const qsizetype units = size / 2;
+    if (units > 0)
+    {
+        if (stats.nulOdd * 10 >= units * 3 && stats.nulEven * 20 <= units)
+        {
+            result.encoding = Utf16LE;
+            return result;
+        }
+        if (stats.nulEven * 10 >= units * 3 && stats.nulOdd * 20 <= units)
+        {
+            result.encoding = Utf16BE;
+            return result;
+        }
+    }
+
+    if (stats.nulEven + stats.nulOdd > 0)
+    {
+        result.encoding = Binary;
+    }
+    else if (stats.utf8.valid && (stats.utf8.remaining == 0 || !atEnd))
+    {
+        result.encoding = Utf8;
+    }
+    else if (stats.control * 10 > size)
+    {
+        result.encoding = Binary;
+    }
+    else
+    {
+        // Not UTF-8 but mostly printable: some legacy 8-bit encoding
+        result.encoding = Latin1;
+    }
+    return result;
+}
+
+EncodingDetector::Result EncodingDetector::detectFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return Result();
+    }
+
+    QByteArray sample = file.read(SampleSize);
+    return detect(sample.constData(), sample.size(), file.atEnd());
+}
+
+bool EncodingDetector::isValidUtf8(const char *data, qsizetype size, bool atEnd)
+{
+    ScanStatistics stats = scan(reinterpret_cast<const uchar *>(data), size);
+    return stats.utf8.valid && (stats.utf8.remaining == 0 || !atEnd);
+}
+
+bool EncodingDetector::endsMidCharacter(Encoding encoding, const char *data, qsizetype size)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    switch (encoding)
+    {
+    case Utf8:
+    {
+        // Find the lead byte of the last character, at most three back
+        qsizetype continuation = 0;
+        while (continuation < 3 && continuation < size && (bytes[size - 1 - continuation] & 0xC0) == 0x80)
+        {
+            ++continuation;
+        }
+        if (continuation == size)
+            return false;
+
+        uchar lead = bytes[size - 1 - continuation];
+        int length = (lead >= 0xC2 && lead <= 0xDF) ? 2 : (lead >= 0xE0 && lead <= 0xEF) ? 3 : (lead >= 0xF0 && lead <= 0xF4) ? 4 : 1;
+        return continuation + 1 < length;
+    }
+    case Utf16LE:
+    case Utf16BE:
+        return size % 2 != 0;
+    case Utf32LE:
+    case Utf32BE:
+        return size % 4 != 0;
+    case Latin1:
+    case Binary:
+        break;
+    }
+    return false;
+}
+
+QString EncodingDetector::encodingName(Encoding encoding)
+{
+    switch (encoding)
+    {
+    case Utf8:
+        return "UTF-8";
+    case Utf16LE:
+        return "UTF-16LE";
+    case Utf16BE:
+        return "UTF-16BE";
+    case Utf32LE:
+        return "UTF-32LE";
+    case Utf32BE:
+        return "UTF-32BE";
+    case Latin1:
+        return "ISO-8859-1";
+    case Binary:
+        return "Binary";
+    }
+    return QString();
+}
+
+QStringConverter::Encoding EncodingDetector::converterEncoding(Encoding encoding)
+{
+    switch (encoding)
+    {
+    case Utf16LE:
+        return QStringConverter::Utf16LE;
+    case Utf16BE:
+        return QStringConverter::Utf16BE;
+    case Utf32LE:
+        return QStringConverter::Utf32LE;
+    case Utf32BE:
+        return QStringConverter::Utf32BE;
+    case Latin1:
+        return QStringConverter::Latin1;
+    case Utf8:
+    case Binary:
+        break;
+    }
+    return QStringConverter::Utf8;
+}
@@ -0,0 +1,162 @@
+#include "fileloader.h"
+#include "encodingdetector.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QStringDecoder>
+
+FileLoader::FileLoader(const QString &fileName, QObject *parent)
+    : QObject(parent), sourceFileName(fileName), byteOrderMark(false), cancelled(false), freeSlots(MaxPendingChunks)
+{
+}
+
+FileLoader::~FileLoader() = default;
+
+void FileLoader::cancel()
+{
+    cancelled.store(true);
+}
+
+void FileLoader::chunkConsumed()
+{
+    freeSlots.release();
+}
+
+void FileLoader::load()
+{
+    QFile file(sourceFileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        emit failed(file.errorString());
+        return;
+    }
+
+    const qint64 totalBytes = file.size();
+
+    // The detection sample is decoded afterwards instead of being read again
+    QByteArray sample = file.read(EncodingDetector::SampleSize);
+    EncodingDetector::Result detected = EncodingDetector::detect(sample.constData(), sample.size(), file.atEnd());
+    if (detected.encoding == EncodingDetector::Binary)
+    {
+        emit failed(tr("The file appears to be binary"));
+        return;
+    }
+    detectedEncoding = EncodingDetector::encodingName(detected.encoding);
+    byteOrderMark = detected.bomLength > 0;
+
+    QStringDecoder decoder(EncodingDetector::converterEncoding(detected.encoding));
+    qint64 bytesRead = 0;
+    qint64 chunkSize = FirstChunkSize;
+    qsizetype sampleOffset = 0;
+    QByteArray tail;
+
+    while (sampleOffset < sample.size() || !file.atEnd())
+    {
+        if (isCancelled())
+        {
+            emit aborted();
+            return;
+        }
+
+        QByteArray bytes;
+        if (sampleOffset < sample.size())
+        {
+            bytes = sample.mid(sampleOffset, chunkSize);
+            sampleOffset += bytes.size();
+        }
+        else
+        {
+            bytes = file.read(chunkSize);
+            if (bytes.isEmpty() && file.error() != QFileDevice::NoError)
+            {
+                emit failed(file.errorString());
+                return;
+            }
+        }
+        bytesRead += bytes.size();
+        chunkSize = ChunkSize;
+        tail = (tail + bytes).right(4);
+
+        // The decoder keeps partial multi-byte sequences between chunks
+        QString text = decoder.decode(bytes);
+        if (file.atEnd() && sampleOffset >= sample.size())
+        {
+            appendTruncatedCharacter(text, detected.encoding, tail);
+        }
+        QVector<qsizetype> lineFeeds;
+        detectedLineEndings.normalize(text, &lineFeeds);
+
+        if (!text.isEmpty())
+        {
+            if (!waitForFreeSlot())
+            {
+                emit aborted();
+                return;
+            }
+            emit chunkLoaded(text, lineFeeds);
+        }
+        emit progress(bytesRead, totalBytes);
+    }
+
+    emit finished();
+}
+
+void FileLoader::appendTruncatedCharacter(QString &text, EncodingDetector::Encoding encoding, const QByteArray &tail)
+{
+    // A character cut off by the end of the file is never flushed by the
+    // decoder; it stands for U+FFFD like any other malformed input
+    if (EncodingDetector::endsMidCharacter(encoding, tail.constData(), tail.size()))
+    {
+        text.append(QChar::ReplacementCharacter);
+    }
+}
+
+bool FileLoader::waitForFreeSlot()
+{
+    while (!freeSlots.tryAcquire(1, 50))
+    {
+        if (isCancelled())
+            return false;
+    }
+    return true;
+}
+
+bool FileLoader::readAll(const QString &fileName, QString &content, QString *encoding, LineEndings *lineEndings,
+                         bool *byteOrderMark)
+{
+    // Binary mode: line endings are detected and normalized below
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QByteArray bytes = file.readAll();
+    file.close();
+
+    qsizetype sampleSize = qMin<qsizetype>(bytes.size(), EncodingDetector::SampleSize);
+    EncodingDetector::Result detected = EncodingDetector::detect(bytes.constData(), sampleSize, sampleSize == bytes.size());
+    if (detected.encoding == EncodingDetector::Binary)
+    {
+        qWarning() << "FileLoader: refusing to open binary file" << fileName;
+        return false;
+    }
+
+    QStringDecoder decoder(EncodingDetector::converterEncoding(detected.encoding));
+    content = decoder.decode(bytes);
+    appendTruncatedCharacter(content, detected.encoding, bytes.right(4));
+
+    LineEndings localLineEndings;
+    (lineEndings ? *lineEndings : localLineEndings).normalize(content);
+
+    if (encoding)
+    {
+        *encoding = EncodingDetector::encodingName(detected.encoding);
+    }
+    if (byteOrderMark)
+    {
+        *byteOrderMark = detected.bomLength > 0;
+    }
+
+    return true;
+}
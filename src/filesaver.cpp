@@ -0,0 +1,370 @@
+#include "filesaver.h"
+#include "chunkedtextwriter.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSignalBlocker>
+#include <QTemporaryFile>
+#include <QTextBlock>
+#include <QTextDocument>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Discards what is written; lets a save find out whether the text can
+    // be encoded before it touches the target
+    class NullDevice : public QIODevice
+    {
+    protected:
+        qint64 readData(char *data, qint64 maxSize) override
+        {
+            Q_UNUSED(data);
+            Q_UNUSED(maxSize);
+            return -1;
+        }
+
+        qint64 writeData(const char *data, qint64 maxSize) override
+        {
+            Q_UNUSED(data);
+            return maxSize;
+        }
+    };
+}
+
+FileSaver::FileSaver(const QString &fileName, const PieceTable::Snapshot &snapshot,
+                     FsyncPolicy policy, QObject *parent)
+    : QObject(parent), targetFileName(fileName), contents(snapshot), document(nullptr), fsyncPolicy(policy), lineSeparator(QStringLiteral("\n")), linesWritten(0), nextOverride(0), textEncoding(QStringConverter::Utf8), writeByteOrderMark(false)
+{
+}
+
+FileSaver::FileSaver(const QString &fileName, const QTextDocument *document,
+                     FsyncPolicy policy, QObject *parent)
+    : QObject(parent), targetFileName(fileName), document(document), fsyncPolicy(policy), lineSeparator(QStringLiteral("\n")), linesWritten(0), nextOverride(0), textEncoding(QStringConverter::Utf8), writeByteOrderMark(false)
+{
+}
+
+FileSaver::~FileSaver() = default;
+
+bool FileSaver::save()
+{
+    // A symlink is saved through: the file it points at is replaced and the
+    // link is left alone
+    QString targetPath = QFileInfo(targetFileName).canonicalFilePath();
+    if (targetPath.isEmpty())
+    {
+        targetPath = targetFileName;
+    }
+    QFileInfo target(targetPath);
+
+    // The temporary file lives next to the target so the rename stays atomic
+    QTemporaryFile file(target.absolutePath() + "/." + target.fileName() + ".XXXXXX");
+    if (!file.open())
+    {
+        // A directory the user cannot write to may still hold a file they
+        // can write; that file is then overwritten in place
+        if (target.exists() && target.isWritable())
+        {
+            return saveInPlace(targetPath);
+        }
+        return fail(tr("Cannot create temporary file: %1").arg(file.errorString()));
+    }
+
+    // QTemporaryFile creates the file owner-only; a new file gets the mode
+    // a plain create would have given it
+    bool attributes = target.exists() ? copyAttributes(file, targetPath) : applyDefaultMode(file);
+    if (!attributes)
+    {
+        return fail(tr("Cannot copy the permissions of %1").arg(targetFileName));
+    }
+
+    if (!writeFile(file))
+    {
+        return false;
+    }
+    file.close();
+
+    if (!replaceFile(file.fileName(), targetPath))
+    {
+        return fail(tr("Cannot replace %1").arg(targetFileName));
+    }
+    file.setAutoRemove(false);
+
+    if (fsyncPolicy == SyncFileAndDirectory && !syncDirectory(target.absolutePath()))
+    {
+        return fail(tr("Cannot sync directory %1").arg(target.absolutePath()));
+    }
+
+    lastError.clear();
+    emit finished(true, QString());
+    return true;
+}
+
+bool FileSaver::saveInPlace(const QString &targetPath)
+{
+    // Without the atomic replace a failed write would leave the file cut
+    // short, so text the encoding cannot hold is caught before truncating
+    if (!isEncodable())
+    {
+        return failUnencodable();
+    }
+
+    QFile file(targetPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return fail(tr("Cannot open %1: %2").arg(targetFileName, file.errorString()));
+    }
+
+    if (!writeFile(file))
+    {
+        return false;
+    }
+    file.close();
+
+    lastError.clear();
+    emit finished(true, QString());
+    return true;
+}
+
+bool FileSaver::writeFile(QFile &file)
+{
+    bool unencodable = false;
+    if (!writeContents(file, unencodable))
+    {
+        if (unencodable)
+        {
+            return failUnencodable();
+        }
+        return fail(tr("Cannot write %1: %2").arg(file.fileName(), file.errorString()));
+    }
+
+    if (!file.flush() || (fsyncPolicy != NoSync && !syncFile(file)))
+    {
+        return fail(tr("Cannot flush %1 to disk").arg(file.fileName()));
+    }
+    return true;
+}
+
+bool FileSaver::isEncodable()
+{
+    switch (textEncoding)
+    {
+    case QStringConverter::Utf8:
+    case QStringConverter::Utf16:
+    case QStringConverter::Utf16LE:
+    case QStringConverter::Utf16BE:
+    case QStringConverter::Utf32:
+    case QStringConverter::Utf32LE:
+    case QStringConverter::Utf32BE:
+        return true;
+    default:
+        break;
+    }
+
+    // A dry run through the encoder, without reporting progress twice
+    const QSignalBlocker blocker(this);
+    NullDevice device;
+    device.open(QIODevice::WriteOnly);
+    bool unencodable = false;
+    writeContents(device, unencodable);
+    return !unencodable;
+}
+
+bool FileSaver::failUnencodable()
+{
+    return fail(tr("%1 contains characters that cannot be saved as %2")
+                    .arg(targetFileName, QString::fromLatin1(QStringConverter::nameForEncoding(textEncoding))));
+}
+
+bool FileSaver::fail(const QString &message)
+{
+    lastError = message;
+    emit finished(false, lastError);
+    return false;
+}
+
+bool FileSaver::writeContents(QIODevice &device, bool &unencodable)
+{
+    ChunkedTextWriter writer(&device);
+    writer.setEncoding(textEncoding, writeByteOrderMark);
+    linesWritten = 0;
+    nextOverride = 0;
+
+    if (document)
+    {
+        writeDocument(writer, qMax(0, document->characterCount() - 1));
+    }
+    else
+    {
+        writeSnapshot(writer, contents.length());
+    }
+
+    unencodable = writer.hasUnencodableCharacters();
+    return writer.flush() && !unencodable;
+}
+
+void FileSaver::writeSnapshot(ChunkedTextWriter &writer, qint64 total)
+{
+    qint64 written = 0;
+
+    contents.forEachChunk([&](QStringView chunk)
+                          {
+        // Pieces of the original buffer can be huge; slice them for progress
+        for (qsizetype offset = 0; offset < chunk.size() && !writer.hasError(); offset += ProgressInterval)
+        {
+            QStringView slice = chunk.mid(offset, ProgressInterval);
+            writeWithSeparators(writer, slice);
+            written += slice.size();
+            emit progress(written, total);
+        } });
+}
+
+void FileSaver::writeWithSeparators(ChunkedTextWriter &writer, QStringView text)
+{
+    if (lineSeparator == QLatin1String("\n") && lineTerminators.isEmpty())
+    {
+        writer.write(text);
+        return;
+    }
+
+    qsizetype start = 0;
+    qsizetype lineFeed = text.indexOf(QLatin1Char('\n'));
+    while (lineFeed != -1)
+    {
+        writer.write(text.mid(start, lineFeed - start));
+        writer.write(nextSeparator());
+        start = lineFeed + 1;
+        lineFeed = text.indexOf(QLatin1Char('\n'), start);
+    }
+    writer.write(text.mid(start));
+}
+
+QStringView FileSaver::nextSeparator()
+{
+    // Overrides are sorted by line, so one cursor walks them as lines go out
+    const QVector<LineTerminators::Override> &overrides = lineTerminators.lines();
+    qsizetype line = linesWritten++;
+    if (nextOverride < overrides.size() && overrides[nextOverride].line == line)
+    {
+        switch (overrides[nextOverride++].style)
+        {
+        case LineEndings::CRLF:
+            return u"\r\n";
+        case LineEndings::CR:
+            return u"\r";
+        case LineEndings::LF:
+            return u"\n";
+        }
+    }
+    return lineSeparator;
+}
+
+void FileSaver::writeDocument(ChunkedTextWriter &writer, qint64 total)
+{
+    qint64 written = 0;
+    qint64 reported = 0;
+
+    for (QTextBlock block = document->begin(); block.isValid() && !writer.hasError(); block = block.next())
+    {
+        if (block != document->begin())
+        {
+            writer.write(nextSeparator());
+            ++written;
+        }
+        QString text = block.text();
+        writer.write(text);
+        written += text.size();
+
+        if (written - reported >= ProgressInterval)
+        {
+            reported = written;
+            emit progress(written, total);
+        }
+    }
+    emit progress(total, total);
+}
+
+bool FileSaver::copyAttributes(QFile &file, const QString &original)
+{
+#ifdef Q_OS_WIN
+    return file.setPermissions(QFileInfo(original).permissions());
+#else
+    struct stat info;
+    if (::stat(QFile::encodeName(original).constData(), &info) != 0)
+        return false;
+
+    // Only root may hand a file to another owner; other users keep the
+    // group where they can and own the new file themselves
+    int fd = file.handle();
+    bool owned = ::fchown(fd, info.st_uid, info.st_gid) == 0 || ::fchown(fd, uid_t(-1), info.st_gid) == 0;
+    Q_UNUSED(owned);
+
+    // The mode goes last, since changing the owner clears set-id bits
+    return ::fchmod(fd, info.st_mode & 07777) == 0;
+#endif
+}
+
+bool FileSaver::applyDefaultMode(QFile &file)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(file);
+    return true;
+#else
+    // umask can only be read by setting it, so it is read once
+    static const mode_t mask = []()
+    {
+        mode_t current = ::umask(0);
+        ::umask(current);
+        return current;
+    }();
+    return ::fchmod(file.handle(), 0666 & ~mask) == 0;
+#endif
+}
+
+bool FileSaver::syncFile(QFile &file)
+{
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+bool FileSaver::syncDirectory(const QString &path)
+{
+#ifdef Q_OS_WIN
+    // NTFS journals the rename itself; there is no directory handle to flush
+    Q_UNUSED(path);
+    return true;
+#else
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#endif
+}
+
+bool FileSaver::replaceFile(const QString &source, const QString &target)
+{
+#ifdef Q_OS_WIN
+    QString nativeSource = QDir::toNativeSeparators(source);
+    QString nativeTarget = QDir::toNativeSeparators(target);
+    return MoveFileExW(reinterpret_cast<LPCWSTR>(nativeSource.utf16()),
+                       reinterpret_cast<LPCWSTR>(nativeTarget.utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return ::rename(QFile::encodeName(source).constData(),
+                    QFile::encodeName(target).constData()) == 0;
+#endif
+}
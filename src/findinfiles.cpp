@@ -0,0 +1,293 @@
+#include "findinfiles.h"
+#include "encodingdetector.h"
+#include "lineendings.h"
+#include "literalsearcher.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringDecoder>
+
+namespace
+{
+constexpr qint64 BudgetUnit = 1024;
+constexpr int BudgetUnits = int(FindInFiles::MemoryBudget / BudgetUnit);
+}
+
+FindInFiles::FindInFiles(QObject *parent)
+    : QObject(parent), ignoredNames({".git", ".hg", ".svn", "node_modules"}), generation(0), memoryBudget(BudgetUnits)
+{
+}
+
+FindInFiles::~FindInFiles()
+{
+    cancel();
+    pool.waitForDone();
+}
+
+int FindInFiles::start(const QString &directory, const QString &searchText, SearchReplace::SearchOptions options)
+{
+    // Tasks of the previous search stop at their next cancellation check;
+    // they hold their own state, so there is no need to wait for them
+    cancel();
+
+    SearchPointer search = std::make_shared<Search>();
+    search->generation = ++generation;
+    search->searchText = searchText;
+    search->options = options;
+    search->regex = (options & SearchReplace::UseRegex) ? SearchReplace::compileRegex(searchText, options) : QRegularExpression();
+    current = search;
+
+    QVector<IgnoreRule> rules;
+    for (const QString &name : ignoredNames)
+    {
+        rules.append(makeRule(name, false, false));
+    }
+
+    QString root = QDir(directory).absolutePath();
+    schedule(search, [this, search, root, rules]()
+             { searchDirectory(search, root, rules); });
+    return generation;
+}
+
+void FindInFiles::cancel()
+{
+    if (current)
+    {
+        current->cancelled.store(true);
+    }
+}
+
+void FindInFiles::schedule(const SearchPointer &search, std::function<void()> task)
+{
+    ++search->pendingTasks;
+    pool.start([this, search, task]()
+               {
+        task();
+        taskDone(*search); });
+}
+
+void FindInFiles::taskDone(Search &search)
+{
+    if (--search.pendingTasks == 0)
+    {
+        emit finished(search.generation, search.filesSearched.load(), search.totalMatches.load(), search.truncated.load());
+    }
+}
+
+void FindInFiles::searchDirectory(const SearchPointer &search, const QString &path, const QVector<IgnoreRule> &inheritedRules)
+{
+    if (search->cancelled.load())
+        return;
+
+    QDir dir(path);
+    QVector<IgnoreRule> rules = inheritedRules + readGitignore(dir);
+
+    // Anchored .gitignore rules apply to this directory only
+    QVector<IgnoreRule> childRules;
+    for (const IgnoreRule &rule : rules)
+    {
+        if (!rule.anchored)
+            childRules.append(rule);
+    }
+
+    // Symbolic links are not followed, so a link cycle cannot loop the walk
+    const QFileInfoList entries = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+    for (const QFileInfo &entry : entries)
+    {
+        bool isDirectory = entry.isDir();
+        QString name = entry.fileName();
+        bool ignored = false;
+        for (const IgnoreRule &rule : rules)
+        {
+            if ((!rule.directoryOnly || isDirectory) && rule.pattern.match(name).hasMatch())
+            {
+                ignored = true;
+                break;
+            }
+        }
+        if (ignored)
+            continue;
+
+        QString entryPath = entry.filePath();
+        if (isDirectory)
+        {
+            schedule(search, [this, search, entryPath, childRules]()
+                     { searchDirectory(search, entryPath, childRules); });
+        }
+        else
+        {
+            schedule(search, [this, search, entryPath]()
+                     { searchFile(search, entryPath); });
+        }
+    }
+}
+
+void FindInFiles::searchFile(const SearchPointer &search, const QString &fileName)
+{
+    if (search->cancelled.load())
+        return;
+
+    // Binary, empty and unreadable files count as searched too
+    scanFile(search, fileName);
+
+    int searched = ++search->filesSearched;
+    if (searched % ProgressInterval == 0)
+    {
+        emit progress(search->generation, searched);
+    }
+}
+
+void FindInFiles::scanFile(const SearchPointer &search, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0)
+        return;
+
+    qint64 size = file.size();
+    uchar *data = file.map(0, size);
+    if (!data)
+        return;
+
+    qint64 sampleSize = qMin(size, EncodingDetector::SampleSize);
+    EncodingDetector::Result detected = EncodingDetector::detect(reinterpret_cast<const char *>(data), sampleSize, sampleSize == size);
+    if (detected.encoding == EncodingDetector::Binary)
+        return;
+
+    // Decoded text takes about two bytes per byte of the file
+    int units = int(qBound<qint64>(1, size * 2 / BudgetUnit + 1, BudgetUnits));
+    memoryBudget.acquire(units);
+
+    QVector<FileMatch> matches;
+    if (!search->cancelled.load())
+    {
+        QStringDecoder decoder(EncodingDetector::converterEncoding(detected.encoding));
+        QString text = decoder.decode(QByteArrayView(data, size));
+        file.unmap(data);
+
+        LineEndings lineEndings;
+        lineEndings.normalize(text);
+        scanText(*search, text, matches);
+    }
+
+    memoryBudget.release(units);
+
+    // Past the cap the search stops and reports itself as truncated
+    if (!matches.isEmpty())
+    {
+        int total = search->totalMatches.fetch_add(int(matches.size())) + int(matches.size());
+        if (total >= MaxResults)
+        {
+            matches.resize(qMax<qsizetype>(0, matches.size() - (total - MaxResults)));
+            search->truncated.store(true);
+            search->cancelled.store(true);
+        }
+        if (!matches.isEmpty())
+        {
+            emit matchesFound(search->generation, fileName, matches);
+        }
+    }
+}
+
+void FindInFiles::scanText(Search &search, const QString &text, QVector<FileMatch> &matches) const
+{
+    qsizetype line = 0;
+    qsizetype lineStart = 0;
+    qsizetype lineEnd = -1;
+    QString lineText;
+
+    auto append = [&](qsizetype start, qsizetype end)
+    {
+        // Matches arrive in order, so the line is only looked up again once
+        // a match starts past its end; one forward sweep finds the lines
+        if (lineEnd < 0 || start > lineEnd)
+        {
+            qsizetype sweepPosition = qMax<qsizetype>(lineEnd, 0);
+            qsizetype lineFeeds = QStringView(text).mid(sweepPosition, start - sweepPosition).count(QLatin1Char('\n'));
+            if (lineFeeds > 0)
+            {
+                line += lineFeeds;
+                lineStart = text.lastIndexOf(QLatin1Char('\n'), start - 1) + 1;
+            }
+            lineEnd = text.indexOf(QLatin1Char('\n'), start);
+            if (lineEnd < 0)
+                lineEnd = text.size();
+            lineText = text.mid(lineStart, qMin<qsizetype>(lineEnd - lineStart, MaxLineTextLength));
+        }
+
+        FileMatch match;
+        match.lineNumber = int(line);
+        match.columnNumber = int(start - lineStart);
+        match.length = int(end - start);
+        match.lineText = lineText;
+        matches.append(match);
+        return matches.size() < MaxResults && !search.cancelled.load();
+    };
+
+    if (search.options & SearchReplace::UseRegex)
+    {
+        if (!search.regex.isValid())
+            return;
+
+        QRegularExpressionMatchIterator it = search.regex.globalMatch(text);
+        while (it.hasNext())
+        {
+            QRegularExpressionMatch match = it.next();
+            if (!append(match.capturedStart(), match.capturedEnd()))
+                break;
+        }
+    }
+    else
+    {
+        Qt::CaseSensitivity caseSensitivity = (search.options & SearchReplace::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+        LiteralSearcher searcher(search.searchText, caseSensitivity, search.options.testFlag(SearchReplace::WholeWord));
+        for (qsizetype position = searcher.indexIn(text); position >= 0;
+             position = searcher.indexIn(text, position + searcher.length()))
+        {
+            if (!append(position, position + searcher.length()))
+                break;
+        }
+    }
+}
+
+QVector<FindInFiles::IgnoreRule> FindInFiles::readGitignore(const QDir &dir)
+{
+    // A subset of .gitignore: name patterns, optionally anchored with a
+    // leading slash or restricted to directories with a trailing one.
+    // Negations and patterns naming nested paths are not supported.
+    QVector<IgnoreRule> rules;
+    QFile file(dir.filePath(".gitignore"));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return rules;
+
+    while (!file.atEnd())
+    {
+        QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (line.isEmpty() || line.startsWith('#') || line.startsWith('!'))
+            continue;
+
+        bool directoryOnly = line.endsWith('/');
+        if (directoryOnly)
+            line.chop(1);
+        bool anchored = line.startsWith('/');
+        if (anchored)
+            line.remove(0, 1);
+
+        if (!line.isEmpty() && !line.contains('/'))
+        {
+            rules.append(makeRule(line, directoryOnly, anchored));
+        }
+    }
+    return rules;
+}
+
+FindInFiles::IgnoreRule FindInFiles::makeRule(const QString &pattern, bool directoryOnly, bool anchored)
+{
+    // Compiled here rather than through the shared PatternCache: a tree's
+    // ignore rules would crowd the editor's own patterns out of it
+    IgnoreRule rule;
+    rule.pattern = QRegularExpression(QRegularExpression::wildcardToRegularExpression(pattern));
+    rule.directoryOnly = directoryOnly;
+    rule.anchored = anchored;
+    return rule;
+}
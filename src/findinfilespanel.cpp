@@ -0,0 +1,238 @@
+#include "findinfilespanel.h"
+
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QPushButton>
+#include <QLabel>
+#include <QTreeWidget>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFileDialog>
+#include <QDir>
+#include <QSettings>
+
+namespace
+{
+enum ItemRole
+{
+    FileNameRole = Qt::UserRole,
+    LineRole,
+    ColumnRole,
+    LengthRole
+};
+}
+
+FindInFilesPanel::FindInFilesPanel(QWidget *parent)
+    : QDockWidget(tr("Find in Files"), parent), finder(std::make_unique<FindInFiles>()), currentGeneration(0), matchCount(0)
+{
+    setObjectName("FindInFilesPanel");
+    createUI();
+    createConnections();
+
+    QSettings settings("TextEditor", "TextEditor");
+    directoryLineEdit->setText(settings.value("findInFiles/directory", QDir::currentPath()).toString());
+    finder->setIgnoredNames(settings.value("findInFiles/ignoredNames", finder->getIgnoredNames()).toStringList());
+}
+
+FindInFilesPanel::~FindInFilesPanel()
+{
+    QSettings settings("TextEditor", "TextEditor");
+    settings.setValue("findInFiles/directory", directoryLineEdit->text());
+    settings.setValue("findInFiles/ignoredNames", finder->getIgnoredNames());
+}
+
+void FindInFilesPanel::setDirectory(const QString &directory)
+{
+    directoryLineEdit->setText(directory);
+}
+
+void FindInFilesPanel::setSearchText(const QString &text)
+{
+    // An empty text keeps the previous query
+    if (!text.isEmpty())
+    {
+        findLineEdit->setText(text);
+    }
+    findLineEdit->selectAll();
+    findLineEdit->setFocus();
+}
+
+void FindInFilesPanel::createUI()
+{
+    QWidget *contents = new QWidget(this);
+    QVBoxLayout *mainLayout = new QVBoxLayout(contents);
+
+    // Query row
+    QHBoxLayout *findLayout = new QHBoxLayout();
+    findLayout->addWidget(new QLabel(tr("Find:")));
+    findLineEdit = new QLineEdit();
+    findLayout->addWidget(findLineEdit);
+    caseSensitiveCheckBox = new QCheckBox(tr("Case Sensitive"));
+    wholeWordCheckBox = new QCheckBox(tr("Whole Word"));
+    regexCheckBox = new QCheckBox(tr("Regular Expression"));
+    findLayout->addWidget(caseSensitiveCheckBox);
+    findLayout->addWidget(wholeWordCheckBox);
+    findLayout->addWidget(regexCheckBox);
+    mainLayout->addLayout(findLayout);
+
+    // Directory row
+    QHBoxLayout *directoryLayout = new QHBoxLayout();
+    directoryLayout->addWidget(new QLabel(tr("In:")));
+    directoryLineEdit = new QLineEdit();
+    directoryLayout->addWidget(directoryLineEdit);
+    browseButton = new QPushButton(tr("Browse..."));
+    directoryLayout->addWidget(browseButton);
+    searchButton = new QPushButton(tr("Search"));
+    directoryLayout->addWidget(searchButton);
+    mainLayout->addLayout(directoryLayout);
+
+    // Results, grouped by file
+    resultsTree = new QTreeWidget();
+    resultsTree->setColumnCount(2);
+    resultsTree->setHeaderLabels({tr("Location"), tr("Text")});
+    resultsTree->setUniformRowHeights(true);
+    resultsTree->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+    mainLayout->addWidget(resultsTree);
+
+    statusLabel = new QLabel();
+    mainLayout->addWidget(statusLabel);
+
+    setWidget(contents);
+}
+
+void FindInFilesPanel::createConnections()
+{
+    connect(searchButton, &QPushButton::clicked, this, &FindInFilesPanel::onSearchButtonClicked);
+    connect(findLineEdit, &QLineEdit::returnPressed, this, &FindInFilesPanel::onSearchButtonClicked);
+    connect(browseButton, &QPushButton::clicked, this, &FindInFilesPanel::onBrowseButtonClicked);
+    connect(resultsTree, &QTreeWidget::itemActivated, this, &FindInFilesPanel::onItemActivated);
+
+    connect(finder.get(), &FindInFiles::matchesFound, this, &FindInFilesPanel::onMatchesFound);
+    connect(finder.get(), &FindInFiles::progress, this, &FindInFilesPanel::onProgress);
+    connect(finder.get(), &FindInFiles::finished, this, &FindInFilesPanel::onFinished);
+}
+
+void FindInFilesPanel::onSearchButtonClicked()
+{
+    // The same button stops a running search
+    if (finder->isRunning())
+    {
+        finder->cancel();
+        return;
+    }
+
+    if (findLineEdit->text().isEmpty() || !QDir(directoryLineEdit->text()).exists())
+    {
+        statusLabel->setText(tr("Enter a search text and an existing directory"));
+        return;
+    }
+
+    SearchReplace::SearchOptions options;
+    if (caseSensitiveCheckBox->isChecked())
+        options |= SearchReplace::CaseSensitive;
+    if (wholeWordCheckBox->isChecked())
+        options |= SearchReplace::WholeWord;
+    if (regexCheckBox->isChecked())
+        options |= SearchReplace::UseRegex;
+
+    if ((options & SearchReplace::UseRegex) && !SearchReplace::compileRegex(findLineEdit->text(), options).isValid())
+    {
+        statusLabel->setText(tr("Invalid regular expression"));
+        return;
+    }
+
+    resultsTree->clear();
+    matchCount = 0;
+    currentGeneration = finder->start(directoryLineEdit->text(), findLineEdit->text(), options);
+    setSearching(true);
+}
+
+void FindInFilesPanel::onBrowseButtonClicked()
+{
+    QString directory = QFileDialog::getExistingDirectory(this, tr("Search in Directory"), directoryLineEdit->text());
+    if (!directory.isEmpty())
+    {
+        directoryLineEdit->setText(directory);
+    }
+}
+
+void FindInFilesPanel::onMatchesFound(int generation, const QString &fileName, const QVector<FileMatch> &matches)
+{
+    if (generation != currentGeneration)
+        return;
+
+    QTreeWidgetItem *fileItem = new QTreeWidgetItem(resultsTree);
+    fileItem->setText(0, QDir::toNativeSeparators(fileName));
+    fileItem->setText(1, tr("%n match(es)", "", int(matches.size())));
+
+    QList<QTreeWidgetItem *> children;
+    children.reserve(matches.size());
+    for (const FileMatch &match : matches)
+    {
+        QTreeWidgetItem *item = new QTreeWidgetItem();
+        item->setText(0, QString("%1:%2").arg(match.lineNumber + 1).arg(match.columnNumber + 1));
+        item->setText(1, match.lineText.trimmed());
+        item->setData(0, FileNameRole, fileName);
+        item->setData(0, LineRole, match.lineNumber);
+        item->setData(0, ColumnRole, match.columnNumber);
+        item->setData(0, LengthRole, match.length);
+        children.append(item);
+    }
+    fileItem->addChildren(children);
+
+    matchCount += int(matches.size());
+}
+
+void FindInFilesPanel::onProgress(int generation, int filesSearched)
+{
+    if (generation != currentGeneration)
+        return;
+
+    statusLabel->setText(tr("Searching... %1 files, %2 matches").arg(filesSearched).arg(matchCount));
+}
+
+void FindInFilesPanel::onFinished(int generation, int filesSearched, int totalMatches, bool truncated)
+{
+    if (generation != currentGeneration)
+        return;
+
+    Q_UNUSED(totalMatches);
+    setSearching(false);
+    if (truncated)
+    {
+        statusLabel->setText(tr("Stopped at %1 matches after %2 files").arg(matchCount).arg(filesSearched));
+    }
+    else
+    {
+        statusLabel->setText(tr("%1 matches in %2 files searched").arg(matchCount).arg(filesSearched));
+    }
+}
+
+void FindInFilesPanel::onItemActivated(QTreeWidgetItem *item, int column)
+{
+    Q_UNUSED(column);
+
+    // File rows open the first match
+    if (!item->parent() && item->childCount() > 0)
+    {
+        item = item->child(0);
+    }
+
+    QString fileName = item->data(0, FileNameRole).toString();
+    if (!fileName.isEmpty())
+    {
+        emit openRequested(fileName, item->data(0, LineRole).toInt(),
+                           item->data(0, ColumnRole).toInt(), item->data(0, LengthRole).toInt());
+    }
+}
+
+void FindInFilesPanel::setSearching(bool searching)
+{
+    searchButton->setText(searching ? tr("Stop") : tr("Search"));
+    browseButton->setEnabled(!searching);
+    if (searching)
+    {
+        statusLabel->setText(tr("Searching..."));
+    }
+}
@@ -0,0 +1,329 @@
+#include "largefileviewer.h"
+#include "mappeddocument.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QKeyEvent>
+#include <QWheelEvent>
+#include <QScrollBar>
+#include <QFontMetrics>
+#include <QElapsedTimer>
+#include <limits>
+
+namespace
+{
+// Bytes indexed per event loop turn; small enough to stay well under a frame
+constexpr qint64 IndexSliceBytes = 8 * 1024 * 1024;
+constexpr int IndexSliceBudgetMs = 8;
+}
+
+LargeFileViewer::LargeFileViewer(QWidget *parent)
+    : QAbstractScrollArea(parent), currentFontSize(12), widestLine(0), pendingLine(-1)
+{
+    QFont font("Courier New", currentFontSize);
+    font.setFixedPitch(true);
+    setFont(font);
+
+    setFocusPolicy(Qt::StrongFocus);
+    viewport()->setCursor(Qt::IBeamCursor);
+
+    indexTimer.setInterval(0);
+    connect(&indexTimer, &QTimer::timeout, this, &LargeFileViewer::indexNextSlice);
+
+    // Scrolling by hand abandons a line still waiting for the index
+    connect(verticalScrollBar(), &QScrollBar::actionTriggered, this, [this]()
+            { pendingLine = -1; });
+}
+
+LargeFileViewer::~LargeFileViewer() = default;
+
+bool LargeFileViewer::openFile(const QString &fileName)
+{
+    indexTimer.stop();
+
+    auto document = std::make_unique<MappedDocument>(fileName);
+    if (!document->open())
+    {
+        return false;
+    }
+
+    mappedDocument = std::move(document);
+    widestLine = 0;
+    pendingLine = -1;
+    verticalScrollBar()->setValue(0);
+    horizontalScrollBar()->setValue(0);
+    updateScrollRanges();
+    viewport()->update();
+
+    if (!mappedDocument->isFullyIndexed())
+    {
+        indexTimer.start();
+    }
+    return true;
+}
+
+QString LargeFileViewer::fileName() const
+{
+    return mappedDocument ? mappedDocument->fileName() : QString();
+}
+
+void LargeFileViewer::goToLine(qint64 line)
+{
+    if (!mappedDocument)
+        return;
+
+    // A line past the index is shown at its estimated position at once and
+    // settled when the indexer reaches it
+    pendingLine = mappedDocument->isLineIndexed(line) ? -1 : line;
+    updateScrollRanges();
+    verticalScrollBar()->setValue(int(qBound<qint64>(0, line, verticalScrollBar()->maximum())));
+}
+
+qint64 LargeFileViewer::firstVisibleLine() const
+{
+    return verticalScrollBar()->value();
+}
+
+qint64 LargeFileViewer::lineCount() const
+{
+    return mappedDocument ? mappedDocument->estimatedLineCount() : 0;
+}
+
+void LargeFileViewer::setFontSize(int size)
+{
+    if (size < 6 || size > 32)
+        return;
+
+    currentFontSize = size;
+    QFont font = this->font();
+    font.setPointSize(size);
+    setFont(font);
+    updateScrollRanges();
+    viewport()->update();
+}
+
+void LargeFileViewer::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+    painter.fillRect(event->rect(), palette().base());
+
+    if (!mappedDocument)
+        return;
+
+    // Pages past the end of a truncated file must never be touched
+    if (mappedDocument->refreshSize())
+    {
+        widestLine = 0;
+        updateScrollRanges();
+        if (!mappedDocument->isFullyIndexed())
+            indexTimer.start();
+    }
+
+    QFontMetrics fm(font());
+    int lineHeight = fm.height();
+    int gutter = gutterWidth();
+    int charWidth = fm.horizontalAdvance(QLatin1Char('9'));
+    int xOffset = horizontalScrollBar()->value();
+
+    painter.fillRect(0, 0, gutter, viewport()->height(), QColor(240, 240, 240));
+
+    // Past the index the scroll position maps to an estimated byte offset,
+    // resynced on the next line start; the end of the file is found by
+    // scanning back from it
+    QScrollBar *bar = verticalScrollBar();
+    qint64 line = firstVisibleLine();
+    int visibleLines = visibleLineCount();
+    bool numbered = mappedDocument->isLineIndexed(line);
+    qint64 offset;
+    if (numbered)
+        offset = mappedDocument->lineOffset(line);
+    else if (bar->value() >= bar->maximum())
+        offset = mappedDocument->lineStartBefore(mappedDocument->size(), visibleLines);
+    else
+        offset = mappedDocument->nextLineStart(mappedDocument->approximateOffset(line));
+
+    QString text;
+    for (int i = 0; i <= visibleLines && offset < mappedDocument->size(); ++i)
+    {
+        int top = i * lineHeight;
+        if (numbered && mappedDocument->startsLine(offset))
+        {
+            painter.setPen(QColor(100, 100, 100));
+            painter.drawText(0, top, gutter - 5, lineHeight, Qt::AlignRight, QString::number(line + 1));
+        }
+
+        // Only the lines inside the viewport are ever decoded
+        qint64 next = mappedDocument->readLine(offset, text);
+        if (mappedDocument->startsLine(next))
+            ++line;
+        offset = next;
+        widestLine = qMax(widestLine, int(text.size()));
+
+        painter.setPen(palette().text().color());
+        painter.setClipRect(gutter, 0, viewport()->width() - gutter, viewport()->height());
+        painter.drawText(gutter + 3 - xOffset, top + fm.ascent(), text);
+        painter.setClipping(false);
+    }
+
+    horizontalScrollBar()->setRange(0, qMax(0, widestLine * charWidth + gutter - viewport()->width()));
+}
+
+void LargeFileViewer::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollRanges();
+}
+
+void LargeFileViewer::keyPressEvent(QKeyEvent *event)
+{
+    QScrollBar *bar = verticalScrollBar();
+    bool control = event->modifiers() & Qt::ControlModifier;
+
+    switch (event->key())
+    {
+    case Qt::Key_Up:
+        bar->triggerAction(QAbstractSlider::SliderSingleStepSub);
+        break;
+    case Qt::Key_Down:
+        bar->triggerAction(QAbstractSlider::SliderSingleStepAdd);
+        break;
+    case Qt::Key_PageUp:
+        bar->triggerAction(QAbstractSlider::SliderPageStepSub);
+        break;
+    case Qt::Key_PageDown:
+        bar->triggerAction(QAbstractSlider::SliderPageStepAdd);
+        break;
+    case Qt::Key_Home:
+        if (control)
+        {
+            pendingLine = -1;
+            bar->setValue(0);
+        }
+        else
+        {
+            horizontalScrollBar()->setValue(0);
+        }
+        break;
+    case Qt::Key_End:
+        // The last page is painted from the end of the file, indexed or not
+        if (control)
+        {
+            pendingLine = -1;
+            bar->setValue(bar->maximum());
+        }
+        break;
+    default:
+        QAbstractScrollArea::keyPressEvent(event);
+        return;
+    }
+    event->accept();
+}
+
+void LargeFileViewer::wheelEvent(QWheelEvent *event)
+{
+    if (event->modifiers() & Qt::ControlModifier)
+    {
+        int delta = event->angleDelta().y();
+        if (delta > 0)
+        {
+            setFontSize(currentFontSize + 1);
+        }
+        else if (delta < 0)
+        {
+            setFontSize(currentFontSize - 1);
+        }
+        event->accept();
+    }
+    else
+    {
+        QAbstractScrollArea::wheelEvent(event);
+    }
+}
+
+void LargeFileViewer::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    Q_UNUSED(dy);
+    viewport()->update();
+}
+
+void LargeFileViewer::indexNextSlice()
+{
+    if (!mappedDocument)
+    {
+        indexTimer.stop();
+        return;
+    }
+
+    if (mappedDocument->refreshSize())
+    {
+        widestLine = 0;
+        viewport()->update();
+    }
+
+    // Repaint when the visible lines become indexed and get their numbers
+    qint64 lastVisible = firstVisibleLine() + visibleLineCount();
+    bool wasIndexed = mappedDocument->isLineIndexed(lastVisible);
+
+    QElapsedTimer timer;
+    timer.start();
+    bool more = true;
+    while (more && timer.elapsed() < IndexSliceBudgetMs)
+    {
+        more = mappedDocument->indexMore(IndexSliceBytes);
+    }
+
+    updateScrollRanges();
+    if (pendingLine >= 0 && mappedDocument->isLineIndexed(pendingLine))
+    {
+        qint64 line = pendingLine;
+        pendingLine = -1;
+        verticalScrollBar()->setValue(int(qBound<qint64>(0, line, verticalScrollBar()->maximum())));
+    }
+    if (!wasIndexed && mappedDocument->isLineIndexed(lastVisible))
+    {
+        viewport()->update();
+    }
+    emit indexingProgress(mappedDocument->indexedBytesCount(), mappedDocument->size());
+
+    if (!more)
+    {
+        indexTimer.stop();
+        emit indexingFinished(mappedDocument->knownLineCount());
+    }
+}
+
+void LargeFileViewer::updateScrollRanges()
+{
+    int visibleLines = visibleLineCount();
+    qint64 lines = lineCount();
+    QScrollBar *bar = verticalScrollBar();
+
+    // A view at the end stays there while the line estimate is refined
+    bool atEnd = bar->maximum() > 0 && bar->value() >= bar->maximum();
+    bar->setPageStep(visibleLines);
+    bar->setRange(0, int(qBound<qint64>(0, lines - visibleLines, std::numeric_limits<int>::max())));
+    if (atEnd)
+    {
+        bar->setValue(bar->maximum());
+    }
+}
+
+int LargeFileViewer::visibleLineCount() const
+{
+    int lineHeight = QFontMetrics(font()).height();
+    return qMax(1, viewport()->height() / qMax(1, lineHeight));
+}
+
+int LargeFileViewer::gutterWidth() const
+{
+    int digits = 1;
+    qint64 max = qMax<qint64>(1, lineCount());
+    while (max >= 10)
+    {
+        max /= 10;
+        ++digits;
+    }
+
+    return 8 + QFontMetrics(font()).horizontalAdvance(QLatin1Char('9')) * digits;
+}
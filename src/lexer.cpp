@@ -0,0 +1,626 @@
+#include "lexer.h"
+
+#include <QChar>
+#include <cstring>
+#include <initializer_list>
+
+namespace
+{
+    /**
+     * @brief Keywords of a language in an open-addressing table built at
+     * compile time
+     *
+     * The slot of a word is derived from its length and its first and last
+     * characters, so a lookup hashes three values and usually compares one
+     * keyword. Tables flagged case-insensitive store and probe folded
+     * (lower-case) characters.
+     */
+    class KeywordTable
+    {
+    public:
+        constexpr KeywordTable(std::initializer_list<const char *> keywords, bool caseInsensitive = false)
+            : words(), lengths(), caseInsensitive(caseInsensitive)
+        {
+            for (const char *word : keywords)
+            {
+                int length = 0;
+                while (word[length])
+                    ++length;
+
+                quint32 slot = slotOf(length, fold(char16_t(word[0])), fold(char16_t(word[length - 1])));
+                while (words[slot])
+                    slot = (slot + 1) & (Capacity - 1);
+                words[slot] = word;
+                lengths[slot] = quint8(length);
+            }
+        }
+
+        bool contains(const char16_t *identifier, int length) const
+        {
+            if (length > MaxLength)
+                return false;
+
+            quint32 slot = slotOf(length, fold(identifier[0]), fold(identifier[length - 1]));
+            for (; words[slot]; slot = (slot + 1) & (Capacity - 1))
+            {
+                if (lengths[slot] != length)
+                    continue;
+
+                const char *word = words[slot];
+                int i = 0;
+                while (i < length && fold(identifier[i]) == fold(char16_t(word[i])))
+                    ++i;
+                if (i == length)
+                    return true;
+            }
+            return false;
+        }
+
+        static constexpr int Capacity = 256;
+        static constexpr int MaxLength = 24;
+
+    private:
+        constexpr char16_t fold(char16_t c) const
+        {
+            return (caseInsensitive && c >= u'A' && c <= u'Z') ? char16_t(c | 0x20) : c;
+        }
+
+        static constexpr quint32 slotOf(int length, char16_t first, char16_t last)
+        {
+            quint32 hash = quint32(length) * 0x9E3779B1u ^ quint32(first) * 0x85EBCA77u ^ quint32(last) * 0xC2B2AE3Du;
+            hash ^= hash >> 15;
+            return hash & (Capacity - 1);
+        }
+
+        const char *words[Capacity];
+        quint8 lengths[Capacity];
+        bool caseInsensitive;
+    };
+
+    constexpr KeywordTable cppKeywords{
+        "auto", "bool", "break", "case", "catch", "char", "class", "const",
+        "continue", "default", "delete", "do", "double", "else", "enum", "explicit",
+        "extern", "false", "float", "for", "friend", "goto", "if", "inline",
+        "int", "long", "mutable", "namespace", "new", "nullptr", "operator",
+        "private", "protected", "public", "register", "return", "short", "signed",
+        "sizeof", "static", "struct", "switch", "template", "this", "throw",
+        "true", "try", "typedef", "typeid", "typename", "union", "unsigned",
+        "virtual", "void", "volatile", "wchar_t", "while"};
+
+    constexpr KeywordTable pythonKeywords{
+        "and", "as", "assert", "break", "class", "continue", "def", "del",
+        "elif", "else", "except", "False", "finally", "for", "from", "global",
+        "if", "import", "in", "is", "lambda", "None", "not", "or", "pass",
+        "raise", "return", "True", "try", "while", "with", "yield"};
+
+    constexpr KeywordTable javaScriptKeywords{
+        "break", "case", "catch", "class", "const", "continue", "debugger",
+        "default", "delete", "do", "else", "export", "extends", "finally",
+        "for", "function", "if", "import", "in", "instanceof", "new", "return",
+        "super", "switch", "this", "throw", "try", "typeof", "var", "void",
+        "while", "with", "yield", "let", "static", "enum", "await", "async"};
+
+    constexpr KeywordTable jsonKeywords{"true", "false", "null"};
+
+    constexpr KeywordTable sqlKeywords{
+        {"select", "from", "where", "and", "or", "not", "insert", "update",
+         "delete", "create", "alter", "drop", "table", "database", "primary",
+         "key", "foreign", "join", "left", "right", "inner", "outer", "on",
+         "group", "by", "order", "asc", "desc", "limit", "offset", "distinct"},
+        true};
+
+    bool isDigit(char16_t c)
+    {
+        return c >= u'0' && c <= u'9';
+    }
+
+    bool isIdentifierStart(char16_t c, bool dollar)
+    {
+        if (c < 0x80)
+            return (c >= u'a' && c <= u'z') || (c >= u'A' && c <= u'Z') || c == u'_' || (dollar && c == u'$');
+        return QChar::isLetter(c) || QChar::isSurrogate(c);
+    }
+
+    bool isIdentifierPart(char16_t c, bool dollar)
+    {
+        if (c < 0x80)
+            return isIdentifierStart(c, dollar) || isDigit(c);
+        return QChar::isLetterOrNumber(c) || QChar::isSurrogate(c) || QChar::isMark(c);
+    }
+
+    bool startsWith(const char16_t *text, int length, int position, const char *prefix)
+    {
+        for (int i = 0; prefix[i]; ++i)
+        {
+            if (position + i >= length || text[position + i] != char16_t(prefix[i]))
+                return false;
+        }
+        return true;
+    }
+
+    // Position just past @p terminator at or after @p from, or -1
+    int find(const char16_t *text, int length, int from, const char *terminator)
+    {
+        for (int i = from; i < length; ++i)
+        {
+            if (startsWith(text, length, i, terminator))
+                return i + int(std::strlen(terminator));
+        }
+        return -1;
+    }
+
+    void appendToken(QVector<Token> &tokens, int start, int end, Lexer::TokenClass tokenClass)
+    {
+        if (end > start)
+            tokens.append({start, end - start, tokenClass});
+    }
+
+    /**
+     * @brief Lexer for programming languages made of keywords, quoted
+     * strings, numbers and comments
+     *
+     * The low byte of the state says which construct is still open at the
+     * end of a line and the next byte holds the quote character of an open
+     * string.
+     */
+    class CodeLexer : public Lexer
+    {
+    public:
+        struct Syntax
+        {
+            const KeywordTable *keywords;
+            const char *lineComment;
+            const char *blockCommentStart;
+            const char *blockCommentEnd;
+            const char *quotes;
+            const char *multilineQuotes;
+            bool tripleQuotes;
+            bool escapes;
+            bool dollarIdentifiers;
+        };
+
+        enum State
+        {
+            Default = 0,
+            InBlockComment = 1,
+            InString = 2,
+            InTripleString = 3
+        };
+
+        explicit CodeLexer(const Syntax &syntax) : syntax(syntax) {}
+
+        int tokenize(QStringView text, int state, QVector<Token> &tokens) const override
+        {
+            const char16_t *data = text.utf16();
+            const int length = int(text.size());
+
+            // Finish the construct the previous line left open
+            int i = 0;
+            if ((state & 0xff) == InBlockComment)
+            {
+                i = endOfBlockComment(data, length, 0, state);
+                appendToken(tokens, 0, i, Comment);
+            }
+            else if ((state & 0xff) == InString || (state & 0xff) == InTripleString)
+            {
+                i = endOfString(data, length, 0, char16_t(state >> 8), (state & 0xff) == InTripleString, state);
+                appendToken(tokens, 0, i, String);
+            }
+            else
+            {
+                state = Default;
+            }
+
+            while (i < length)
+            {
+                const char16_t c = data[i];
+                const int start = i;
+
+                if (syntax.lineComment && startsWith(data, length, i, syntax.lineComment))
+                {
+                    appendToken(tokens, start, length, Comment);
+                    break;
+                }
+
+                if (syntax.blockCommentStart && startsWith(data, length, i, syntax.blockCommentStart))
+                {
+                    i = endOfBlockComment(data, length, i + int(std::strlen(syntax.blockCommentStart)), state);
+                    appendToken(tokens, start, i, Comment);
+                }
+                else if (c < 0x80 && isOneOf(c, syntax.quotes))
+                {
+                    bool triple = syntax.tripleQuotes && i + 2 < length && data[i + 1] == c && data[i + 2] == c;
+                    i = endOfString(data, length, i + (triple ? 3 : 1), c, triple, state);
+                    appendToken(tokens, start, i, String);
+                }
+                else if (isDigit(c) || (c == u'.' && i + 1 < length && isDigit(data[i + 1])))
+                {
+                    // Covers hex, exponents and suffixes such as 0x1Fu or 1.5e-3f
+                    ++i;
+                    while (i < length)
+                    {
+                        char16_t d = data[i];
+                        if (isIdentifierPart(d, false) || d == u'.')
+                            ++i;
+                        else if ((d == u'+' || d == u'-') && (data[i - 1] == u'e' || data[i - 1] == u'E'))
+                            ++i;
+                        else
+                            break;
+                    }
+                    appendToken(tokens, start, i, Number);
+                }
+                else if (isIdentifierStart(c, syntax.dollarIdentifiers))
+                {
+                    ++i;
+                    while (i < length && isIdentifierPart(data[i], syntax.dollarIdentifiers))
+                        ++i;
+                    if (syntax.keywords && syntax.keywords->contains(data + start, i - start))
+                    {
+                        appendToken(tokens, start, i, Keyword);
+                    }
+                }
+                else
+                {
+                    ++i;
+                }
+            }
+            return state;
+        }
+
+    private:
+        static bool isOneOf(char16_t c, const char *characters)
+        {
+            for (const char *character = characters; character && *character; ++character)
+            {
+                if (c == char16_t(*character))
+                    return true;
+            }
+            return false;
+        }
+
+        int endOfBlockComment(const char16_t *data, int length, int from, int &state) const
+        {
+            int end = find(data, length, from, syntax.blockCommentEnd);
+            state = end < 0 ? InBlockComment : Default;
+            return end < 0 ? length : end;
+        }
+
+        int endOfString(const char16_t *data, int length, int from, char16_t quote, bool triple, int &state) const
+        {
+            for (int i = from; i < length; ++i)
+            {
+                if (syntax.escapes && data[i] == u'\\')
+                {
+                    // A backslash at the end of the line continues the string
+                    if (i + 1 == length)
+                    {
+                        state = (triple ? InTripleString : InString) | (quote << 8);
+                        return length;
+                    }
+                    ++i;
+                }
+                else if (data[i] == quote)
+                {
+                    if (!triple)
+                    {
+                        state = Default;
+                        return i + 1;
+                    }
+                    if (i + 2 < length && data[i + 1] == quote && data[i + 2] == quote)
+                    {
+                        state = Default;
+                        return i + 3;
+                    }
+                }
+            }
+
+            // Ordinary strings end with the line
+            if (triple)
+                state = InTripleString | (quote << 8);
+            else if (quote < 0x80 && isOneOf(quote, syntax.multilineQuotes))
+                state = InString | (quote << 8);
+            else
+                state = Default;
+            return length;
+        }
+
+        Syntax syntax;
+    };
+
+    /**
+     * @brief Lexer for XML and HTML markup
+     *
+     * Tag and attribute names are reported as keywords. Comments, CDATA
+     * sections, tags and attribute values may all span lines.
+     */
+    class MarkupLexer : public Lexer
+    {
+    public:
+        enum State
+        {
+            Default = 0,
+            InComment = 1,
+            InCData = 2,
+            InTag = 3,
+            InAttributeValue = 4
+        };
+
+        int tokenize(QStringView text, int state, QVector<Token> &tokens) const override
+        {
+            const char16_t *data = text.utf16();
+            const int length = int(text.size());
+
+            int i = 0;
+            while (i < length)
+            {
+                const int start = i;
+                switch (state & 0xff)
+                {
+                case InComment:
+                {
+                    int end = find(data, length, i, "-->");
+                    i = end < 0 ? length : end;
+                    state = end < 0 ? InComment : Default;
+                    appendToken(tokens, start, i, Comment);
+                    break;
+                }
+                case InCData:
+                {
+                    int end = find(data, length, i, "]]>");
+                    i = end < 0 ? length : end;
+                    state = end < 0 ? InCData : Default;
+                    if (end >= 0)
+                        appendToken(tokens, end - 3, end, Keyword);
+                    break;
+                }
+                case InAttributeValue:
+                    i = endOfAttributeValue(data, length, i, char16_t(state >> 8), state);
+                    appendToken(tokens, start, i, String);
+                    break;
+                case InTag:
+                {
+                    const char16_t c = data[i];
+                    if (c == u'>')
+                    {
+                        state = Default;
+                        appendToken(tokens, start, ++i, Keyword);
+                    }
+                    else if ((c == u'/' || c == u'?') && i + 1 < length && data[i + 1] == u'>')
+                    {
+                        state = Default;
+                        i += 2;
+                        appendToken(tokens, start, i, Keyword);
+                    }
+                    else if (c == u'"' || c == u'\'')
+                    {
+                        i = endOfAttributeValue(data, length, i + 1, c, state);
+                        appendToken(tokens, start, i, String);
+                    }
+                    else if (isNameStart(c))
+                    {
+                        i = endOfName(data, length, i + 1);
+                        appendToken(tokens, start, i, Keyword);
+                    }
+                    else
+                    {
+                        ++i;
+                    }
+                    break;
+                }
+                default:
+                {
+                    while (i < length && data[i] != u'<')
+                        ++i;
+                    if (i == length)
+                        break;
+
+                    const int open = i;
+                    if (startsWith(data, length, i, "<!--"))
+                    {
+                        int end = find(data, length, i + 4, "-->");
+                        i = end < 0 ? length : end;
+                        state = end < 0 ? InComment : Default;
+                        appendToken(tokens, open, i, Comment);
+                    }
+                    else if (startsWith(data, length, i, "<![CDATA["))
+                    {
+                        i += 9;
+                        state = InCData;
+                        appendToken(tokens, open, i, Keyword);
+                    }
+                    else if (i + 1 < length && (isNameStart(data[i + 1]) || data[i + 1] == u'/' ||
+                                                data[i + 1] == u'!' || data[i + 1] == u'?'))
+                    {
+                        // <name, </name, <!DOCTYPE or <?xml
+                        i = endOfName(data, length, i + 2);
+                        state = InTag;
+                        appendToken(tokens, open, i, Keyword);
+                    }
+                    else
+                    {
+                        ++i;
+                    }
+                    break;
+                }
+                }
+            }
+            return state;
+        }
+
+    private:
+        static bool isNameStart(char16_t c)
+        {
+            return isIdentifierStart(c, false) || c == u':';
+        }
+
+        static int endOfName(const char16_t *data, int length, int from)
+        {
+            int i = from;
+            while (i < length && (isIdentifierPart(data[i], false) || data[i] == u':' || data[i] == u'.' || data[i] == u'-'))
+                ++i;
+            return i;
+        }
+
+        static int endOfAttributeValue(const char16_t *data, int length, int from, char16_t quote, int &state)
+        {
+            for (int i = from; i < length; ++i)
+            {
+                if (data[i] == quote)
+                {
+                    state = InTag;
+                    return i + 1;
+                }
+            }
+            state = InAttributeValue | (quote << 8);
+            return length;
+        }
+    };
+
+    /**
+     * @brief Lexer for CSS style sheets
+     *
+     * Selectors and at-rules outside blocks and property names inside them
+     * are reported as keywords. Bit 0 of the state marks an open comment and
+     * the remaining bits count the open blocks.
+     */
+    class CssLexer : public Lexer
+    {
+    public:
+        int tokenize(QStringView text, int state, QVector<Token> &tokens) const override
+        {
+            const char16_t *data = text.utf16();
+            const int length = int(text.size());
+            bool inComment = state & 1;
+            int depth = state >> 1;
+
+            int i = 0;
+            while (i < length)
+            {
+                const char16_t c = data[i];
+                const int start = i;
+
+                if (inComment || startsWith(data, length, i, "/*"))
+                {
+                    int end = find(data, length, inComment ? i : i + 2, "*/");
+                    i = end < 0 ? length : end;
+                    inComment = end < 0;
+                    appendToken(tokens, start, i, Comment);
+                }
+                else if (c == u'{')
+                {
+                    depth = qMin(depth + 1, MaxDepth);
+                    ++i;
+                }
+                else if (c == u'}')
+                {
+                    depth = qMax(depth - 1, 0);
+                    ++i;
+                }
+                else if (c == u'"' || c == u'\'')
+                {
+                    ++i;
+                    while (i < length && data[i] != c)
+                        i += data[i] == u'\\' ? 2 : 1;
+                    i = qMin(i + 1, length);
+                    appendToken(tokens, start, i, String);
+                }
+                else if (depth > 0 && c == u'#' && i + 1 < length && isIdentifierPart(data[i + 1], false))
+                {
+                    // Colours such as #fff
+                    i = endOfName(data, length, i + 1);
+                    appendToken(tokens, start, i, Number);
+                }
+                else if (isDigit(c) || (c == u'.' && i + 1 < length && isDigit(data[i + 1])))
+                {
+                    // Units and percentages belong to the number
+                    ++i;
+                    while (i < length && (isDigit(data[i]) || data[i] == u'.'))
+                        ++i;
+                    i = endOfName(data, length, i);
+                    if (i < length && data[i] == u'%')
+                        ++i;
+                    appendToken(tokens, start, i, Number);
+                }
+                else if (isNameStart(c) || ((c == u'.' || c == u'#' || c == u'@') && i + 1 < length && isNameStart(data[i + 1])))
+                {
+                    i = endOfName(data, length, i + 1);
+                    if (depth == 0 || c == u'@' || isFollowedByColonOrBrace(data, length, i))
+                    {
+                        appendToken(tokens, start, i, Keyword);
+                    }
+                }
+                else
+                {
+                    ++i;
+                }
+            }
+            return (depth << 1) | (inComment ? 1 : 0);
+        }
+
+    private:
+        static constexpr int MaxDepth = 0xffff;
+
+        static bool isNameStart(char16_t c)
+        {
+            return isIdentifierStart(c, false) || c == u'-';
+        }
+
+        static int endOfName(const char16_t *data, int length, int from)
+        {
+            int i = from;
+            while (i < length && (isIdentifierPart(data[i], false) || data[i] == u'-'))
+                ++i;
+            return i;
+        }
+
+        static bool isFollowedByColonOrBrace(const char16_t *data, int length, int from)
+        {
+            int i = from;
+            while (i < length && (data[i] == u' ' || data[i] == u'\t'))
+                ++i;
+            return i < length && (data[i] == u':' || data[i] == u'{');
+        }
+    };
+}
+
+const Lexer *Lexer::cpp()
+{
+    static const CodeLexer lexer({&cppKeywords, "//", "/*", "*/", "\"'", nullptr, false, true, false});
+    return &lexer;
+}
+
+const Lexer *Lexer::python()
+{
+    static const CodeLexer lexer({&pythonKeywords, "#", nullptr, nullptr, "\"'", nullptr, true, true, false});
+    return &lexer;
+}
+
+const Lexer *Lexer::javaScript()
+{
+    static const CodeLexer lexer({&javaScriptKeywords, "//", "/*", "*/", "\"'`", "`", false, true, true});
+    return &lexer;
+}
+
+const Lexer *Lexer::json()
+{
+    static const CodeLexer lexer({&jsonKeywords, nullptr, nullptr, nullptr, "\"", nullptr, false, true, false});
+    return &lexer;
+}
+
+const Lexer *Lexer::sql()
+{
+    static const CodeLexer lexer({&sqlKeywords, "--", "/*", "*/", "'", nullptr, false, false, false});
+    return &lexer;
+}
+
+const Lexer *Lexer::markup()
+{
+    static const MarkupLexer lexer;
+    return &lexer;
+}
+
+const Lexer *Lexer::css()
+{
+    static const CssLexer lexer;
+    return &lexer;
+}
@@ -0,0 +1,208 @@
+#include "lineendings.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LINEENDINGS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+#ifdef LINEENDINGS_SSE2
+    // True when none of the eight characters at data is '\n' or '\r'
+    bool hasNoBreaks(const char16_t *data)
+    {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        __m128i breaks = _mm_or_si128(_mm_cmpeq_epi16(chars, _mm_set1_epi16('\n')),
+                                      _mm_cmpeq_epi16(chars, _mm_set1_epi16('\r')));
+        return _mm_movemask_epi8(breaks) == 0;
+    }
+#else
+    bool hasNoBreaks(const char16_t *data)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            if (data[i] == u'\n' || data[i] == u'\r')
+                return false;
+        }
+        return true;
+    }
+#endif
+}
+
+LineEndings::LineEndings()
+    : counts{0, 0, 0}, breaks(0), pendingCarriageReturn(false)
+{
+}
+
+void LineEndings::normalize(QString &text, QVector<qsizetype> *lineFeeds)
+{
+    if (text.isEmpty())
+        return;
+
+    char16_t *data = reinterpret_cast<char16_t *>(text.data());
+    const qsizetype size = text.size();
+    qsizetype in = 0;
+    qsizetype out = 0;
+
+    // A CR at the end of the previous chunk was counted as a lone CR
+    if (pendingCarriageReturn && data[0] == u'\n')
+    {
+        --counts[CR];
+        --breaks;
+        if (styleRuns.last().line == breaks)
+        {
+            styleRuns.removeLast();
+        }
+        addBreak(CRLF);
+        in = 1;
+    }
+    pendingCarriageReturn = false;
+
+    while (in < size)
+    {
+        // Runs without line breaks are skipped, or shifted down once a
+        // CRLF has been collapsed earlier in the chunk
+        if (in + 8 <= size && hasNoBreaks(data + in))
+        {
+            if (out != in)
+            {
+                std::memmove(data + out, data + in, 8 * sizeof(char16_t));
+            }
+            in += 8;
+            out += 8;
+            continue;
+        }
+
+        char16_t c = data[in++];
+        if (c == u'\r')
+        {
+            if (in < size && data[in] == u'\n')
+            {
+                addBreak(CRLF);
+                ++in;
+            }
+            else
+            {
+                addBreak(CR);
+                pendingCarriageReturn = in == size;
+            }
+            c = u'\n';
+        }
+        else if (c == u'\n')
+        {
+            addBreak(LF);
+        }
+
+        if (c == u'\n' && lineFeeds)
+        {
+            lineFeeds->append(out);
+        }
+        data[out++] = c;
+    }
+
+    text.truncate(out);
+}
+
+void LineEndings::addBreak(Style style)
+{
+    ++counts[style];
+    if (styleRuns.isEmpty() || styleRuns.last().style != style)
+    {
+        styleRuns.append({breaks, style});
+    }
+    ++breaks;
+}
+
+LineEndings::Style LineEndings::dominant() const
+{
+    if (counts[CRLF] > counts[LF] && counts[CRLF] >= counts[CR])
+        return CRLF;
+    if (counts[CR] > counts[LF] && counts[CR] > counts[CRLF])
+        return CR;
+    if (counts[LF] == 0 && counts[CRLF] == 0 && counts[CR] == 0)
+        return nativeStyle();
+    return LF;
+}
+
+bool LineEndings::isMixed() const
+{
+    int kinds = (counts[LF] > 0) + (counts[CRLF] > 0) + (counts[CR] > 0);
+    return kinds > 1;
+}
+
+QString LineEndings::separator(Style style)
+{
+    switch (style)
+    {
+    case CRLF:
+        return QStringLiteral("\r\n");
+    case CR:
+        return QStringLiteral("\r");
+    case LF:
+        break;
+    }
+    return QStringLiteral("\n");
+}
+
+QString LineEndings::name(Style style)
+{
+    switch (style)
+    {
+    case CRLF:
+        return QStringLiteral("CRLF");
+    case CR:
+        return QStringLiteral("CR");
+    case LF:
+        break;
+    }
+    return QStringLiteral("LF");
+}
+
+LineEndings::Style LineEndings::nativeStyle()
+{
+#ifdef Q_OS_WIN
+    return CRLF;
+#else
+    return LF;
+#endif
+}
+
+LineTerminators::LineTerminators(const LineEndings &lineEndings)
+{
+    if (!lineEndings.isMixed())
+        return;
+
+    const LineEndings::Style dominant = lineEndings.dominant();
+    const QVector<LineEndings::Run> &runs = lineEndings.runs();
+    for (qsizetype i = 0; i < runs.size(); ++i)
+    {
+        if (runs[i].style == dominant)
+            continue;
+
+        qsizetype end = i + 1 < runs.size() ? runs[i + 1].line : lineEndings.lineBreaks();
+        for (qsizetype line = runs[i].line; line < end; ++line)
+        {
+            overrides.append({line, runs[i].style});
+        }
+    }
+}
+
+void LineTerminators::linesChanged(qsizetype line, qsizetype removed, qsizetype added)
+{
+    if (overrides.isEmpty() || (removed == 0 && added == 0))
+        return;
+
+    auto byLine = [](const Override &entry, qsizetype value) { return entry.line < value; };
+    auto first = std::lower_bound(overrides.begin(), overrides.end(), line, byLine);
+    auto last = std::lower_bound(first, overrides.end(), line + removed, byLine);
+    qsizetype index = first - overrides.begin();
+    overrides.erase(first, last);
+
+    for (auto it = overrides.begin() + index; it != overrides.end(); ++it)
+    {
+        it->line += added - removed;
+    }
+}
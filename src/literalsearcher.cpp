@@ -0,0 +1,211 @@
+#include "literalsearcher.h"
+
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LITERALSEARCHER_SSE2
+#include <emmintrin.h>
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LITERALSEARCHER_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace
+{
+    /**
+     * @brief What the vector filter compares at each candidate position
+     *
+     * The fold bits are 0x20 when the character is an ASCII letter searched
+     * case-insensitively: OR-ing them in maps both cases to lower case. Other
+     * characters can collide the same way, which verify() rejects.
+     */
+    struct Filter
+    {
+        char16_t first;
+        char16_t last;
+        char16_t firstFold;
+        char16_t lastFold;
+        qsizetype lastOffset;
+    };
+
+    bool isAsciiLetter(char16_t c)
+    {
+        return (c >= u'a' && c <= u'z') || (c >= u'A' && c <= u'Z');
+    }
+
+    char16_t foldAscii(char16_t c)
+    {
+        return (c >= u'A' && c <= u'Z') ? char16_t(c | 0x20) : c;
+    }
+
+#ifdef LITERALSEARCHER_SSE2
+    // Moves position to the first block position passing the filter and
+    // returns true, or to where full blocks run out and returns false
+    bool scanSse2(const char16_t *text, qsizetype &position, qsizetype limit, const Filter &filter)
+    {
+        const __m128i first = _mm_set1_epi16(short(filter.first));
+        const __m128i last = _mm_set1_epi16(short(filter.last));
+        const __m128i firstFold = _mm_set1_epi16(short(filter.firstFold));
+        const __m128i lastFold = _mm_set1_epi16(short(filter.lastFold));
+
+        qsizetype i = position;
+        for (; i + 8 <= limit; i += 8)
+        {
+            __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+            __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i + filter.lastOffset));
+            __m128i hits = _mm_and_si128(_mm_cmpeq_epi16(_mm_or_si128(head, firstFold), first),
+                                         _mm_cmpeq_epi16(_mm_or_si128(tail, lastFold), last));
+            quint32 mask = quint32(_mm_movemask_epi8(hits));
+            if (mask != 0)
+            {
+                position = i + qCountTrailingZeroBits(mask) / 2;
+                return true;
+            }
+        }
+        position = i;
+        return false;
+    }
+#endif
+
+#ifdef LITERALSEARCHER_AVX2
+    __attribute__((target("avx2"))) bool scanAvx2(const char16_t *text, qsizetype &position, qsizetype limit, const Filter &filter)
+    {
+        const __m256i first = _mm256_set1_epi16(short(filter.first));
+        const __m256i last = _mm256_set1_epi16(short(filter.last));
+        const __m256i firstFold = _mm256_set1_epi16(short(filter.firstFold));
+        const __m256i lastFold = _mm256_set1_epi16(short(filter.lastFold));
+
+        qsizetype i = position;
+        for (; i + 16 <= limit; i += 16)
+        {
+            __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+            __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i + filter.lastOffset));
+            __m256i hits = _mm256_and_si256(_mm256_cmpeq_epi16(_mm256_or_si256(head, firstFold), first),
+                                            _mm256_cmpeq_epi16(_mm256_or_si256(tail, lastFold), last));
+            quint32 mask = quint32(_mm256_movemask_epi8(hits));
+            if (mask != 0)
+            {
+                position = i + qCountTrailingZeroBits(mask) / 2;
+                return true;
+            }
+        }
+        position = i;
+        return false;
+    }
+
+    bool cpuHasAvx2()
+    {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+#endif
+}
+
+LiteralSearcher::LiteralSearcher(const QString &needle, Qt::CaseSensitivity caseSensitivity, bool wholeWord)
+    : needle(needle), caseSensitivity(caseSensitivity), wholeWord(wholeWord), unicodeFallback(false), folded(needle), firstFold(0), lastFold(0)
+{
+    if (caseSensitivity == Qt::CaseSensitive || needle.isEmpty())
+        return;
+
+    for (QChar c : needle)
+    {
+        if (c.unicode() >= 0x80)
+        {
+            unicodeFallback = true;
+            return;
+        }
+    }
+
+    for (QChar &c : folded)
+    {
+        c = QChar(foldAscii(c.unicode()));
+    }
+    firstFold = isAsciiLetter(folded.front().unicode()) ? 0x20 : 0;
+    lastFold = isAsciiLetter(folded.back().unicode()) ? 0x20 : 0;
+}
+
+qsizetype LiteralSearcher::indexIn(QStringView text, qsizetype from, qsizetype to) const
+{
+    if (needle.isEmpty())
+        return -1;
+
+    if (to < 0 || to > text.size())
+        to = text.size();
+
+    qsizetype position = findCandidate(text, qMax<qsizetype>(0, from), to);
+    while (wholeWord && position >= 0 && !isWholeWord(text, position))
+    {
+        position = findCandidate(text, position + 1, to);
+    }
+    return position;
+}
+
+qsizetype LiteralSearcher::findCandidate(QStringView text, qsizetype from, qsizetype to) const
+{
+    if (unicodeFallback)
+    {
+        // Stop the scan where a match would start too late
+        QStringView window = text.left(qMin(text.size(), to + needle.size() - 1));
+        return window.indexOf(needle, from, Qt::CaseInsensitive);
+    }
+
+    const char16_t *data = text.utf16();
+    qsizetype limit = qMin(text.size() - needle.size() + 1, to);
+    qsizetype position = from;
+
+#ifdef LITERALSEARCHER_SSE2
+    const Filter filter = {folded.front().unicode(), folded.back().unicode(), firstFold, lastFold, needle.size() - 1};
+    while (position < limit)
+    {
+#ifdef LITERALSEARCHER_AVX2
+        bool hit = cpuHasAvx2() ? scanAvx2(data, position, limit, filter) : scanSse2(data, position, limit, filter);
+#else
+        bool hit = scanSse2(data, position, limit, filter);
+#endif
+        if (!hit)
+            break;
+        if (verify(data + position))
+            return position;
+        ++position;
+    }
+#endif
+
+    return scanScalar(data, position, limit);
+}
+
+qsizetype LiteralSearcher::scanScalar(const char16_t *text, qsizetype from, qsizetype end) const
+{
+    const char16_t first = folded.front().unicode();
+    for (qsizetype i = from; i < end; ++i)
+    {
+        if (char16_t(text[i] | firstFold) == first && verify(text + i))
+            return i;
+    }
+    return -1;
+}
+
+bool LiteralSearcher::verify(const char16_t *candidate) const
+{
+    const char16_t *pattern = reinterpret_cast<const char16_t *>(folded.utf16());
+    if (caseSensitivity == Qt::CaseSensitive)
+        return std::memcmp(candidate, pattern, size_t(folded.size()) * sizeof(char16_t)) == 0;
+
+    for (qsizetype i = 0; i < folded.size(); ++i)
+    {
+        if (foldAscii(candidate[i]) != pattern[i])
+            return false;
+    }
+    return true;
+}
+
+bool LiteralSearcher::isWholeWord(QStringView text, qsizetype position) const
+{
+    // Same rule as \b around the needle: each end must switch between word
+    // and non-word characters, whichever kind the needle starts or ends with
+    qsizetype end = position + needle.size();
+    bool before = position > 0 && isWordCharacter(text[position - 1]);
+    bool after = end < text.size() && isWordCharacter(text[end]);
+    return before != isWordCharacter(text[position]) && after != isWordCharacter(text[end - 1]);
+}
@@ -22,11 +22,7 @@ int main(int argc, char *argv[])
     window.show();
 
     // Open files from command line arguments
-    for (int i = 1; i < argc; ++i)
-    {
-        QString fileName = QString::fromLocal8Bit(argv[i]);
-        window.findChild<QTabWidget *>(); // TODO: Open file in editor
-    }
+    window.openFiles(app.arguments().mid(1));
 
     return app.exec();
 }
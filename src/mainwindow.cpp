@@ -2,6 +2,10 @@
 #include "editor.h"
 #include "documentmanager.h"
 #include "searchreplace.h"
+#include "largefileviewer.h"
+#include "findinfilespanel.h"
+#include "piecetable.h"
+#include "trigramindex.h"
 
 #include <QApplication>
 #include <QVBoxLayout>
@@ -9,6 +13,7 @@
 #include <QTabWidget>
 #include <QToolBar>
 #include <QStatusBar>
+#include <QLabel>
 #include <QMenuBar>
 #include <QMenu>
 #include <QAction>
@@ -20,9 +25,12 @@
 #include <QDesktopServices>
 #include <QUrl>
 #include <QInputDialog>
+#include <QTimer>
+#include <QSet>
+#include <QTextBlock>
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), tabWidget(nullptr), documentManager(std::make_unique<DocumentManager>(this)), searchReplace(std::make_unique<SearchReplace>(this)), currentFontSize(12), currentTheme("Light")
+    : QMainWindow(parent), tabWidget(nullptr), matchCountLabel(nullptr), findInFilesPanel(nullptr), searchDialog(nullptr), documentManager(std::make_unique<DocumentManager>(this)), searchReplace(std::make_unique<SearchReplace>(this)), currentFontSize(12), currentTheme("Light"), searchIndexMemoryLimit(TrigramIndex::DefaultMemoryLimit)
 {
     setWindowTitle("Professional Text Editor");
     setWindowIcon(QIcon());
@@ -34,6 +42,11 @@ MainWindow::MainWindow(QWidget *parent)
     tabWidget->setMovable(true);
     setCentralWidget(tabWidget);
 
+    // Find in files results, docked at the bottom and hidden until used
+    findInFilesPanel = new FindInFilesPanel(this);
+    addDockWidget(Qt::BottomDockWidgetArea, findInFilesPanel);
+    findInFilesPanel->hide();
+
     // Create UI components
     createMenuBar();
     createToolBars();
@@ -45,6 +58,9 @@ MainWindow::MainWindow(QWidget *parent)
 
     // Enable drag and drop
     setAcceptDrops(true);
+
+    // Offer unsaved work from a crashed session once the window is up
+    QTimer::singleShot(0, this, &MainWindow::recoverDocuments);
 }
 
 MainWindow::~MainWindow()
@@ -65,6 +81,12 @@ void MainWindow::createMenuBar()
     openAction->setShortcut(QKeySequence::Open);
     connect(openAction, &QAction::triggered, this, &MainWindow::openFile);
 
+    openReadOnlyAction = fileMenu->addAction(tr("Open &Read-Only..."));
+    connect(openReadOnlyAction, &QAction::triggered, this, &MainWindow::openReadOnlyFile);
+
+    cancelLoadAction = fileMenu->addAction(tr("Cancel &Loading"));
+    connect(cancelLoadAction, &QAction::triggered, this, &MainWindow::cancelLoading);
+
     fileMenu->addSeparator();
 
     recentFilesMenu = fileMenu->addMenu(tr("&Recent Files"));
@@ -175,6 +197,17 @@ void MainWindow::createMenuBar()
     findPrevAction->setShortcut(QKeySequence::FindPrevious);
     connect(findPrevAction, &QAction::triggered, this, &MainWindow::findPrevious);
 
+    searchMenu->addSeparator();
+
+    findInFilesAction = searchMenu->addAction(tr("Find in F&iles..."));
+    findInFilesAction->setShortcut(Qt::CTRL | Qt::SHIFT | Qt::Key_F);
+    connect(findInFilesAction, &QAction::triggered, this, &MainWindow::openFindInFiles);
+
+    searchIndexAction = searchMenu->addAction(tr("Index Open &Documents"));
+    searchIndexAction->setCheckable(true);
+    searchIndexAction->setChecked(false);
+    connect(searchIndexAction, &QAction::triggered, this, &MainWindow::toggleSearchIndex);
+
     // Help Menu
     helpMenu = menuBar()->addMenu(tr("&Help"));
 
@@ -216,6 +249,10 @@ void MainWindow::createToolBars()
 void MainWindow::createStatusBar()
 {
     statusBar()->showMessage(tr("Ready"));
+
+    // Total of the current search, updated while the background scan runs
+    matchCountLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(matchCountLabel);
 }
 
 void MainWindow::createConnections()
@@ -224,6 +261,37 @@ void MainWindow::createConnections()
             this, &MainWindow::onTabChanged);
     connect(tabWidget, &QTabWidget::tabCloseRequested,
             this, &MainWindow::onTabCloseRequested);
+
+    connect(documentManager.get(), &DocumentManager::loadProgress,
+            this, &MainWindow::onLoadProgress);
+    connect(documentManager.get(), &DocumentManager::loadFinished,
+            this, &MainWindow::onLoadFinished);
+    connect(documentManager.get(), &DocumentManager::loadFailed,
+            this, &MainWindow::onLoadFailed);
+    connect(documentManager.get(), &DocumentManager::loadCancelled,
+            this, &MainWindow::onLoadCancelled);
+    connect(documentManager.get(), &DocumentManager::saveProgress,
+            this, &MainWindow::onSaveProgress);
+    connect(documentManager.get(), &DocumentManager::saveFinished,
+            this, &MainWindow::onSaveFinished);
+    connect(documentManager.get(), &DocumentManager::saveFailed,
+            this, &MainWindow::onSaveFailed);
+
+    connect(searchReplace.get(), &SearchReplace::matchFound,
+            this, &MainWindow::selectMatch);
+    connect(searchReplace.get(), &SearchReplace::noMatchFound, this,
+            [this]()
+            {
+                statusBar()->showMessage(tr("No matches found"), 3000);
+            });
+    connect(searchReplace.get(), &SearchReplace::matchesUpdated, this,
+            [this](int totalMatches)
+            {
+                matchCountLabel->setText(tr("%n match(es)", "", totalMatches));
+            });
+
+    connect(findInFilesPanel, &FindInFilesPanel::openRequested,
+            this, &MainWindow::openSearchHit);
 }
 
 void MainWindow::newFile()
@@ -235,50 +303,177 @@ void MainWindow::newFile()
 
     connect(editor->document(), &QTextDocument::modificationChanged,
             this, &MainWindow::onDocumentModified);
+    documentManager->trackEditor(editor);
 
     editor->setFocus();
 }
 
+void MainWindow::recoverDocuments()
+{
+    QVector<AutosaveJournal::RecoveredDocument> documents = documentManager->recoverDocuments();
+    if (documents.isEmpty())
+        return;
+
+    QMessageBox::StandardButton reply = QMessageBox::question(this, tr("Recover Documents"),
+                                                              tr("%n document(s) had unsaved changes when the editor last closed unexpectedly.\n"
+                                                                 "Do you want to recover them?",
+                                                                 "", documents.size()),
+                                                              QMessageBox::Yes | QMessageBox::No);
+
+    for (const AutosaveJournal::RecoveredDocument &document : std::as_const(documents))
+    {
+        if (reply == QMessageBox::Yes)
+        {
+            Editor *editor = new Editor(this);
+            editor->setFileName(document.fileName);
+            editor->loadText(document.text);
+            editor->setModified(true);
+
+            int index = tabWidget->addTab(editor, QFileInfo(document.fileName).fileName());
+            tabWidget->setCurrentIndex(index);
+            updateTabTitle(editor);
+            connect(editor->document(), &QTextDocument::modificationChanged,
+                    this, &MainWindow::onDocumentModified);
+
+            // Journaled again from a fresh snapshot
+            documentManager->trackEditor(editor);
+        }
+        documentManager->discardRecoveredDocument(document.id);
+    }
+}
+
 void MainWindow::openFile()
+{
+    QStringList fileNames = QFileDialog::getOpenFileNames(this,
+                                                          tr("Open Files"), "",
+                                                          tr("All Files (*);;Text Files (*.txt);;C++ Files (*.cpp *.h);;Python Files (*.py);;JSON Files (*.json)"));
+
+    openFiles(fileNames);
+}
+
+void MainWindow::openFiles(const QStringList &fileNames)
+{
+    // Tabs are created in the given order right away; the files then load
+    // in parallel on the document manager's pool
+    QSet<QString> seen;
+    for (const QString &fileName : fileNames)
+    {
+        QFileInfo info(fileName);
+        if (!info.isFile())
+        {
+            reportOpenFailure(fileName, info.exists() ? tr("Not a regular file") : tr("No such file"));
+            continue;
+        }
+
+        // The same file given twice, through a symlink or a hard link
+        QString identity = documentManager->fileIdentity(fileName);
+        if (seen.contains(identity))
+            continue;
+        seen.insert(identity);
+
+        openPath(info.absoluteFilePath(), documentManager->shouldOpenReadOnly(fileName));
+    }
+}
+
+void MainWindow::openReadOnlyFile()
 {
     QString fileName = QFileDialog::getOpenFileName(this,
-                                                    tr("Open File"), "",
-                                                    tr("All Files (*);;Text Files (*.txt);;C++ Files (*.cpp *.h);;Python Files (*.py);;JSON Files (*.json)"));
+                                                    tr("Open File Read-Only"), "",
+                                                    tr("All Files (*);;Log Files (*.log);;Text Files (*.txt)"));
 
     if (!fileName.isEmpty())
     {
-        Editor *editor = nullptr;
+        openPath(fileName, true);
+    }
+}
 
-        // Check if file is already open
-        for (int i = 0; i < tabWidget->count(); ++i)
+bool MainWindow::openPath(const QString &fileName, bool readOnly)
+{
+    // Check if file is already open, under any name
+    int existing = findTab(fileName);
+    if (existing >= 0)
+    {
+        tabWidget->setCurrentIndex(existing);
+        return true;
+    }
+
+    if (readOnly)
+    {
+        LargeFileViewer *viewer = new LargeFileViewer(this);
+        if (documentManager->openReadOnly(fileName, viewer))
         {
-            Editor *e = qobject_cast<Editor *>(tabWidget->widget(i));
-            if (e && e->fileName() == fileName)
-            {
-                tabWidget->setCurrentIndex(i);
-                return;
-            }
-        }
+            int index = tabWidget->addTab(viewer, tr("%1 [read-only]").arg(QFileInfo(fileName).fileName()));
+            tabWidget->setCurrentIndex(index);
 
-        // Create new editor
-        editor = new Editor(this);
-        if (documentManager->openFile(fileName, editor))
+            connect(viewer, &LargeFileViewer::indexingFinished, this, [this](qint64 lines)
+                    { statusBar()->showMessage(tr("Indexed %1 lines").arg(lines), 5000); });
+
+            statusBar()->showMessage(tr("Opened read-only: %1").arg(fileName), 5000);
+            return true;
+        }
+        delete viewer;
+    }
+    else
+    {
+        // Read and decode on a worker; the tab fills in as chunks arrive
+        Editor *editor = new Editor(this);
+        if (documentManager->openFileAsync(fileName, editor))
         {
-            int index = tabWidget->addTab(editor, QFileInfo(fileName).fileName());
+            int index = tabWidget->addTab(editor, tr("%1 (0%)").arg(QFileInfo(fileName).fileName()));
             tabWidget->setCurrentIndex(index);
 
-            connect(editor->document(), &QTextDocument::modificationChanged,
-                    this, &MainWindow::onDocumentModified);
+            statusBar()->showMessage(tr("Loading: %1").arg(fileName));
+            return true;
+        }
+        delete editor;
+    }
 
-            statusBar()->showMessage(tr("Opened: %1").arg(fileName), 5000);
+    reportOpenFailure(fileName, tr("Cannot read the file"));
+    return false;
+}
+
+void MainWindow::reportOpenFailure(const QString &fileName, const QString &reason)
+{
+    // Failures of one batch of files are collected into a single message
+    openFailures.append(tr("%1: %2").arg(fileName, reason));
+    if (openFailures.size() == 1)
+    {
+        QTimer::singleShot(250, this, &MainWindow::showOpenFailures);
+    }
+}
+
+void MainWindow::showOpenFailures()
+{
+    if (openFailures.isEmpty())
+        return;
+
+    QStringList failures = openFailures;
+    openFailures.clear();
+    QMessageBox::warning(this, tr("Open File"),
+                         tr("Cannot open %n file(s):", "", failures.size()) + "\n\n" + failures.join('\n'));
+}
+
+int MainWindow::findTab(const QString &fileName) const
+{
+    QString identity = documentManager->fileIdentity(fileName);
+    for (int i = 0; i < tabWidget->count(); ++i)
+    {
+        QString tabFileName;
+        if (Editor *editor = qobject_cast<Editor *>(tabWidget->widget(i)))
+        {
+            tabFileName = editor->fileName();
         }
-        else
+        else if (LargeFileViewer *viewer = qobject_cast<LargeFileViewer *>(tabWidget->widget(i)))
+        {
+            tabFileName = viewer->fileName();
+        }
+
+        if (!tabFileName.isEmpty() && (tabFileName == fileName || documentManager->fileIdentity(tabFileName) == identity))
         {
-            delete editor;
-            QMessageBox::warning(this, tr("Open File"),
-                                 tr("Cannot open file:\n%1").arg(fileName));
+            return i;
         }
     }
+    return -1;
 }
 
 void MainWindow::openRecent()
@@ -290,57 +485,103 @@ void MainWindow::openRecent()
     }
 }
 
+void MainWindow::cancelLoading()
+{
+    Editor *editor = currentEditor();
+    if (editor && editor->isLoading())
+    {
+        documentManager->cancelLoad(editor);
+    }
+}
+
 void MainWindow::saveFile()
 {
     Editor *editor = currentEditor();
     if (editor)
     {
-        if (editor->fileName().contains("Untitled"))
-        {
-            saveAsFile();
-        }
-        else if (documentManager->saveFile(editor))
-        {
-            statusBar()->showMessage(tr("File saved: %1").arg(editor->fileName()), 5000);
-        }
+        saveEditor(editor, false);
     }
 }
 
 void MainWindow::saveAsFile()
 {
     Editor *editor = currentEditor();
-    if (!editor)
-        return;
-
-    QString fileName = QFileDialog::getSaveFileName(this,
-                                                    tr("Save File As"), editor->fileName(),
-                                                    tr("All Files (*);;Text Files (*.txt);;C++ Files (*.cpp);;Python Files (*.py);;JSON Files (*.json)"));
-
-    if (!fileName.isEmpty())
+    if (editor)
     {
-        if (documentManager->saveFileAs(editor, fileName))
-        {
-            int index = tabWidget->currentIndex();
-            tabWidget->setTabText(index, QFileInfo(fileName).fileName());
-            statusBar()->showMessage(tr("File saved: %1").arg(fileName), 5000);
-        }
+        saveEditorAs(editor, false);
     }
 }
 
 void MainWindow::saveAllFiles()
 {
+    int started = 0;
     for (int i = 0; i < tabWidget->count(); ++i)
     {
         Editor *editor = qobject_cast<Editor *>(tabWidget->widget(i));
-        if (editor && editor->isModified())
+        if (editor && editor->isModified() && !editor->isLoading())
         {
             if (!editor->fileName().contains("Untitled"))
             {
-                documentManager->saveFile(editor);
+                documentManager->saveFileAsync(editor, editor->fileName());
+                ++started;
             }
         }
     }
-    statusBar()->showMessage(tr("All files saved"), 5000);
+    statusBar()->showMessage(tr("Saving %n file(s)", "", started), 5000);
+}
+
+bool MainWindow::saveEditor(Editor *editor, bool wait)
+{
+    if (editor->isLoading())
+    {
+        statusBar()->showMessage(tr("Cannot save while the file is still loading"), 5000);
+        return false;
+    }
+
+    if (editor->fileName().contains("Untitled"))
+    {
+        return saveEditorAs(editor, wait);
+    }
+
+    if (wait)
+    {
+        if (!documentManager->saveFile(editor))
+        {
+            QMessageBox::warning(this, tr("Save File"),
+                                 tr("Cannot save file:\n%1").arg(editor->fileName()));
+            return false;
+        }
+        updateTabTitle(editor);
+        statusBar()->showMessage(tr("File saved: %1").arg(editor->fileName()), 5000);
+        return true;
+    }
+
+    return documentManager->saveFileAsync(editor, editor->fileName());
+}
+
+bool MainWindow::saveEditorAs(Editor *editor, bool wait)
+{
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    tr("Save File As"), editor->fileName(),
+                                                    tr("All Files (*);;Text Files (*.txt);;C++ Files (*.cpp);;Python Files (*.py);;JSON Files (*.json)"));
+
+    if (fileName.isEmpty())
+        return false;
+
+    if (wait)
+    {
+        if (!documentManager->saveFileAs(editor, fileName))
+        {
+            QMessageBox::warning(this, tr("Save File"),
+                                 tr("Cannot save file:\n%1").arg(fileName));
+            return false;
+        }
+        updateTabTitle(editor);
+        statusBar()->showMessage(tr("File saved: %1").arg(fileName), 5000);
+        return true;
+    }
+
+    return documentManager->saveFileAsync(editor, fileName);
 }
 
 void MainWindow::closeCurrentFile()
@@ -494,24 +735,139 @@ void MainWindow::changeTheme()
 
 void MainWindow::openFindDialog()
 {
-    // TODO: Show find dialog
-    statusBar()->showMessage("Find dialog opened");
+    // One modeless dialog serves find and replace
+    if (!searchDialog)
+    {
+        searchDialog = new SearchReplaceDialog(this);
+        searchDialog->setSearchManager(searchReplace.get());
+    }
+    searchDialog->setEditor(currentEditor());
+    searchDialog->show();
+    searchDialog->raise();
+    searchDialog->activateWindow();
 }
 
 void MainWindow::openReplaceDialog()
 {
-    // TODO: Show replace dialog
-    statusBar()->showMessage("Replace dialog opened");
+    openFindDialog();
 }
 
 void MainWindow::findNext()
 {
-    // TODO: Find next occurrence
+    if (Editor *editor = currentEditor())
+    {
+        searchReplace->findNext(editor);
+    }
 }
 
 void MainWindow::findPrevious()
 {
-    // TODO: Find previous occurrence
+    if (Editor *editor = currentEditor())
+    {
+        searchReplace->findPrevious(editor);
+    }
+}
+
+void MainWindow::selectMatch(const SearchResult &result)
+{
+    // Selects without taking focus, so typing in the dialog carries on
+    Editor *editor = currentEditor();
+    if (!editor)
+        return;
+
+    int documentEnd = editor->document()->characterCount() - 1;
+    QTextCursor cursor(editor->document());
+    cursor.setPosition(qMin(result.startPosition, documentEnd));
+    cursor.setPosition(qMin(result.endPosition, documentEnd), QTextCursor::KeepAnchor);
+    editor->setTextCursor(cursor);
+    editor->centerCursor();
+}
+
+void MainWindow::openFindInFiles()
+{
+    Editor *editor = currentEditor();
+    findInFilesPanel->setSearchText(editor ? editor->selectedText() : QString());
+    findInFilesPanel->show();
+    findInFilesPanel->raise();
+}
+
+void MainWindow::openSearchHit(const QString &fileName, int lineNumber, int columnNumber, int length)
+{
+    if (!openPath(fileName, documentManager->shouldOpenReadOnly(fileName)))
+        return;
+
+    int index = findTab(fileName);
+    if (index < 0)
+        return;
+
+    if (Editor *editor = qobject_cast<Editor *>(tabWidget->widget(index)))
+    {
+        if (editor->isLoading())
+        {
+            pendingNavigation.insert(editor, {lineNumber, columnNumber, length});
+        }
+        else
+        {
+            goToMatch(editor, lineNumber, columnNumber, length);
+        }
+    }
+    else if (LargeFileViewer *viewer = qobject_cast<LargeFileViewer *>(tabWidget->widget(index)))
+    {
+        viewer->goToLine(lineNumber);
+    }
+}
+
+void MainWindow::goToMatch(Editor *editor, int lineNumber, int columnNumber, int length)
+{
+    QTextBlock block = editor->document()->findBlockByNumber(lineNumber);
+    if (!block.isValid())
+        return;
+
+    // The file may have changed since it was searched; stay inside the line
+    int lineEnd = block.position() + block.length() - 1;
+    int start = qMin(block.position() + columnNumber, lineEnd);
+    QTextCursor cursor(editor->document());
+    cursor.setPosition(start);
+    cursor.setPosition(qMin(start + length, lineEnd), QTextCursor::KeepAnchor);
+    editor->setTextCursor(cursor);
+    editor->centerCursor();
+    editor->setFocus();
+}
+
+void MainWindow::toggleSearchIndex()
+{
+    qint64 indexBytes = 0;
+    qint64 textBytes = 0;
+    for (int i = 0; i < tabWidget->count(); ++i)
+    {
+        Editor *editor = qobject_cast<Editor *>(tabWidget->widget(i));
+        if (editor)
+        {
+            applySearchIndex(editor);
+            std::shared_ptr<const TrigramIndex> index = editor->getSearchIndex();
+            if (index && index->isBuilt())
+            {
+                indexBytes += index->memoryUsage();
+                textBytes += editor->getPieceTable()->length() * qint64(sizeof(QChar));
+            }
+        }
+    }
+
+    // Indexes are built by the first search in each document
+    if (textBytes > 0)
+    {
+        statusBar()->showMessage(tr("Search index: %1 KB for %2 KB of text (%3 KB per MB)")
+                                     .arg(indexBytes / 1024)
+                                     .arg(textBytes / 1024)
+                                     .arg(indexBytes * 1024 / textBytes),
+                                 5000);
+    }
+}
+
+void MainWindow::applySearchIndex(Editor *editor)
+{
+    editor->setSearchIndexEnabled(searchIndexAction->isChecked());
+    editor->setSearchIndexMemoryLimit(searchIndexMemoryLimit);
 }
 
 void MainWindow::showAbout()
@@ -539,6 +895,13 @@ void MainWindow::onTabChanged(int index)
                     .arg(editor->currentLineNumber() + 1)
                     .arg(editor->currentColumnNumber() + 1));
             searchReplace->setCurrentEditor(editor);
+            if (searchDialog)
+            {
+                searchDialog->setEditor(editor);
+            }
+
+            // New tabs pick up the index setting when first shown
+            applySearchIndex(editor);
         }
     }
 }
@@ -548,7 +911,11 @@ void MainWindow::onTabCloseRequested(int index)
     Editor *editor = qobject_cast<Editor *>(tabWidget->widget(index));
     if (editor)
     {
-        if (editor->isModified())
+        if (editor->isLoading())
+        {
+            documentManager->cancelLoad(editor);
+        }
+        else if (editor->isModified())
         {
             QMessageBox::StandardButton reply = QMessageBox::question(this,
                                                                       tr("Unsaved Changes"),
@@ -560,33 +927,135 @@ void MainWindow::onTabCloseRequested(int index)
             {
                 return;
             }
-            else if (reply == QMessageBox::Save)
+            else if (reply == QMessageBox::Save && !saveEditor(editor, true))
             {
-                saveFile();
+                return;
             }
         }
         tabWidget->removeTab(index);
         delete editor;
     }
+    else if (LargeFileViewer *viewer = qobject_cast<LargeFileViewer *>(tabWidget->widget(index)))
+    {
+        tabWidget->removeTab(index);
+        delete viewer;
+    }
 }
 
 void MainWindow::onDocumentModified()
 {
-    Editor *editor = currentEditor();
-    if (editor && tabWidget->currentIndex() >= 0)
+    QTextDocument *document = qobject_cast<QTextDocument *>(sender());
+    for (int i = 0; i < tabWidget->count(); ++i)
     {
-        QString tabText = tabWidget->tabText(tabWidget->currentIndex());
-        if (!tabText.endsWith("*"))
+        Editor *editor = qobject_cast<Editor *>(tabWidget->widget(i));
+        if (editor && editor->document() == document)
         {
-            tabWidget->setTabText(tabWidget->currentIndex(), tabText + "*");
+            updateTabTitle(editor);
+            return;
         }
     }
 }
 
+void MainWindow::onLoadProgress(Editor *editor, int percent)
+{
+    updateTabTitle(editor, tr("%1%").arg(percent));
+}
+
+void MainWindow::onLoadFinished(Editor *editor)
+{
+    updateTabTitle(editor);
+
+    if (pendingNavigation.contains(editor))
+    {
+        PendingNavigation target = pendingNavigation.take(editor);
+        goToMatch(editor, target.lineNumber, target.columnNumber, target.length);
+    }
+
+    connect(editor->document(), &QTextDocument::modificationChanged,
+            this, &MainWindow::onDocumentModified);
+
+    QString lineEnding = LineEndings::name(editor->lineEnding());
+    if (editor->hasMixedLineEndings())
+    {
+        statusBar()->showMessage(tr("Opened: %1 (%2, mixed line endings kept, new lines end in %3)")
+                                     .arg(editor->fileName(), editor->encoding(), lineEnding),
+                                 5000);
+    }
+    else
+    {
+        statusBar()->showMessage(tr("Opened: %1 (%2, %3)").arg(editor->fileName(), editor->encoding(), lineEnding), 5000);
+    }
+}
+
+void MainWindow::onLoadFailed(Editor *editor, const QString &errorString)
+{
+    pendingNavigation.remove(editor);
+    QString fileName = editor->fileName();
+    int index = tabWidget->indexOf(editor);
+    if (index >= 0)
+    {
+        tabWidget->removeTab(index);
+    }
+    editor->deleteLater();
+
+    reportOpenFailure(fileName, errorString);
+}
+
+void MainWindow::onLoadCancelled(Editor *editor)
+{
+    pendingNavigation.remove(editor);
+    QString fileName = editor->fileName();
+    int index = tabWidget->indexOf(editor);
+    if (index >= 0)
+    {
+        tabWidget->removeTab(index);
+    }
+    editor->deleteLater();
+
+    statusBar()->showMessage(tr("Loading cancelled: %1").arg(fileName), 5000);
+}
+
+void MainWindow::onSaveProgress(Editor *editor, int percent)
+{
+    updateTabTitle(editor, tr("saving %1%").arg(percent));
+}
+
+void MainWindow::onSaveFinished(Editor *editor, const QString &fileName)
+{
+    updateTabTitle(editor);
+    statusBar()->showMessage(tr("File saved: %1").arg(fileName), 5000);
+}
+
+void MainWindow::onSaveFailed(Editor *editor, const QString &errorString)
+{
+    updateTabTitle(editor, tr("save failed"));
+    QMessageBox::warning(this, tr("Save File"),
+                         tr("Cannot save file:\n%1\n%2").arg(editor->fileName(), errorString));
+}
+
+void MainWindow::updateTabTitle(Editor *editor, const QString &status)
+{
+    int index = tabWidget->indexOf(editor);
+    if (index < 0)
+        return;
+
+    QString title = QFileInfo(editor->fileName()).fileName();
+    if (editor->isModified() && !editor->isLoading())
+    {
+        title += "*";
+    }
+    if (!status.isEmpty())
+    {
+        title += QString(" (%1)").arg(status);
+    }
+    tabWidget->setTabText(index, title);
+}
+
 void MainWindow::closeEvent(QCloseEvent *event)
 {
     if (maybeSaveAll())
     {
+        documentManager->waitForPendingSaves();
         writeSettings();
         event->accept();
     }
@@ -609,20 +1078,15 @@ void MainWindow::dropEvent(QDropEvent *event)
     const QMimeData *mimeData = event->mimeData();
     if (mimeData->hasUrls())
     {
+        QStringList fileNames;
         for (const QUrl &url : mimeData->urls())
         {
-            QString filePath = url.toLocalFile();
-            if (QFile::exists(filePath))
+            if (url.isLocalFile())
             {
-                // Open file
-                Editor *editor = new Editor(this);
-                if (documentManager->openFile(filePath, editor))
-                {
-                    int index = tabWidget->addTab(editor, QFileInfo(filePath).fileName());
-                    tabWidget->setCurrentIndex(index);
-                }
+                fileNames.append(url.toLocalFile());
             }
         }
+        openFiles(fileNames);
         event->acceptProposedAction();
     }
 }
@@ -635,6 +1099,8 @@ void MainWindow::readSettings()
 
     currentFontSize = settings.value("fontSize", 12).toInt();
     currentTheme = settings.value("theme", "Light").toString();
+    searchIndexAction->setChecked(settings.value("searchIndex", false).toBool());
+    searchIndexMemoryLimit = settings.value("searchIndexMemoryLimitMB", TrigramIndex::DefaultMemoryLimit / (1024 * 1024)).toLongLong() * 1024 * 1024;
 }
 
 void MainWindow::writeSettings()
@@ -644,6 +1110,8 @@ void MainWindow::writeSettings()
     settings.setValue("windowState", saveState());
     settings.setValue("fontSize", currentFontSize);
     settings.setValue("theme", currentTheme);
+    settings.setValue("searchIndex", searchIndexAction->isChecked());
+    settings.setValue("searchIndexMemoryLimitMB", searchIndexMemoryLimit / (1024 * 1024));
 }
 
 void MainWindow::loadRecentFiles()
@@ -661,7 +1129,7 @@ void MainWindow::loadRecentFiles()
 bool MainWindow::maybeSave()
 {
     Editor *editor = currentEditor();
-    if (!editor || !editor->isModified())
+    if (!editor || !editor->isModified() || editor->isLoading())
     {
         return true;
     }
@@ -674,8 +1142,7 @@ bool MainWindow::maybeSave()
 
     if (reply == QMessageBox::Save)
     {
-        saveFile();
-        return !editor->isModified();
+        return saveEditor(editor, true) && !editor->isModified();
     }
     return reply == QMessageBox::Discard;
 }
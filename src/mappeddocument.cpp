@@ -0,0 +1,253 @@
+#include "mappeddocument.h"
+
+#include <QtGlobal>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedDocument::MappedDocument(const QString &fileName)
+    : file(fileName), data(nullptr), fileSize(0), lineStartsFound(1), indexedBytes(0)
+{
+    checkpoints.append(0);
+}
+
+MappedDocument::~MappedDocument()
+{
+    close();
+}
+
+bool MappedDocument::open()
+{
+    close();
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    fileSize = file.size();
+    if (fileSize == 0)
+    {
+        return true;
+    }
+
+    data = file.map(0, fileSize);
+    if (!data)
+    {
+        file.close();
+        fileSize = 0;
+        return false;
+    }
+
+#ifdef Q_OS_UNIX
+    // Lines are read front to back by the indexer; hint the kernel
+    madvise(const_cast<uchar *>(data), static_cast<size_t>(fileSize), MADV_SEQUENTIAL);
+#endif
+
+    return true;
+}
+
+void MappedDocument::close()
+{
+    if (data)
+    {
+        file.unmap(const_cast<uchar *>(data));
+        data = nullptr;
+    }
+    if (file.isOpen())
+    {
+        file.close();
+    }
+
+    fileSize = 0;
+    checkpoints.clear();
+    checkpoints.append(0);
+    lineStartsFound = 1;
+    indexedBytes = 0;
+}
+
+qint64 MappedDocument::estimatedLineCount() const
+{
+    if (isFullyIndexed() || indexedBytes == 0)
+    {
+        return lineStartsFound;
+    }
+
+    // Extrapolate from the average line length seen so far
+    double linesPerByte = double(lineStartsFound) / double(indexedBytes);
+    return qMax(lineStartsFound, qint64(linesPerByte * double(fileSize)));
+}
+
+bool MappedDocument::indexMore(qint64 maxBytes)
+{
+    if (isFullyIndexed())
+        return false;
+
+    qint64 scanStart = indexedBytes;
+    qint64 end = qMin(fileSize, indexedBytes + maxBytes);
+    const uchar *cursor = data + indexedBytes;
+    const uchar *limit = data + end;
+
+    // memchr is vectorized by the C library, so this runs at memory bandwidth
+    while (cursor < limit)
+    {
+        const void *hit = std::memchr(cursor, '\n', static_cast<size_t>(limit - cursor));
+        if (!hit)
+            break;
+
+        cursor = static_cast<const uchar *>(hit) + 1;
+        if (lineStartsFound % CheckpointInterval == 0)
+        {
+            checkpoints.append(cursor - data);
+        }
+        ++lineStartsFound;
+    }
+
+    indexedBytes = end;
+    releaseScannedPages(scanStart, end);
+    return !isFullyIndexed();
+}
+
+bool MappedDocument::refreshSize()
+{
+    // Growth is ignored: the mapping only covers the size seen at open
+    qint64 size = file.size();
+    if (!data || size >= fileSize)
+        return false;
+
+    // Drop the index past the new end back to the last checkpoint before
+    // it; indexMore() rescans the rest
+    fileSize = qMax<qint64>(0, size);
+    if (indexedBytes > fileSize)
+    {
+        int keep = int(std::upper_bound(checkpoints.begin(), checkpoints.end(), fileSize) - checkpoints.begin());
+        checkpoints.resize(keep);
+        lineStartsFound = qint64(keep - 1) * CheckpointInterval + 1;
+        indexedBytes = checkpoints.last();
+    }
+    return true;
+}
+
+qint64 MappedDocument::lineOffset(qint64 line) const
+{
+    if (line <= 0 || !data)
+        return 0;
+    if (!isLineIndexed(line))
+        return -1;
+
+    // Walk forward from the nearest checkpoint
+    qint64 offset = checkpoints[line / CheckpointInterval];
+    for (qint64 remaining = line % CheckpointInterval; remaining > 0; --remaining)
+    {
+        const void *hit = std::memchr(data + offset, '\n', static_cast<size_t>(fileSize - offset));
+        offset = static_cast<const uchar *>(hit) - data + 1;
+    }
+    return offset;
+}
+
+QString MappedDocument::lineText(qint64 line, int maxLength) const
+{
+    qint64 start = lineOffset(line);
+    if (start < 0)
+        return QString();
+
+    QString text;
+    readLine(start, text, maxLength);
+    return text;
+}
+
+qint64 MappedDocument::approximateOffset(qint64 line) const
+{
+    if (isLineIndexed(line))
+        return lineOffset(line);
+
+    // Spread the lines not indexed yet evenly over the bytes left
+    qint64 remainingLines = estimatedLineCount() - lineStartsFound;
+    if (remainingLines <= 0)
+        return fileSize;
+
+    double fraction = double(line - lineStartsFound) / double(remainingLines);
+    qint64 offset = indexedBytes + qint64(fraction * double(fileSize - indexedBytes));
+    return qBound(indexedBytes, offset, fileSize);
+}
+
+qint64 MappedDocument::nextLineStart(qint64 offset) const
+{
+    if (offset <= 0 || !data)
+        return 0;
+    if (offset >= fileSize || startsLine(offset))
+        return qMin(offset, fileSize);
+
+    // A line longer than the decode window is entered at the window's end
+    qint64 scanLength = qMin<qint64>(fileSize - offset, qint64(MaxDecodedLineLength) * 4);
+    const void *hit = std::memchr(data + offset, '\n', static_cast<size_t>(scanLength));
+    return hit ? static_cast<const uchar *>(hit) - data + 1 : offset + scanLength;
+}
+
+qint64 MappedDocument::lineStartBefore(qint64 offset, int lines) const
+{
+    if (!data)
+        return 0;
+
+    // The line feed just before the offset ends the last of the lines
+    offset = qMin(offset, fileSize);
+    qint64 limit = qMax<qint64>(0, offset - qint64(lines) * MaxDecodedLineLength * 4);
+    qint64 position = (offset > 0 && data[offset - 1] == '\n') ? offset - 1 : offset;
+    while (position > limit)
+    {
+        if (data[position - 1] == '\n' && --lines == 0)
+            return position;
+        --position;
+    }
+    return nextLineStart(limit);
+}
+
+qint64 MappedDocument::readLine(qint64 offset, QString &text, int maxLength) const
+{
+    text.clear();
+    if (!data || offset < 0 || offset >= fileSize)
+        return fileSize;
+
+    qint64 scanLength = qMin<qint64>(fileSize - offset, qint64(maxLength) * 4);
+    const void *hit = std::memchr(data + offset, '\n', static_cast<size_t>(scanLength));
+    qint64 length = hit ? static_cast<const uchar *>(hit) - (data + offset) : scanLength;
+    qint64 next = hit ? offset + length + 1 : offset + scanLength;
+    if (hit && length > 0 && data[offset + length - 1] == '\r')
+    {
+        --length;
+    }
+
+    text = QString::fromUtf8(reinterpret_cast<const char *>(data + offset), length);
+    if (text.size() > maxLength)
+    {
+        text.truncate(maxLength);
+    }
+    return next;
+}
+
+qint64 MappedDocument::memoryUsage() const
+{
+    return qint64(checkpoints.capacity()) * qint64(sizeof(qint64));
+}
+
+void MappedDocument::releaseScannedPages(qint64 from, qint64 to) const
+{
+#ifdef Q_OS_UNIX
+    // Drop the clean file pages the indexer touched so that scanning a huge
+    // file does not leave it all resident
+    const qint64 pageSize = sysconf(_SC_PAGESIZE);
+    qint64 first = (from / pageSize) * pageSize;
+    qint64 last = (to / pageSize) * pageSize;
+    if (last > first)
+    {
+        madvise(const_cast<uchar *>(data) + first, static_cast<size_t>(last - first), MADV_DONTNEED);
+    }
+#else
+    Q_UNUSED(from);
+    Q_UNUSED(to);
+#endif
+}
@@ -0,0 +1,71 @@
+#include "patterncache.h"
+
+#include <QMutexLocker>
+
+PatternCache::PatternCache()
+    : patterns(DefaultCapacity), hitCount(0), missCount(0)
+{
+}
+
+PatternCache &PatternCache::instance()
+{
+    static PatternCache cache;
+    return cache;
+}
+
+QRegularExpression PatternCache::pattern(const QString &pattern, QRegularExpression::PatternOptions options)
+{
+    Key key(pattern, int(options));
+
+    QMutexLocker locker(&mutex);
+    if (QRegularExpression *cached = patterns.object(key))
+    {
+        ++hitCount;
+        return *cached;
+    }
+    ++missCount;
+
+    // Compile and JIT now, once, instead of on the first match of every copy
+    QRegularExpression *compiled = new QRegularExpression(pattern, options);
+    compiled->optimize();
+    QRegularExpression result = *compiled;
+    patterns.insert(key, compiled);
+    return result;
+}
+
+void PatternCache::setCapacity(int count)
+{
+    QMutexLocker locker(&mutex);
+    patterns.setMaxCost(qMax(1, count));
+}
+
+int PatternCache::capacity() const
+{
+    QMutexLocker locker(&mutex);
+    return int(patterns.maxCost());
+}
+
+void PatternCache::clear()
+{
+    QMutexLocker locker(&mutex);
+    patterns.clear();
+}
+
+qint64 PatternCache::hits() const
+{
+    QMutexLocker locker(&mutex);
+    return hitCount;
+}
+
+qint64 PatternCache::misses() const
+{
+    QMutexLocker locker(&mutex);
+    return missCount;
+}
+
+void PatternCache::resetStatistics()
+{
+    QMutexLocker locker(&mutex);
+    hitCount = 0;
+    missCount = 0;
+}
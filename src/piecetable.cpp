@@ -0,0 +1,440 @@
+#include "piecetable.h"
+
+#include <algorithm>
+
+PieceTable::PieceTable()
+    : root(-1), seed(0x9E3779B9u)
+{
+}
+
+PieceTable::PieceTable(const QString &original)
+    : PieceTable()
+{
+    setOriginal(original);
+}
+
+void PieceTable::setOriginal(const QString &text)
+{
+    clear();
+    originalBuffer = text;
+
+    // Index every line feed of the original buffer once, up front
+    qsizetype index = originalBuffer.indexOf(QLatin1Char('\n'));
+    while (index != -1)
+    {
+        originalLineFeeds.append(index);
+        index = originalBuffer.indexOf(QLatin1Char('\n'), index + 1);
+    }
+
+    if (!originalBuffer.isEmpty())
+    {
+        root = newNode(Original, 0, originalBuffer.size());
+    }
+}
+
+void PieceTable::clear()
+{
+    originalBuffer.clear();
+    addedBuffer.clear();
+    originalLineFeeds.clear();
+    addedLineFeeds.clear();
+    nodes.clear();
+    freeNodes.clear();
+    root = -1;
+}
+
+void PieceTable::insert(qsizetype position, QStringView text)
+{
+    if (text.isEmpty())
+        return;
+
+    position = qBound<qsizetype>(0, position, length());
+
+    qsizetype start = addedBuffer.size();
+    qsizetype feedsBefore = addedLineFeeds.size();
+    addedBuffer.append(text);
+    for (qsizetype i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == QLatin1Char('\n'))
+        {
+            addedLineFeeds.append(start + i);
+        }
+    }
+    qsizetype lineFeeds = addedLineFeeds.size() - feedsBefore;
+
+    int left, right;
+    split(root, position, left, right);
+
+    // Consecutive typing extends the previous piece instead of adding a new one
+    if (!extendLastPiece(left, Added, start, text.size(), lineFeeds))
+    {
+        left = merge(left, newNode(Added, start, text.size()));
+    }
+    root = merge(left, right);
+}
+
+void PieceTable::appendOriginal(QStringView text)
+{
+    QVector<qsizetype> lineFeeds;
+    qsizetype index = text.indexOf(QLatin1Char('\n'));
+    while (index != -1)
+    {
+        lineFeeds.append(index);
+        index = text.indexOf(QLatin1Char('\n'), index + 1);
+    }
+    appendOriginal(text, lineFeeds);
+}
+
+void PieceTable::appendOriginal(QStringView text, const QVector<qsizetype> &lineFeeds)
+{
+    if (text.isEmpty())
+        return;
+
+    // Used while a file streams in: the original buffer grows at the end
+    // and the trailing original piece simply gets longer. The line feed
+    // offsets are relative to text and come from the loader's scan.
+    qsizetype start = originalBuffer.size();
+    originalBuffer.append(text);
+    originalLineFeeds.reserve(originalLineFeeds.size() + lineFeeds.size());
+    for (qsizetype offset : lineFeeds)
+    {
+        originalLineFeeds.append(start + offset);
+    }
+
+    if (!extendLastPiece(root, Original, start, text.size(), lineFeeds.size()))
+    {
+        root = merge(root, newNode(Original, start, text.size()));
+    }
+}
+
+void PieceTable::remove(qsizetype position, qsizetype length)
+{
+    position = qBound<qsizetype>(0, position, this->length());
+    length = qMin(length, this->length() - position);
+    if (length <= 0)
+        return;
+
+    int left, middle, right;
+    split(root, position, left, middle);
+    split(middle, length, middle, right);
+    freeSubtree(middle);
+    root = merge(left, right);
+}
+
+qsizetype PieceTable::lineStart(qsizetype line) const
+{
+    if (line <= 0)
+        return 0;
+    if (line >= lineCount())
+        return length();
+
+    // Find the line-th line feed and return the offset just after it
+    qsizetype remaining = line;
+    qsizetype offset = 0;
+    int node = root;
+    while (node >= 0)
+    {
+        const Node &n = nodes[node];
+        qsizetype leftLineFeeds = subtreeLineFeeds(n.left);
+        if (remaining <= leftLineFeeds)
+        {
+            node = n.left;
+            continue;
+        }
+
+        remaining -= leftLineFeeds;
+        offset += subtreeLength(n.left);
+        if (remaining <= n.lineFeeds)
+        {
+            const QVector<qsizetype> &feeds = bufferLineFeeds(n.buffer);
+            auto first = std::lower_bound(feeds.begin(), feeds.end(), n.start);
+            return offset + (*(first + (remaining - 1)) - n.start) + 1;
+        }
+
+        remaining -= n.lineFeeds;
+        offset += n.length;
+        node = n.right;
+    }
+    return length();
+}
+
+qsizetype PieceTable::lineAt(qsizetype position) const
+{
+    position = qBound<qsizetype>(0, position, length());
+
+    qsizetype line = 0;
+    int node = root;
+    while (node >= 0)
+    {
+        const Node &n = nodes[node];
+        qsizetype leftLength = subtreeLength(n.left);
+        if (position < leftLength)
+        {
+            node = n.left;
+            continue;
+        }
+
+        line += subtreeLineFeeds(n.left);
+        position -= leftLength;
+        if (position <= n.length)
+        {
+            return line + countLineFeeds(n.buffer, n.start, n.start + position);
+        }
+
+        line += n.lineFeeds;
+        position -= n.length;
+        node = n.right;
+    }
+    return line;
+}
+
+QChar PieceTable::at(qsizetype position) const
+{
+    int node = root;
+    while (node >= 0)
+    {
+        const Node &n = nodes[node];
+        qsizetype leftLength = subtreeLength(n.left);
+        if (position < leftLength)
+        {
+            node = n.left;
+            continue;
+        }
+
+        position -= leftLength;
+        if (position < n.length)
+        {
+            return bufferText(n.buffer).at(n.start + position);
+        }
+
+        position -= n.length;
+        node = n.right;
+    }
+    return QChar();
+}
+
+QString PieceTable::text(qsizetype position, qsizetype length) const
+{
+    position = qBound<qsizetype>(0, position, this->length());
+    length = qBound<qsizetype>(0, length, this->length() - position);
+
+    QString result;
+    result.reserve(length);
+    forEachChunk(position, length, [&result](QStringView chunk)
+                 { result.append(chunk); });
+    return result;
+}
+
+QString PieceTable::lineText(qsizetype line) const
+{
+    if (line < 0 || line >= lineCount())
+        return QString();
+
+    qsizetype start = lineStart(line);
+    qsizetype end = (line + 1 < lineCount()) ? lineStart(line + 1) - 1 : length();
+    return text(start, end - start);
+}
+
+PieceTable::Snapshot PieceTable::snapshot() const
+{
+    Snapshot result;
+    result.originalBuffer = originalBuffer;
+    result.addedBuffer = addedBuffer;
+    result.totalLength = length();
+    result.spans.reserve(pieceCount());
+    collectSpans(root, result.spans);
+    return result;
+}
+
+QString PieceTable::Snapshot::toString() const
+{
+    // An unedited document is one span covering the original buffer; share it
+    if (spans.size() == 1 && !spans[0].added && spans[0].start == 0 && spans[0].length == originalBuffer.size())
+        return originalBuffer;
+
+    QString result;
+    result.reserve(totalLength);
+    forEachChunk([&result](QStringView chunk)
+                 { result.append(chunk); });
+    return result;
+}
+
+qint64 PieceTable::memoryUsage() const
+{
+    return qint64(originalBuffer.capacity() + addedBuffer.capacity()) * qint64(sizeof(QChar)) +
+           qint64(originalLineFeeds.capacity() + addedLineFeeds.capacity()) * qint64(sizeof(qsizetype)) +
+           qint64(nodes.capacity()) * qint64(sizeof(Node));
+}
+
+int PieceTable::newNode(BufferKind buffer, qsizetype start, qsizetype length)
+{
+    Node node;
+    node.buffer = buffer;
+    node.start = start;
+    node.length = length;
+    node.lineFeeds = countLineFeeds(buffer, start, start + length);
+    node.subtreeLength = length;
+    node.subtreeLineFeeds = node.lineFeeds;
+    node.priority = nextPriority();
+    node.left = -1;
+    node.right = -1;
+
+    if (!freeNodes.isEmpty())
+    {
+        int index = freeNodes.takeLast();
+        nodes[index] = node;
+        return index;
+    }
+
+    nodes.push_back(node);
+    return static_cast<int>(nodes.size()) - 1;
+}
+
+void PieceTable::freeSubtree(int node)
+{
+    QVector<int> pending;
+    if (node >= 0)
+        pending.append(node);
+
+    while (!pending.isEmpty())
+    {
+        int current = pending.takeLast();
+        if (nodes[current].left >= 0)
+            pending.append(nodes[current].left);
+        if (nodes[current].right >= 0)
+            pending.append(nodes[current].right);
+        freeNodes.append(current);
+    }
+}
+
+void PieceTable::update(int node)
+{
+    Node &n = nodes[node];
+    n.subtreeLength = subtreeLength(n.left) + n.length + subtreeLength(n.right);
+    n.subtreeLineFeeds = subtreeLineFeeds(n.left) + n.lineFeeds + subtreeLineFeeds(n.right);
+}
+
+void PieceTable::split(int node, qsizetype position, int &left, int &right)
+{
+    if (node < 0)
+    {
+        left = right = -1;
+        return;
+    }
+
+    qsizetype leftLength = subtreeLength(nodes[node].left);
+    qsizetype pieceLength = nodes[node].length;
+
+    if (position <= leftLength)
+    {
+        int l, r;
+        split(nodes[node].left, position, l, r);
+        nodes[node].left = r;
+        update(node);
+        left = l;
+        right = node;
+    }
+    else if (position >= leftLength + pieceLength)
+    {
+        int l, r;
+        split(nodes[node].right, position - leftLength - pieceLength, l, r);
+        nodes[node].right = l;
+        update(node);
+        left = node;
+        right = r;
+    }
+    else
+    {
+        // The split point falls inside this piece: cut it in two
+        qsizetype offset = position - leftLength;
+        BufferKind buffer = nodes[node].buffer;
+        qsizetype start = nodes[node].start;
+        int tail = newNode(buffer, start + offset, pieceLength - offset);
+
+        // The tail takes this node's place above the old right subtree, so
+        // it keeps its priority to preserve the heap order
+        nodes[tail].priority = nodes[node].priority;
+
+        Node &head = nodes[node];
+        head.length = offset;
+        head.lineFeeds -= nodes[tail].lineFeeds;
+        int oldRight = head.right;
+        head.right = -1;
+        update(node);
+
+        left = node;
+        right = merge(tail, oldRight);
+    }
+}
+
+int PieceTable::merge(int left, int right)
+{
+    if (left < 0)
+        return right;
+    if (right < 0)
+        return left;
+
+    if (nodes[left].priority > nodes[right].priority)
+    {
+        int merged = merge(nodes[left].right, right);
+        nodes[left].right = merged;
+        update(left);
+        return left;
+    }
+
+    int merged = merge(left, nodes[right].left);
+    nodes[right].left = merged;
+    update(right);
+    return right;
+}
+
+void PieceTable::collectSpans(int node, QVector<Snapshot::Span> &spans) const
+{
+    if (node < 0)
+        return;
+
+    const Node &n = nodes[node];
+    collectSpans(n.left, spans);
+    spans.append({n.start, n.length, n.buffer == Added});
+    collectSpans(n.right, spans);
+}
+
+bool PieceTable::extendLastPiece(int node, BufferKind buffer, qsizetype start, qsizetype length, qsizetype lineFeeds)
+{
+    if (node < 0)
+        return false;
+
+    Node &n = nodes[node];
+    bool extended = false;
+    if (n.right >= 0)
+    {
+        extended = extendLastPiece(n.right, buffer, start, length, lineFeeds);
+    }
+    else if (n.buffer == buffer && n.start + n.length == start)
+    {
+        n.length += length;
+        n.lineFeeds += lineFeeds;
+        extended = true;
+    }
+
+    if (extended)
+        update(node);
+    return extended;
+}
+
+qsizetype PieceTable::countLineFeeds(BufferKind buffer, qsizetype start, qsizetype end) const
+{
+    const QVector<qsizetype> &feeds = bufferLineFeeds(buffer);
+    auto first = std::lower_bound(feeds.begin(), feeds.end(), start);
+    auto last = std::lower_bound(first, feeds.end(), end);
+    return last - first;
+}
+
+quint32 PieceTable::nextPriority()
+{
+    // xorshift32: cheap, deterministic priorities keep the treap balanced
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
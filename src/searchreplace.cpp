@@ -1,5 +1,10 @@
 #include "searchreplace.h"
 #include "editor.h"
+#include "piecetable.h"
+#include "literalsearcher.h"
+#include "searchworker.h"
+#include "patterncache.h"
+#include "trigramindex.h"
 
 #include <QLineEdit>
 #include <QCheckBox>
@@ -12,13 +17,25 @@
 #include <QTextDocument>
 #include <QDebug>
 #include <QCloseEvent>
+#include <QTimer>
+#include <algorithm>
 
 SearchReplace::SearchReplace(QObject *parent)
-    : QObject(parent), currentEditor(nullptr), searchOptions({}), totalMatches(0), currentMatchIndex(0)
+    : QObject(parent), currentEditor(nullptr), searchOptions({}), totalMatches(0), currentMatchIndex(0), searchGeneration(0), cachedOptions({}), cachedLineCount(0), searchComplete(false), replacingAll(false), pendingMove(NoMove), pendingPosition(0)
 {
+    // A cancelled scan may still be winding down while its successor starts
+    searchPool.setMaxThreadCount(2);
 }
 
-SearchReplace::~SearchReplace() = default;
+SearchReplace::~SearchReplace()
+{
+    if (highlightEditor)
+    {
+        highlightEditor->clearHighlights();
+    }
+    cancelSearch();
+    searchPool.waitForDone();
+}
 
 bool SearchReplace::find(Editor *editor, const QString &searchText, SearchOptions options)
 {
@@ -31,142 +48,553 @@ bool SearchReplace::find(Editor *editor, const QString &searchText, SearchOption
     currentEditor = editor;
     searchOptions = options;
     lastSearchText = searchText;
-    totalMatches = 0;
 
-    // Get all matches first
-    QVector<SearchResult> results = findAll(editor, searchText, options);
-    if (results.isEmpty())
+    // The first match is reported as soon as the scan reaches it
+    startSearch(editor);
+    highlightMatches(editor, searchText);
+    requestMove(editor, FirstMatch);
+    return true;
+}
+
+bool SearchReplace::findNext(Editor *editor)
+{
+    if (!editor || lastSearchText.isEmpty())
     {
-        emit noMatchFound();
         return false;
     }
 
-    totalMatches = results.size();
-    if (!results.isEmpty())
+    currentEditor = editor;
+    requestMove(editor, NextMatch);
+    return true;
+}
+
+bool SearchReplace::findPrevious(Editor *editor)
+{
+    if (!editor || lastSearchText.isEmpty())
     {
-        currentResult = results.first();
-        emit matchFound(currentResult);
-        emit matchesUpdated(totalMatches);
-        return true;
+        return false;
     }
 
-    return false;
+    currentEditor = editor;
+    requestMove(editor, PreviousMatch);
+    return true;
 }
 
-bool SearchReplace::findNext(Editor *editor)
+bool SearchReplace::findIncremental(Editor *editor, const QString &searchText, SearchOptions options)
 {
-    if (!editor || lastSearchText.isEmpty())
+    if (!canRefine(editor, searchText, options))
     {
-        return false;
+        return find(editor, searchText, options);
     }
 
+    refineMatches(searchText);
     currentEditor = editor;
-    QVector<SearchResult> results = findAll(editor, lastSearchText, searchOptions);
+    searchOptions = options;
+    lastSearchText = searchText;
+    highlightMatches(editor, searchText);
+    requestMove(editor, FirstMatch);
+    return true;
+}
 
-    if (results.isEmpty())
+bool SearchReplace::canRefine(Editor *editor, const QString &searchText, SearchOptions options) const
+{
+    // Whole words and regexes do not narrow as the query grows
+    if (!editor || editor != searchEditor || !searchComplete || options != cachedOptions ||
+        (options & (UseRegex | WholeWord)) || cachedSearchText.isEmpty() || searchText.size() <= cachedSearchText.size())
     {
-        emit noMatchFound();
         return false;
     }
 
-    // Find next match after current position
-    int currentPos = editor->textCursor().position();
-    for (const SearchResult &result : results)
+    Qt::CaseSensitivity caseSensitivity = (options & CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    if (!searchText.startsWith(cachedSearchText, caseSensitivity))
+        return false;
+
+    // The scan skips occurrences overlapping the previous match, so the
+    // cache holds every occurrence only if the old query cannot overlap itself
+    QStringView cached(cachedSearchText);
+    for (qsizetype border = 1; border < cached.size(); ++border)
+    {
+        if (cached.left(border).compare(cached.right(border), caseSensitivity) == 0)
+            return false;
+    }
+    return true;
+}
+
+void SearchReplace::refineMatches(const QString &searchText)
+{
+    // Every match of the longer query starts where the cached one matched
+    const PieceTable *table = searchEditor->getPieceTable();
+    Qt::CaseSensitivity caseSensitivity = (cachedOptions & CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    QVector<SearchResult> refined;
+    int previousEnd = 0;
+    for (const SearchResult &match : std::as_const(matches))
     {
-        if (result.startPosition > currentPos)
+        if (match.startPosition < previousEnd)
+            continue;
+
+        QString candidate = table->text(match.startPosition, searchText.size());
+        if (candidate.compare(searchText, caseSensitivity) == 0)
         {
-            currentResult = result;
-            emit matchFound(result);
-            return true;
+            SearchResult result = match;
+            result.endPosition = result.startPosition + int(searchText.size());
+            refined.append(result);
+            previousEnd = result.endPosition;
         }
     }
 
-    // Wrap around to first match
-    if (!results.isEmpty())
+    ++searchGeneration;
+    matches = refined;
+    cachedSearchText = searchText;
+    totalMatches = matches.size();
+    emit matchesUpdated(totalMatches);
+}
+
+void SearchReplace::startSearch(Editor *editor)
+{
+    cancelSearch();
+
+    if (searchEditor != editor)
     {
-        currentResult = results.first();
-        emit matchFound(currentResult);
-        return true;
+        if (searchEditor)
+        {
+            disconnect(searchEditor.data(), nullptr, this, nullptr);
+        }
+        searchEditor = editor;
+        connect(editor, &Editor::textEdited, this, &SearchReplace::onDocumentEdited);
+        connect(editor, &Editor::textReset, this, &SearchReplace::onDocumentReset);
     }
 
-    return false;
+    matches.clear();
+    searchComplete = false;
+    totalMatches = 0;
+    cachedSearchText = lastSearchText;
+    cachedOptions = searchOptions;
+    cachedLineCount = editor->getPieceTable()->lineCount();
+
+    // The worker builds and queries the index itself, from the snapshot
+    SearchWorker *worker = new SearchWorker(editor->getPieceTable()->snapshot(), lastSearchText, searchOptions, ++searchGeneration);
+    worker->setSearchIndex(editor->getSearchIndex());
+    connect(worker, &SearchWorker::resultsReady, this, &SearchReplace::onResultsReady);
+    connect(worker, &SearchWorker::finished, this, &SearchReplace::onSearchFinished);
+    connect(worker, &SearchWorker::indexBuilt, this, &SearchReplace::onIndexBuilt);
+    activeSearch = worker;
+
+    // The worker stays owned by this thread; its signals are queued back here
+    searchPool.start([worker]()
+                     {
+        worker->run();
+        worker->deleteLater(); });
 }
 
-bool SearchReplace::findPrevious(Editor *editor)
+void SearchReplace::cancelSearch()
 {
-    if (!editor || lastSearchText.isEmpty())
+    if (activeSearch)
     {
-        return false;
+        activeSearch->cancel();
     }
+    activeSearch = nullptr;
+}
 
-    currentEditor = editor;
-    QVector<SearchResult> results = findAll(editor, lastSearchText, searchOptions);
+void SearchReplace::requestMove(Editor *editor, PendingMove move)
+{
+    // Scan again unless the current results belong to this editor and query
+    bool cached = editor == searchEditor && cachedSearchText == lastSearchText && cachedOptions == searchOptions;
+    if (!cached || (!activeSearch && !searchComplete))
+    {
+        startSearch(editor);
+    }
 
-    if (results.isEmpty())
+    pendingMove = move;
+    pendingPosition = editor->textCursor().position();
+    resolvePendingMove();
+
+    // The scan has not got that far yet; look near the cursor directly
+    if ((pendingMove == NextMatch || pendingMove == PreviousMatch) && scanFromCursor(editor, pendingMove))
     {
-        emit noMatchFound();
-        return false;
+        pendingMove = NoMove;
+    }
+}
+
+void SearchReplace::onResultsReady(int generation, const QVector<SearchResult> &results)
+{
+    if (generation != searchGeneration)
+        return;
+
+    matches += results;
+    totalMatches = matches.size();
+    emit matchesUpdated(totalMatches);
+    resolvePendingMove();
+}
+
+void SearchReplace::onSearchFinished(int generation, int total)
+{
+    if (generation != searchGeneration)
+        return;
+
+    activeSearch = nullptr;
+    searchComplete = true;
+    totalMatches = total;
+    emit matchesUpdated(totalMatches);
+    resolvePendingMove();
+
+}
+
+void SearchReplace::onIndexBuilt(int generation, const std::shared_ptr<TrigramIndex> &index)
+{
+    // Built from the snapshot of this search, so it matches the text only
+    // if no edit has started another one since
+    if (generation != searchGeneration || !searchEditor)
+        return;
+
+    searchEditor->adoptSearchIndex(index);
+}
+
+void SearchReplace::onDocumentEdited(int position, int charsRemoved, const QString &insertedText)
+{
+    // replaceAll() brings the cache up to date once it is done
+    if (!searchEditor || cachedSearchText.isEmpty() || replacingAll)
+        return;
+
+    // A running scan works from a snapshot that no longer matches the text
+    if (activeSearch)
+    {
+        startSearch(searchEditor);
+        return;
+    }
+    if (!searchComplete)
+        return;
+
+    // Rescan the whole lines touched by the edit and shift the matches after
+    // them; windowEnd - delta is where the window ended before the edit
+    const PieceTable *table = searchEditor->getPieceTable();
+    qsizetype delta = insertedText.size() - charsRemoved;
+    qsizetype windowStart = table->lineStart(table->lineAt(position));
+    qsizetype endLine = table->lineAt(position + insertedText.size());
+    qsizetype windowEnd = endLine + 1 < table->lineCount() ? table->lineStart(endLine + 1) : table->length();
+    qsizetype oldWindowEnd = windowEnd - delta;
+    int lineDelta = int(table->lineCount() - cachedLineCount);
+
+    auto first = std::lower_bound(matches.cbegin(), matches.cend(), windowStart, [](const SearchResult &result, qsizetype start)
+                                  { return result.endPosition <= start; });
+    auto last = std::lower_bound(first, matches.cend(), oldWindowEnd, [](const SearchResult &result, qsizetype end)
+                                 { return result.startPosition < end; });
+    qsizetype firstIndex = first - matches.cbegin();
+    qsizetype lastIndex = last - matches.cbegin();
+
+    // Only the window is replaced; the matches after it shift in place
+    QVector<SearchResult> window = searchRange(searchEditor, windowStart, windowEnd);
+    qsizetype replaced = lastIndex - firstIndex;
+    if (window.size() > replaced)
+    {
+        matches.insert(lastIndex, window.size() - replaced, SearchResult());
+    }
+    else if (window.size() < replaced)
+    {
+        matches.remove(firstIndex + window.size(), replaced - window.size());
     }
+    std::move(window.begin(), window.end(), matches.begin() + firstIndex);
 
-    // Find previous match before current position
-    int currentPos = editor->textCursor().position();
-    for (int i = results.size() - 1; i >= 0; --i)
+    if (delta != 0 || lineDelta != 0)
     {
-        if (results[i].startPosition < currentPos)
+        for (auto it = matches.begin() + firstIndex + window.size(); it != matches.end(); ++it)
         {
-            currentResult = results[i];
-            emit matchFound(currentResult);
-            return true;
+            it->startPosition += int(delta);
+            it->endPosition += int(delta);
+            it->lineNumber += lineDelta;
         }
     }
+    cachedLineCount = table->lineCount();
 
-    // Wrap around to last match
-    if (!results.isEmpty())
+    totalMatches = matches.size();
+    emit matchesUpdated(totalMatches);
+}
+
+void SearchReplace::onDocumentReset()
+{
+    if (searchEditor && !cachedSearchText.isEmpty() && (activeSearch || searchComplete))
     {
-        currentResult = results.last();
-        emit matchFound(currentResult);
-        return true;
+        startSearch(searchEditor);
+    }
+}
+
+void SearchReplace::resolvePendingMove()
+{
+    auto startsBefore = [](const SearchResult &result, int position)
+    { return result.startPosition < position; };
+
+    switch (pendingMove)
+    {
+    case NoMove:
+        return;
+
+    case FirstMatch:
+        if (!matches.isEmpty())
+        {
+            selectResult(matches.first());
+        }
+        else if (!searchComplete)
+        {
+            return;
+        }
+        else
+        {
+            emit noMatchFound();
+        }
+        break;
+
+    case NextMatch:
+    {
+        // Matches arrive in order, so any match found after the cursor is final
+        auto next = std::lower_bound(matches.cbegin(), matches.cend(), pendingPosition + 1, startsBefore);
+        if (next != matches.cend())
+        {
+            selectResult(*next);
+        }
+        else if (!searchComplete)
+        {
+            return;
+        }
+        else if (!matches.isEmpty())
+        {
+            // Wrap around to first match
+            selectResult(matches.first());
+        }
+        else
+        {
+            emit noMatchFound();
+        }
+        break;
+    }
+
+    case PreviousMatch:
+    {
+        // The last match before the cursor is known once the scan has passed it
+        auto next = std::lower_bound(matches.cbegin(), matches.cend(), pendingPosition, startsBefore);
+        if (next != matches.cbegin() && (next != matches.cend() || searchComplete))
+        {
+            selectResult(*(next - 1));
+        }
+        else if (!searchComplete)
+        {
+            return;
+        }
+        else if (!matches.isEmpty())
+        {
+            // Wrap around to last match
+            selectResult(matches.last());
+        }
+        else
+        {
+            emit noMatchFound();
+        }
+        break;
+    }
+    }
+
+    pendingMove = NoMove;
+}
+
+bool SearchReplace::scanFromCursor(Editor *editor, PendingMove move)
+{
+    // Search whole lines within DirectScanWindow of the cursor; further away
+    // is left to the background scan
+    const PieceTable *table = editor->getPieceTable();
+    qsizetype position = pendingPosition;
+    auto lineEnd = [table](qsizetype offset)
+    {
+        qsizetype line = table->lineAt(offset);
+        return line + 1 < table->lineCount() ? table->lineStart(line + 1) : table->length();
+    };
+
+    if (move == NextMatch)
+    {
+        qsizetype start = table->lineStart(table->lineAt(position));
+        QVector<SearchResult> found = searchRange(editor, start, lineEnd(position + DirectScanWindow));
+        for (const SearchResult &result : found)
+        {
+            if (result.startPosition > position)
+            {
+                selectResult(result);
+                return true;
+            }
+        }
+    }
+    else if (move == PreviousMatch)
+    {
+        qsizetype start = table->lineStart(table->lineAt(qMax<qsizetype>(0, position - DirectScanWindow)));
+        QVector<SearchResult> found = searchRange(editor, start, lineEnd(position));
+        for (int i = found.size() - 1; i >= 0; --i)
+        {
+            if (found[i].startPosition < position)
+            {
+                selectResult(found[i]);
+                return true;
+            }
+        }
     }
 
     return false;
 }
 
-bool SearchReplace::replace(Editor *editor, const QString &searchText, const QString &replaceText, SearchOptions options)
+QVector<SearchResult> SearchReplace::searchRange(Editor *editor, qsizetype start, qsizetype end) const
 {
-    if (!editor || searchText.isEmpty())
+    QVector<SearchResult> results;
+    const PieceTable *table = editor->getPieceTable();
+    QString text = table->text(start, end - start);
+
+    auto append = [&](qsizetype matchStart, qsizetype matchEnd)
+    {
+        qsizetype line = table->lineAt(start + matchStart);
+        SearchResult result;
+        result.lineNumber = int(line);
+        result.columnNumber = int(start + matchStart - table->lineStart(line));
+        result.startPosition = int(start + matchStart);
+        result.endPosition = int(start + matchEnd);
+        results.append(result);
+    };
+
+    Qt::CaseSensitivity caseSensitivity = (cachedOptions & CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    if (cachedOptions & UseRegex)
+    {
+        QRegularExpression regex = compileRegex(cachedSearchText, cachedOptions);
+        QRegularExpressionMatchIterator it = regex.globalMatch(text);
+        while (it.hasNext())
+        {
+            QRegularExpressionMatch match = it.next();
+            append(match.capturedStart(), match.capturedEnd());
+        }
+    }
+    else
     {
+        LiteralSearcher searcher(cachedSearchText, caseSensitivity, cachedOptions.testFlag(WholeWord));
+        for (qsizetype position = searcher.indexIn(text); position >= 0;
+             position = searcher.indexIn(text, position + searcher.length()))
+        {
+            append(position, position + searcher.length());
+        }
+    }
+
+    return results;
+}
+
+bool SearchReplace::findIndexed(Editor *editor, const QString &searchText, SearchOptions options, QVector<SearchResult> &results)
+{
+    // Regexes qualify when every match lies within one line and contains a
+    // literal the index can look up. Only an index a search worker already
+    // built is used; building one is left to the worker.
+    std::shared_ptr<const TrigramIndex> index = editor->getSearchIndex();
+    const PieceTable *table = editor->getPieceTable();
+    if (!index || !index->isBuilt() || index->textLength() != table->length() ||
+        table->length() != editor->document()->characterCount() - 1)
         return false;
+
+    QString literal = (options & UseRegex) ? TrigramIndex::requiredLiteral(searchText) : searchText;
+    QVector<int> lines;
+    if (literal.size() < 3 || literal.contains(QLatin1Char('\n')) || !index->candidateLines(literal, lines))
+        return false;
+
+    // Most lines are candidates: the full scan is cheaper
+    if (lines.size() > index->lineCount() / 2)
+        return false;
+
+    QRegularExpression regex;
+    if (options & UseRegex)
+    {
+        regex = compileRegex(searchText, options);
+        if (!regex.isValid())
+            return false;
     }
+    Qt::CaseSensitivity caseSensitivity = (options & CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    LiteralSearcher searcher(searchText, caseSensitivity, options.testFlag(WholeWord));
 
-    QTextCursor cursor = editor->textCursor();
-    QString documentText = editor->toPlainText();
+    results.clear();
+    for (int line : std::as_const(lines))
+    {
+        qsizetype lineStart = table->lineStart(line);
+        QString text = table->lineText(line);
 
-    QString searchPattern = searchText;
-    if (!(options & UseRegex))
+        auto append = [&](qsizetype matchStart, qsizetype matchEnd)
+        {
+            SearchResult result;
+            result.lineNumber = line;
+            result.columnNumber = int(matchStart);
+            result.matchedText = text.mid(matchStart, matchEnd - matchStart);
+            result.startPosition = int(lineStart + matchStart);
+            result.endPosition = int(lineStart + matchEnd);
+            results.append(result);
+        };
+
+        if (options & UseRegex)
+        {
+            QRegularExpressionMatchIterator it = regex.globalMatch(text);
+            while (it.hasNext())
+            {
+                QRegularExpressionMatch match = it.next();
+                append(match.capturedStart(), match.capturedEnd());
+            }
+        }
+        else
+        {
+            for (qsizetype position = searcher.indexIn(text); position >= 0;
+                 position = searcher.indexIn(text, position + searcher.length()))
+            {
+                append(position, position + searcher.length());
+            }
+        }
+    }
+    return true;
+}
+
+void SearchReplace::selectResult(const SearchResult &result)
+{
+    // Cached matches leave their text out; only the selected one reads it
+    currentResult = result;
+    if (currentResult.matchedText.isEmpty() && currentEditor)
     {
-        searchPattern = escapeRegexSpecialChars(searchText);
+        currentResult.matchedText = currentEditor->getPieceTable()->text(result.startPosition, result.endPosition - result.startPosition);
     }
+    emit matchFound(currentResult);
+}
 
-    Qt::CaseSensitivity caseSensitivity = (options & CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
-    QRegularExpression regex(searchPattern);
-    if (!caseSensitivity)
+bool SearchReplace::replace(Editor *editor, const QString &searchText, const QString &replaceText, SearchOptions options)
+{
+    if (!editor || searchText.isEmpty())
     {
-        regex.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+        return false;
     }
 
-    if (regex.isValid())
+    QTextCursor cursor = editor->textCursor();
+    QString documentText = editor->toPlainText();
+    Qt::CaseSensitivity caseSensitivity = (options & CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+
+    qsizetype matchStart = -1;
+    qsizetype matchEnd = -1;
+    if (options & UseRegex)
     {
-        QRegularExpressionMatch match = regex.match(documentText, cursor.position());
+        QRegularExpression regex = compileRegex(searchText, options);
+        QRegularExpressionMatch match = regex.isValid() ? regex.match(documentText, cursor.position()) : QRegularExpressionMatch();
         if (match.hasMatch())
         {
-            cursor.setPosition(match.capturedStart());
-            cursor.setPosition(match.capturedEnd(), QTextCursor::KeepAnchor);
-            cursor.insertText(replaceText);
-            editor->setTextCursor(cursor);
-            emit replacementMade(1);
-            return true;
+            matchStart = match.capturedStart();
+            matchEnd = match.capturedEnd();
         }
     }
+    else
+    {
+        LiteralSearcher searcher(searchText, caseSensitivity, options.testFlag(WholeWord));
+        matchStart = searcher.indexIn(documentText, cursor.position());
+        matchEnd = matchStart + searcher.length();
+    }
+
+    if (matchStart >= 0)
+    {
+        cursor.setPosition(int(matchStart));
+        cursor.setPosition(int(matchEnd), QTextCursor::KeepAnchor);
+        cursor.insertText(replaceText);
+        editor->setTextCursor(cursor);
+        emit replacementMade(1);
+        return true;
+    }
 
     return false;
 }
@@ -184,15 +612,61 @@ int SearchReplace::replaceAll(Editor *editor, const QString &searchText, const Q
         return 0;
     }
 
+    // Matches on the same or neighbouring lines are merged into spans of
+    // whole lines; each span's new text is built in one pass
+    struct Span
+    {
+        qsizetype start;
+        qsizetype end;
+        QString text;
+    };
+
     QString documentText = editor->toPlainText();
-    QString result = documentText;
+    auto lineEnd = [&documentText](qsizetype position)
+    {
+        qsizetype end = documentText.indexOf(QLatin1Char('\n'), position);
+        return end < 0 ? documentText.size() : end;
+    };
 
-    for (int i = results.size() - 1; i >= 0; --i)
+    QVector<Span> spans;
+    for (int i = 0; i < results.size();)
     {
-        result.replace(results[i].startPosition, results[i].endPosition - results[i].startPosition, replaceText);
+        Span span;
+        span.start = results[i].startPosition - results[i].columnNumber;
+        span.end = lineEnd(results[i].endPosition);
+
+        qsizetype copied = span.start;
+        for (; i < results.size() && results[i].startPosition - results[i].columnNumber <= span.end + 1; ++i)
+        {
+            span.text += QStringView(documentText).mid(copied, results[i].startPosition - copied);
+            span.text += replaceText;
+            copied = results[i].endPosition;
+            span.end = qMax(span.end, lineEnd(copied));
+        }
+        span.text += QStringView(documentText).mid(copied, span.end - copied);
+        spans.append(span);
+    }
+
+    // Applied back to front in one edit block: a single undo step, and the
+    // document only re-lays out the lines it was given. The match cache is
+    // left alone per span and rescanned once at the end.
+    QTextCursor cursor(editor->document());
+    replacingAll = true;
+    cursor.beginEditBlock();
+    for (qsizetype i = spans.size() - 1; i >= 0; --i)
+    {
+        cursor.setPosition(int(spans[i].start));
+        cursor.setPosition(int(spans[i].end), QTextCursor::KeepAnchor);
+        cursor.insertText(spans[i].text);
+    }
+    cursor.endEditBlock();
+    replacingAll = false;
+
+    if (editor == searchEditor && !cachedSearchText.isEmpty() && (activeSearch || searchComplete))
+    {
+        startSearch(editor);
     }
 
-    editor->setPlainText(result);
     emit replacementMade(results.size());
     return results.size();
 }
@@ -206,61 +680,87 @@ QVector<SearchResult> SearchReplace::findAll(Editor *editor, const QString &sear
         return results;
     }
 
-    QString documentText = editor->toPlainText();
-    QString searchPattern = searchText;
-
-    if (!(options & UseRegex))
+    if (findIndexed(editor, searchText, options, results))
     {
-        searchPattern = escapeRegexSpecialChars(searchText);
+        return results;
     }
 
-    if (options & WholeWord)
+    QString documentText = editor->toPlainText();
+    Qt::CaseSensitivity caseSensitivity = (options & CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+
+    if (options & UseRegex)
     {
-        searchPattern = QString("\\b%1\\b").arg(searchPattern);
-    }
+        QRegularExpression regex = compileRegex(searchText, options);
+        if (!regex.isValid())
+        {
+            return results;
+        }
 
-    Qt::CaseSensitivity caseSensitivity = (options & CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
-    QRegularExpression regex(searchPattern);
-    if (!caseSensitivity)
+        QRegularExpressionMatchIterator it = regex.globalMatch(documentText);
+        while (it.hasNext())
+        {
+            QRegularExpressionMatch match = it.next();
+            SearchResult result;
+            result.matchedText = match.captured();
+            result.startPosition = match.capturedStart();
+            result.endPosition = match.capturedEnd();
+            results.append(result);
+        }
+    }
+    else
     {
-        regex.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+        // Plain text skips the regex engine entirely
+        LiteralSearcher searcher(searchText, caseSensitivity, options.testFlag(WholeWord));
+        for (qsizetype position = searcher.indexIn(documentText); position >= 0;
+             position = searcher.indexIn(documentText, position + searcher.length()))
+        {
+            SearchResult result;
+            result.matchedText = documentText.mid(position, searcher.length());
+            result.startPosition = int(position);
+            result.endPosition = int(position + searcher.length());
+            results.append(result);
+        }
     }
 
-    if (!regex.isValid())
+    // The piece table keeps the line feeds of the document indexed, so a
+    // match is located in O(log n); if it is out of step with the text, fall
+    // back to one forward sweep over the matches, which are in order
+    const PieceTable *lineIndex = editor->getPieceTable();
+    if (lineIndex && lineIndex->length() != documentText.size())
     {
-        return results;
+        lineIndex = nullptr;
     }
+    qsizetype sweepPosition = 0;
+    qsizetype sweepLine = 0;
+    qsizetype sweepLineStart = 0;
 
-    QRegularExpressionMatchIterator it = regex.globalMatch(documentText);
-    while (it.hasNext())
+    for (SearchResult &result : results)
     {
-        QRegularExpressionMatch match = it.next();
+        qsizetype start = result.startPosition;
 
         // Calculate line and column numbers
-        int lineNumber = 0;
-        int columnNumber = 0;
-
-        for (int i = 0; i < match.capturedStart(); ++i)
+        qsizetype lineNumber;
+        qsizetype lineStart;
+        if (lineIndex)
         {
-            if (documentText[i] == '\n')
-            {
-                lineNumber++;
-                columnNumber = 0;
-            }
-            else
+            lineNumber = lineIndex->lineAt(start);
+            lineStart = lineIndex->lineStart(lineNumber);
+        }
+        else
+        {
+            qsizetype lineFeeds = QStringView(documentText).mid(sweepPosition, start - sweepPosition).count(QLatin1Char('\n'));
+            if (lineFeeds > 0)
             {
-                columnNumber++;
+                sweepLine += lineFeeds;
+                sweepLineStart = documentText.lastIndexOf(QLatin1Char('\n'), start - 1) + 1;
             }
+            sweepPosition = start;
+            lineNumber = sweepLine;
+            lineStart = sweepLineStart;
         }
 
-        SearchResult result;
-        result.lineNumber = lineNumber;
-        result.columnNumber = columnNumber;
-        result.matchedText = match.captured();
-        result.startPosition = match.capturedStart();
-        result.endPosition = match.capturedEnd();
-
-        results.append(result);
+        result.lineNumber = int(lineNumber);
+        result.columnNumber = int(start - lineStart);
     }
 
     return results;
@@ -268,10 +768,18 @@ QVector<SearchResult> SearchReplace::findAll(Editor *editor, const QString &sear
 
 void SearchReplace::clearSearch()
 {
+    // Batches the cancelled worker already queued must not land in the
+    // cleared results
+    cancelSearch();
+    ++searchGeneration;
+    matches.clear();
+    searchComplete = false;
+    pendingMove = NoMove;
     lastSearchText.clear();
     currentMatchIndex = 0;
     totalMatches = 0;
-    clearHighlights(currentEditor);
+    clearHighlights(highlightEditor);
+    emit matchesUpdated(totalMatches);
 }
 
 void SearchReplace::highlightMatches(Editor *editor, const QString &searchText)
@@ -279,15 +787,67 @@ void SearchReplace::highlightMatches(Editor *editor, const QString &searchText)
     if (!editor)
         return;
 
-    QVector<SearchResult> results = findAll(editor, searchText, searchOptions);
-    // TODO: Apply highlighting to matches
+    if (searchText.isEmpty())
+    {
+        clearHighlights(editor);
+        return;
+    }
+    if (highlightEditor && highlightEditor != editor)
+    {
+        clearHighlights(highlightEditor);
+    }
+
+    // The background scan of the query provides the total count and, once
+    // complete, the matches painted around the viewport
+    lastSearchText = searchText;
+    bool cached = editor == searchEditor && cachedSearchText == lastSearchText && cachedOptions == searchOptions;
+    if (!cached || (!activeSearch && !searchComplete))
+    {
+        startSearch(editor);
+    }
+
+    highlightEditor = editor;
+    QPointer<SearchReplace> self(this);
+    editor->setMatchSource([self, editor](int from, int to)
+                           { return self ? self->matchesInRange(editor, from, to) : QVector<QPair<int, int>>(); });
 }
 
 void SearchReplace::clearHighlights(Editor *editor)
 {
     if (!editor)
         return;
-    // TODO: Clear highlights
+
+    editor->clearHighlights();
+    if (highlightEditor == editor)
+    {
+        highlightEditor = nullptr;
+    }
+}
+
+QVector<QPair<int, int>> SearchReplace::matchesInRange(Editor *editor, int from, int to) const
+{
+    QVector<QPair<int, int>> ranges;
+    if (cachedSearchText.isEmpty())
+        return ranges;
+
+    if (editor == searchEditor && searchComplete)
+    {
+        auto it = std::lower_bound(matches.cbegin(), matches.cend(), from, [](const SearchResult &result, int position)
+                                   { return result.endPosition <= position; });
+        for (; it != matches.cend() && it->startPosition < to; ++it)
+        {
+            ranges.append(qMakePair(it->startPosition, it->endPosition));
+        }
+        return ranges;
+    }
+
+    // Until the scan completes the window is searched directly
+    const QVector<SearchResult> found = searchRange(editor, from, to);
+    for (const SearchResult &result : found)
+    {
+        ranges.append(qMakePair(result.startPosition, result.endPosition));
+    }
+    return ranges;
 }
 
 SearchResult SearchReplace::performSearch(Editor *editor, const QString &searchText, int startPosition)
@@ -300,14 +860,14 @@ SearchResult SearchReplace::performSearch(Editor *editor, const QString &searchT
     }
 
     QString documentText = editor->toPlainText();
-    QRegularExpression regex(escapeRegexSpecialChars(searchText));
+    LiteralSearcher searcher(searchText);
 
-    QRegularExpressionMatch match = regex.match(documentText, startPosition);
-    if (match.hasMatch())
+    qsizetype position = searcher.indexIn(documentText, startPosition);
+    if (position >= 0)
     {
-        result.matchedText = match.captured();
-        result.startPosition = match.capturedStart();
-        result.endPosition = match.capturedEnd();
+        result.matchedText = documentText.mid(position, searcher.length());
+        result.startPosition = int(position);
+        result.endPosition = int(position + searcher.length());
     }
 
     return result;
@@ -315,32 +875,31 @@ SearchResult SearchReplace::performSearch(Editor *editor, const QString &searchT
 
 bool SearchReplace::validateRegex(const QString &pattern) const
 {
-    QRegularExpression regex(pattern);
-    return regex.isValid();
+    return PatternCache::instance().pattern(pattern).isValid();
 }
 
-QString SearchReplace::escapeRegexSpecialChars(const QString &text) const
+QRegularExpression SearchReplace::compileRegex(const QString &searchText, SearchOptions options)
 {
-    QString escaped = text;
-    escaped.replace("\\", "\\\\");
-    escaped.replace(".", "\\.");
-    escaped.replace("^", "\\^");
-    escaped.replace("$", "\\$");
-    escaped.replace("*", "\\*");
-    escaped.replace("+", "\\+");
-    escaped.replace("?", "\\?");
-    escaped.replace("{", "\\{");
-    escaped.replace("}", "\\}");
-    escaped.replace("[", "\\[");
-    escaped.replace("]", "\\]");
-    escaped.replace("(", "\\(");
-    escaped.replace(")", "\\)");
-    escaped.replace("|", "\\|");
-    return escaped;
+    QString searchPattern = searchText;
+    if (options & WholeWord)
+    {
+        searchPattern = QString("\\b%1\\b").arg(searchPattern);
+    }
+
+    // Unicode properties make \b and \w treat every letter and digit as a
+    // word character, as LiteralSearcher::isWordCharacter does, so whole-word
+    // search agrees between the literal and the regex paths
+    QRegularExpression::PatternOptions patternOptions = QRegularExpression::UseUnicodePropertiesOption;
+    if (!(options & CaseSensitive))
+    {
+        patternOptions |= QRegularExpression::CaseInsensitiveOption;
+    }
+
+    return PatternCache::instance().pattern(searchPattern, patternOptions);
 }
 
 SearchReplaceDialog::SearchReplaceDialog(QWidget *parent)
-    : QDialog(parent), searchManager(nullptr), currentEditor(nullptr)
+    : QDialog(parent), searchTimer(new QTimer(this)), searchManager(nullptr), currentEditor(nullptr)
 {
     setWindowTitle("Find and Replace");
     setGeometry(100, 100, 500, 200);
@@ -398,13 +957,19 @@ void SearchReplaceDialog::createConnections()
     connect(replaceButton, &QPushButton::clicked, this, &SearchReplaceDialog::onReplaceButtonClicked);
     connect(replaceAllButton, &QPushButton::clicked, this, &SearchReplaceDialog::onReplaceAllButtonClicked);
     connect(closeButton, &QPushButton::clicked, this, &QDialog::close);
+
+    // Typing restarts the delay; the search runs once the input settles
+    searchTimer->setSingleShot(true);
+    searchTimer->setInterval(SearchDelay);
+    connect(findLineEdit, &QLineEdit::textEdited, searchTimer, QOverload<>::of(&QTimer::start));
+    connect(searchTimer, &QTimer::timeout, this, &SearchReplaceDialog::searchAsYouType);
+    connect(caseSensitiveCheckBox, &QCheckBox::toggled, this, &SearchReplaceDialog::onCaseSensitiveToggled);
+    connect(wholeWordCheckBox, &QCheckBox::toggled, this, &SearchReplaceDialog::onWholeWordToggled);
+    connect(regexCheckBox, &QCheckBox::toggled, this, &SearchReplaceDialog::onRegexToggled);
 }
 
-void SearchReplaceDialog::onFindButtonClicked()
+SearchReplace::SearchOptions SearchReplaceDialog::currentOptions() const
 {
-    if (!searchManager || !currentEditor)
-        return;
-
     SearchReplace::SearchOptions options;
     if (caseSensitiveCheckBox->isChecked())
         options |= SearchReplace::CaseSensitive;
@@ -412,7 +977,36 @@ void SearchReplaceDialog::onFindButtonClicked()
         options |= SearchReplace::WholeWord;
     if (regexCheckBox->isChecked())
         options |= SearchReplace::UseRegex;
+    return options;
+}
+
+void SearchReplaceDialog::searchAsYouType()
+{
+    searchTimer->stop();
+    if (!searchManager || !currentEditor)
+        return;
+
+    QString text = findLineEdit->text();
+    SearchReplace::SearchOptions options = currentOptions();
+    if (text.isEmpty())
+    {
+        searchManager->clearSearch();
+        return;
+    }
+
+    // A half-typed pattern keeps the previous results until it compiles
+    if ((options & SearchReplace::UseRegex) && !SearchReplace::compileRegex(text, options).isValid())
+        return;
+
+    searchManager->findIncremental(currentEditor, text, options);
+}
+
+void SearchReplaceDialog::onFindButtonClicked()
+{
+    if (!searchManager || !currentEditor)
+        return;
 
+    SearchReplace::SearchOptions options = currentOptions();
     searchManager->find(currentEditor, findLineEdit->text(), options);
 }
 
@@ -421,14 +1015,7 @@ void SearchReplaceDialog::onReplaceButtonClicked()
     if (!searchManager || !currentEditor)
         return;
 
-    SearchReplace::SearchOptions options;
-    if (caseSensitiveCheckBox->isChecked())
-        options |= SearchReplace::CaseSensitive;
-    if (wholeWordCheckBox->isChecked())
-        options |= SearchReplace::WholeWord;
-    if (regexCheckBox->isChecked())
-        options |= SearchReplace::UseRegex;
-
+    SearchReplace::SearchOptions options = currentOptions();
     searchManager->replace(currentEditor, findLineEdit->text(), replaceLineEdit->text(), options);
 }
 
@@ -437,33 +1024,34 @@ void SearchReplaceDialog::onReplaceAllButtonClicked()
     if (!searchManager || !currentEditor)
         return;
 
-    SearchReplace::SearchOptions options;
-    if (caseSensitiveCheckBox->isChecked())
-        options |= SearchReplace::CaseSensitive;
-    if (wholeWordCheckBox->isChecked())
-        options |= SearchReplace::WholeWord;
-    if (regexCheckBox->isChecked())
-        options |= SearchReplace::UseRegex;
-
+    SearchReplace::SearchOptions options = currentOptions();
     searchManager->replaceAll(currentEditor, findLineEdit->text(), replaceLineEdit->text(), options);
 }
 
 void SearchReplaceDialog::onCaseSensitiveToggled(bool checked)
 {
-    // TODO: Update search behavior
+    Q_UNUSED(checked);
+    searchAsYouType();
 }
 
 void SearchReplaceDialog::onWholeWordToggled(bool checked)
 {
-    // TODO: Update search behavior
+    Q_UNUSED(checked);
+    searchAsYouType();
 }
 
 void SearchReplaceDialog::onRegexToggled(bool checked)
 {
-    // TODO: Update search behavior
+    Q_UNUSED(checked);
+    searchAsYouType();
 }
 
 void SearchReplaceDialog::closeEvent(QCloseEvent *event)
 {
+    searchTimer->stop();
+    if (searchManager && currentEditor)
+    {
+        searchManager->clearHighlights(currentEditor);
+    }
     event->accept();
 }
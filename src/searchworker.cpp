@@ -0,0 +1,229 @@
+#include "searchworker.h"
+#include "literalsearcher.h"
+#include "trigramindex.h"
+
+#include <QRegularExpression>
+
+SearchWorker::SearchWorker(const PieceTable::Snapshot &snapshot, const QString &searchText,
+                           SearchReplace::SearchOptions options, int generation, QObject *parent)
+    : QObject(parent), contents(snapshot), searchText(searchText), options(options), generation(generation), cancelled(false), totalMatches(0), sweepPosition(0), sweepLine(0), sweepLineStart(0)
+{
+}
+
+SearchWorker::~SearchWorker() = default;
+
+void SearchWorker::cancel()
+{
+    cancelled.store(true);
+}
+
+void SearchWorker::run()
+{
+    // A search replaced before it got a thread has nothing to do
+    if (isCancelled())
+        return;
+
+    QString text = contents.toString();
+    batchTimer.start();
+
+    if (options & SearchReplace::UseRegex)
+    {
+        QRegularExpression regex = SearchReplace::compileRegex(searchText, options);
+        if (regex.isValid() && !scanIndexed(regex, text))
+        {
+            scanRegex(regex, text);
+        }
+    }
+    else if (!scanIndexed(QRegularExpression(), text))
+    {
+        scanLiteral(text);
+    }
+
+    if (isCancelled())
+        return;
+
+    flushBatch();
+    emit finished(generation, totalMatches);
+}
+
+bool SearchWorker::scanIndexed(const QRegularExpression &regex, const QString &text)
+{
+    if (!searchIndex)
+        return false;
+
+    // Regexes qualify when every match lies within one line and contains a
+    // literal the index can look up
+    QString literal = (options & SearchReplace::UseRegex) ? TrigramIndex::requiredLiteral(searchText) : searchText;
+    if (literal.size() < 3 || literal.contains(QLatin1Char('\n')))
+    {
+        searchIndex.reset();
+        return false;
+    }
+
+    // The first query builds the index here, off the GUI thread, and sends
+    // it back for the editor to keep up to date
+    if (!searchIndex->isBuilt())
+    {
+        auto index = std::make_shared<TrigramIndex>();
+        index->setMemoryLimit(searchIndex->getMemoryLimit());
+        searchIndex = index;
+        if (!index->build(text, &cancelled))
+        {
+            searchIndex.reset();
+            return false;
+        }
+        emit indexBuilt(generation, index);
+    }
+
+    QVector<int> lines;
+    QVector<qsizetype> lineStarts;
+    bool narrowed = searchIndex->textLength() == text.size() &&
+                    searchIndex->candidateLines(literal, lines, &lineStarts) &&
+                    lines.size() <= searchIndex->lineCount() / 2;
+    qsizetype lineCount = searchIndex->lineCount();
+    searchIndex.reset();
+    if (!narrowed || isCancelled())
+        return false;
+
+    Qt::CaseSensitivity caseSensitivity = (options & SearchReplace::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    LiteralSearcher searcher(searchText, caseSensitivity, options.testFlag(SearchReplace::WholeWord));
+    for (int i = 0; i < lines.size() && !isCancelled(); ++i)
+    {
+        qsizetype lineStart = lineStarts.at(i);
+        qsizetype lineEnd = lines.at(i) + 1 < lineCount ? text.indexOf(QLatin1Char('\n'), lineStart) : text.size();
+        if (lineEnd < 0)
+            lineEnd = text.size();
+
+        // The line is known, so the sweep starts from it
+        sweepPosition = lineStart;
+        sweepLine = lines.at(i);
+        sweepLineStart = lineStart;
+
+        if (options & SearchReplace::UseRegex)
+        {
+            QString line = text.mid(lineStart, lineEnd - lineStart);
+            QRegularExpressionMatchIterator it = regex.globalMatch(line);
+            while (it.hasNext())
+            {
+                QRegularExpressionMatch match = it.next();
+                addMatch(text, lineStart + match.capturedStart(), lineStart + match.capturedEnd());
+            }
+        }
+        else
+        {
+            for (qsizetype position = searcher.indexIn(text, lineStart, lineEnd); position >= 0;
+                 position = searcher.indexIn(text, position + searcher.length(), lineEnd))
+            {
+                addMatch(text, position, position + searcher.length());
+            }
+        }
+    }
+    return true;
+}
+
+void SearchWorker::scanRegex(const QRegularExpression &regex, const QString &text)
+{
+    // Each match sees the text only up to the end of the current slice. A
+    // hard partial match means the match could go on past that end, so the
+    // slice is widened and the match retried from where it began; only the
+    // last slice, which ends with the text, is matched normally.
+    // PCRE2 would check the whole subject for valid UTF-16 on every slice,
+    // so it is checked once here instead.
+    QRegularExpression::MatchOptions matchOptions = QRegularExpression::NoMatchOption;
+    if (QStringView(text).isValidUtf16())
+        matchOptions |= QRegularExpression::DontCheckSubjectStringMatchOption;
+    qsizetype from = 0;
+    qsizetype window = SliceSize;
+    while (from <= text.size() && !isCancelled())
+    {
+        qsizetype end = qMin(text.size(), from + window);
+        // Unchecked slices must not end between the halves of a surrogate pair
+        if (end < text.size() && text.at(end - 1).isHighSurrogate())
+            ++end;
+        bool last = end == text.size();
+        QRegularExpressionMatch match = regex.match(QStringView(text).first(end), from,
+                                                    last ? QRegularExpression::NormalMatch : QRegularExpression::PartialPreferFirstMatch,
+                                                    matchOptions);
+        if (match.hasPartialMatch())
+        {
+            from = match.capturedStart();
+            window *= 2;
+            continue;
+        }
+        window = SliceSize;
+
+        if (!match.hasMatch())
+        {
+            if (last)
+                break;
+            from = end;
+            continue;
+        }
+
+        qsizetype start = match.capturedStart();
+        from = match.capturedEnd();
+        addMatch(text, start, from);
+
+        // Step over an empty match, without splitting a surrogate pair
+        if (from == start)
+        {
+            ++from;
+            if (from < text.size() && text.at(from).isLowSurrogate() && text.at(from - 1).isHighSurrogate())
+                ++from;
+        }
+    }
+}
+
+void SearchWorker::scanLiteral(const QString &text)
+{
+    Qt::CaseSensitivity caseSensitivity = (options & SearchReplace::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    LiteralSearcher searcher(searchText, caseSensitivity, options.testFlag(SearchReplace::WholeWord));
+    qsizetype from = 0;
+    qsizetype sliceEnd = 0;
+    while (sliceEnd < text.size() && !isCancelled())
+    {
+        sliceEnd = qMin(sliceEnd + SliceSize, text.size());
+        for (qsizetype position = searcher.indexIn(text, from, sliceEnd); position >= 0;
+             position = searcher.indexIn(text, from, sliceEnd))
+        {
+            from = position + searcher.length();
+            addMatch(text, position, from);
+        }
+        from = qMax(from, sliceEnd);
+    }
+}
+
+void SearchWorker::addMatch(const QString &text, qsizetype start, qsizetype end)
+{
+    // Matches arrive in order, so one forward sweep finds their lines
+    qsizetype lineFeeds = QStringView(text).mid(sweepPosition, start - sweepPosition).count(QLatin1Char('\n'));
+    if (lineFeeds > 0)
+    {
+        sweepLine += lineFeeds;
+        sweepLineStart = text.lastIndexOf(QLatin1Char('\n'), start - 1) + 1;
+    }
+    sweepPosition = start;
+
+    SearchResult result;
+    result.lineNumber = int(sweepLine);
+    result.columnNumber = int(start - sweepLineStart);
+    result.startPosition = int(start);
+    result.endPosition = int(end);
+    batch.append(result);
+    ++totalMatches;
+
+    if (totalMatches == 1 || batch.size() >= MaxBatchSize || batchTimer.elapsed() >= BatchInterval)
+    {
+        flushBatch();
+    }
+}
+
+void SearchWorker::flushBatch()
+{
+    if (!batch.isEmpty())
+    {
+        emit resultsReady(generation, batch);
+        batch.clear();
+    }
+    batchTimer.restart();
+}
@@ -1,50 +1,104 @@
 #include "syntaxhighlighter.h"
+#include "patterncache.h"
+
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QTextBlock>
+#include <QTimer>
+#include <limits>
+
+namespace
+{
+    // Cached tokens and lexer states of a block, the generation they were
+    // lexed for and the format generation the block shows
+    struct BlockData : public QTextBlockUserData
+    {
+        int generation = -1;
+        int formatGeneration = -1;
+        int startState = 0;
+        int endState = 0;
+        QVector<Token> tokens;
+    };
+
+    BlockData *blockData(const QTextBlock &block)
+    {
+        return static_cast<BlockData *>(block.userData());
+    }
+
+    BlockData *ensureBlockData(QTextBlock block)
+    {
+        BlockData *data = blockData(block);
+        if (!data)
+        {
+            data = new BlockData;
+            block.setUserData(data);
+        }
+        return data;
+    }
+}
 
 SyntaxHighlighter::SyntaxHighlighter(QTextDocument *parent)
-    : QSyntaxHighlighter(parent), currentLanguage(PlainText), theme("Light"), enabled(true)
+    : QSyntaxHighlighter(parent), lexer(nullptr), highlightTimer(std::make_unique<QTimer>()), generation(0), formatGeneration(0), scanBlock(0), stateBlock(0), tokenizeRequest(0), editedBlock(std::numeric_limits<int>::max()), knownBlockCount(0), firstVisible(0), lastVisible(-1), formatsApplied(false), currentLanguage(PlainText), theme("Light"), enabled(true)
 {
+    // Edits are followed here instead of by QSyntaxHighlighter, which would
+    // highlight every changed block at once
+    if (parent)
+    {
+        disconnect(parent, &QTextDocument::contentsChange, this, nullptr);
+        connect(parent, &QTextDocument::contentsChange, this, &SyntaxHighlighter::onContentsChange);
+    }
+
+    highlightTimer->setSingleShot(true);
+    highlightTimer->setInterval(0);
+    connect(highlightTimer.get(), &QTimer::timeout, this, &SyntaxHighlighter::highlightPending);
+
+    // Requests depend on the states of the previous one, so one at a time
+    tokenizerPool.setMaxThreadCount(1);
+
+    applyLightTheme();
     setLanguage(PlainText);
 }
 
-SyntaxHighlighter::~SyntaxHighlighter() = default;
+SyntaxHighlighter::~SyntaxHighlighter()
+{
+    cancelTokenizer();
+    tokenizerPool.waitForDone();
+}
 
 void SyntaxHighlighter::setLanguage(Language lang)
 {
     currentLanguage = lang;
-    highlightingRules.clear();
+    lexer = nullptr;
 
     switch (lang)
     {
     case CPlusPlus:
-        initializeCppRules();
+        lexer = Lexer::cpp();
         break;
     case Python:
-        initializePythonRules();
+        lexer = Lexer::python();
         break;
     case JavaScript:
-        initializeJavaScriptRules();
+        lexer = Lexer::javaScript();
         break;
     case JSON:
-        initializeJsonRules();
+        lexer = Lexer::json();
         break;
     case XML:
-        initializeXmlRules();
-        break;
     case HTML:
-        initializeHtmlRules();
+        lexer = Lexer::markup();
         break;
     case CSS:
-        initializeCssRules();
+        lexer = Lexer::css();
         break;
     case SQL:
-        initializeSqlRules();
+        lexer = Lexer::sql();
         break;
     default:
         break;
     }
 
-    rehighlight();
+    scheduleRehighlight();
 }
 
 void SyntaxHighlighter::detectLanguageFromExtension(const QString &extension)
@@ -90,295 +144,367 @@ void SyntaxHighlighter::detectLanguageFromExtension(const QString &extension)
 void SyntaxHighlighter::setTheme(const QString &themeName)
 {
     theme = themeName;
-    if (themeName == "Dark")
-    {
-        applyDarkTheme();
-    }
-    else
-    {
-        applyLightTheme();
-    }
-    rehighlight();
+    applyTheme(themeName);
+    scheduleReformat();
 }
 
 void SyntaxHighlighter::addCustomRule(const HighlightingRule &rule)
 {
+    addCustomRule(rule.pattern.pattern(), rule.format, rule.pattern.patternOptions());
+}
+
+void SyntaxHighlighter::addCustomRule(const QString &pattern, const QTextCharFormat &format,
+                                      QRegularExpression::PatternOptions options)
+{
+    HighlightingRule rule;
+    rule.pattern = PatternCache::instance().pattern(pattern, options);
+    rule.format = format;
     customRules.append(rule);
-    rehighlight();
+    scheduleReformat();
 }
 
 void SyntaxHighlighter::clearCustomRules()
 {
     customRules.clear();
-    rehighlight();
+    scheduleReformat();
 }
 
 void SyntaxHighlighter::setHighlightingEnabled(bool enable)
 {
     enabled = enable;
-    rehighlight();
+    scheduleRehighlight();
 }
 
-void SyntaxHighlighter::highlightBlock(const QString &text)
+void SyntaxHighlighter::scheduleRehighlight()
 {
-    if (!enabled)
-        return;
-
-    // Apply highlighting rules
-    for (const HighlightingRule &rule : highlightingRules)
+    // Blocks of older generations no longer count as tokenized or highlighted
+    ++generation;
+    ++formatGeneration;
+    cancelTokenizer();
+    scanBlock = 0;
+    stateBlock = 0;
+    if (document())
     {
-        QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
-        while (matchIterator.hasNext())
-        {
-            QRegularExpressionMatch match = matchIterator.next();
-            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
-        }
+        knownBlockCount = document()->blockCount();
+        highlightTimer->start();
     }
+}
 
-    // Apply custom rules
-    for (const HighlightingRule &rule : customRules)
+void SyntaxHighlighter::scheduleReformat()
+{
+    // Tokens stay valid, so the walk only re-applies formats up to the
+    // blocks tokenized so far while the tokenizer carries on
+    ++formatGeneration;
+    scanBlock = 0;
+    if (document())
     {
-        QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
-        while (matchIterator.hasNext())
-        {
-            QRegularExpressionMatch match = matchIterator.next();
-            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
-        }
+        highlightTimer->start();
     }
 }
 
-void SyntaxHighlighter::initializeCppRules()
+void SyntaxHighlighter::setVisibleBlocks(int first, int last)
 {
-    HighlightingRule rule;
+    firstVisible = first;
+    lastVisible = last;
+    if (last >= scanBlock && document() && scanBlock < document()->blockCount())
+    {
+        highlightTimer->start();
+    }
+}
 
-    // Keywords
-    QTextCharFormat keywordFormat = getFormat("keyword");
-    QStringList keywords = {
-        "auto", "bool", "break", "case", "catch", "char", "class", "const",
-        "continue", "default", "delete", "do", "double", "else", "enum", "explicit",
-        "extern", "false", "float", "for", "friend", "goto", "if", "inline",
-        "int", "long", "mutable", "namespace", "new", "nullptr", "operator",
-        "private", "protected", "public", "register", "return", "short", "signed",
-        "sizeof", "static", "struct", "switch", "template", "this", "throw",
-        "true", "try", "typedef", "typeid", "typename", "union", "unsigned",
-        "virtual", "void", "volatile", "wchar_t", "while"};
-
-    for (const QString &keyword : keywords)
-    {
-        rule.pattern = QRegularExpression("\\b" + keyword + "\\b");
-        rule.format = keywordFormat;
-        highlightingRules.append(rule);
-    }
-
-    // Strings
-    rule.pattern = QRegularExpression("\".*?\"");
-    rule.format = getFormat("string");
-    highlightingRules.append(rule);
-
-    // Comments
-    rule.pattern = QRegularExpression("//.*");
-    rule.format = getFormat("comment");
-    highlightingRules.append(rule);
-
-    // Numbers
-    rule.pattern = QRegularExpression("\\b[0-9]+\\b");
-    rule.format = getFormat("number");
-    highlightingRules.append(rule);
+bool SyntaxHighlighter::isHighlightComplete() const
+{
+    return document() && !activeTokenizer && !highlightTimer->isActive() && scanBlock >= document()->blockCount();
 }
 
-void SyntaxHighlighter::initializePythonRules()
+void SyntaxHighlighter::onContentsChange(int position, int charsRemoved, int charsAdded)
 {
-    HighlightingRule rule;
+    Q_UNUSED(charsRemoved);
+    QTextDocument *doc = document();
+    QTextBlock block = doc->findBlock(position);
+    int firstBlock = block.blockNumber();
+    int lastBlock = doc->findBlock(qMin(position + charsAdded, doc->characterCount() - 1)).blockNumber();
+    if (firstBlock < 0 || lastBlock < 0)
+        return;
 
-    // Keywords
-    QTextCharFormat keywordFormat = getFormat("keyword");
-    QStringList keywords = {
-        "and", "as", "assert", "break", "class", "continue", "def", "del",
-        "elif", "else", "except", "False", "finally", "for", "from", "global",
-        "if", "import", "in", "is", "lambda", "None", "not", "or", "pass",
-        "raise", "return", "True", "try", "while", "with", "yield"};
+    // Blocks below the edit moved by the number of lines it added or removed
+    int delta = doc->blockCount() - knownBlockCount;
+    knownBlockCount = doc->blockCount();
+    auto shift = [&](int mark)
+    {
+        return mark <= firstBlock ? mark : qMax(mark + delta, lastBlock + 1);
+    };
+    scanBlock = shift(scanBlock);
+    stateBlock = shift(stateBlock);
 
-    for (const QString &keyword : keywords)
+    if (!appliesFormats() && !formatsApplied)
+        return;
+
+    // The edited blocks are stale whatever their cache says, and so are
+    // tokens on their way back for them
+    if (activeTokenizer)
+        editedBlock = qMin(editedBlock, firstBlock);
+    int editedLength = 0;
+    QTextBlock edited = block;
+    for (int number = firstBlock; edited.isValid() && number <= lastBlock; edited = edited.next(), ++number)
     {
-        rule.pattern = QRegularExpression("\\b" + keyword + "\\b");
-        rule.format = keywordFormat;
-        highlightingRules.append(rule);
+        if (BlockData *data = blockData(edited))
+        {
+            data->generation = -1;
+            data->formatGeneration = -1;
+        }
+        editedLength += edited.length();
     }
 
-    // Strings
-    rule.pattern = QRegularExpression("\".*?\"");
-    rule.format = getFormat("string");
-    highlightingRules.append(rule);
+    // Small edits such as typing are lexed in place, as long as the state
+    // they start in is known; until then the old formats stand in
+    if (lastBlock - firstBlock >= ImmediateBlocks || editedLength > ImmediateLength || (lexes() && firstBlock > stateBlock))
+    {
+        scanBlock = qMin(scanBlock, firstBlock);
+        stateBlock = qMin(stateBlock, firstBlock);
+        highlightTimer->start();
+        return;
+    }
 
-    rule.pattern = QRegularExpression("'.*?'");
-    rule.format = getFormat("string");
-    highlightingRules.append(rule);
+    for (int number = firstBlock; block.isValid() && number <= lastBlock; block = block.next(), ++number)
+    {
+        if (lexes())
+            lexBlock(block);
+        rehighlightBlock(block);
+    }
 
-    // Comments
-    rule.pattern = QRegularExpression("#.*");
-    rule.format = getFormat("comment");
-    highlightingRules.append(rule);
+    // A changed end state sends the blocks below to the worker
+    const BlockData *next = blockData(block);
+    if (lexes() && block.isValid() && !(next && next->generation == generation && next->startState == startState(block)))
+    {
+        scanBlock = qMin(scanBlock, lastBlock + 1);
+        stateBlock = qMin(stateBlock, lastBlock + 1);
+        highlightTimer->start();
+    }
 }
 
-void SyntaxHighlighter::initializeJavaScriptRules()
+void SyntaxHighlighter::highlightPending()
 {
-    HighlightingRule rule;
+    QTextDocument *doc = document();
+    if (!doc)
+        return;
+
+    // Plain text with no formats left to clear needs no walk
+    if (!appliesFormats() && !formatsApplied)
+    {
+        scanBlock = doc->blockCount();
+        stateBlock = scanBlock;
+        return;
+    }
 
-    // Keywords
-    QTextCharFormat keywordFormat = getFormat("keyword");
-    QStringList keywords = {
-        "break", "case", "catch", "class", "const", "continue", "debugger",
-        "default", "delete", "do", "else", "export", "extends", "finally",
-        "for", "function", "if", "import", "in", "instanceof", "new", "return",
-        "super", "switch", "this", "throw", "try", "typeof", "var", "void",
-        "while", "with", "yield", "let", "static", "enum", "await", "async"};
+    // Without a lexer every block's tokens are trivially empty; with one,
+    // cached blocks that still follow on from the blocks above are kept
+    if (!lexes())
+        stateBlock = doc->blockCount();
+    else
+        stateBlock = endOfValidTokens(doc->findBlockByNumber(stateBlock), stateBlock);
+
+    QElapsedTimer elapsed;
+    elapsed.start();
 
-    for (const QString &keyword : keywords)
+    // Visible blocks first, as far as their tokens have arrived
+    if (lastVisible >= scanBlock)
     {
-        rule.pattern = QRegularExpression("\\b" + keyword + "\\b");
-        rule.format = keywordFormat;
-        highlightingRules.append(rule);
+        int number = qMax(firstVisible, scanBlock);
+        for (QTextBlock block = doc->findBlockByNumber(number); block.isValid() && number <= lastVisible && number < stateBlock;
+             block = block.next(), ++number)
+        {
+            if (!isHighlighted(block))
+                rehighlightBlock(block);
+        }
     }
 
-    // Strings
-    rule.pattern = QRegularExpression("\".*?\"");
-    rule.format = getFormat("string");
-    highlightingRules.append(rule);
+    // Then the rest of the document in order
+    QTextBlock block = doc->findBlockByNumber(scanBlock);
+    for (; block.isValid() && scanBlock < stateBlock && !elapsed.hasExpired(FrameBudget); block = block.next(), ++scanBlock)
+    {
+        if (!isHighlighted(block))
+            rehighlightBlock(block);
+    }
 
-    rule.pattern = QRegularExpression("'.*?'");
-    rule.format = getFormat("string");
-    highlightingRules.append(rule);
+    if (stateBlock < doc->blockCount() && !activeTokenizer)
+    {
+        requestTokens(elapsed);
+    }
 
-    // Comments
-    rule.pattern = QRegularExpression("//.*");
-    rule.format = getFormat("comment");
-    highlightingRules.append(rule);
+    if (scanBlock < stateBlock)
+    {
+        highlightTimer->start();
+    }
+    else if (scanBlock >= doc->blockCount() && !appliesFormats())
+    {
+        formatsApplied = false;
+    }
 }
 
-void SyntaxHighlighter::initializeJsonRules()
+void SyntaxHighlighter::requestTokens(const QElapsedTimer &elapsed)
 {
-    HighlightingRule rule;
+    // One request reaches the visible blocks when they are below the
+    // blocks tokenized so far, as far as a slice allows
+    int wanted = qMax(BatchBlocks, lastVisible + 1 - stateBlock);
+    QTextBlock block = document()->findBlockByNumber(stateBlock);
+    int state = startState(block);
+    QStringList texts;
+    for (; block.isValid() && texts.size() < wanted; block = block.next())
+    {
+        texts.append(block.text());
+        if (elapsed.hasExpired(FrameBudget))
+            break;
+    }
+    if (texts.isEmpty())
+        return;
+
+    TokenizerWorker *worker = new TokenizerWorker(lexer, texts, state, stateBlock, ++tokenizeRequest);
+    connect(worker, &TokenizerWorker::finished, this, &SyntaxHighlighter::onBlocksTokenized);
+    activeTokenizer = worker;
+    editedBlock = std::numeric_limits<int>::max();
 
-    // Strings
-    rule.pattern = QRegularExpression("\".*?\"");
-    rule.format = getFormat("string");
-    highlightingRules.append(rule);
+    // The worker stays owned by this thread; its signal is queued back here
+    tokenizerPool.start([worker]()
+                        {
+        worker->run();
+        worker->deleteLater(); });
+}
 
-    // Numbers
-    rule.pattern = QRegularExpression("[0-9]+");
-    rule.format = getFormat("number");
-    highlightingRules.append(rule);
+void SyntaxHighlighter::onBlocksTokenized(int request, int firstBlock, int firstState, const QVector<TokenizedBlock> &blocks)
+{
+    if (request != tokenizeRequest)
+        return;
+    activeTokenizer = nullptr;
 
-    // Keywords
-    QTextCharFormat keywordFormat = getFormat("keyword");
-    QStringList keywords = {"true", "false", "null"};
+    // Keep the blocks above the first edit since the request, provided the
+    // run still continues from the blocks tokenized before it; otherwise
+    // the next slice asks again from stateBlock
+    QTextBlock block = document()->findBlockByNumber(firstBlock);
+    if (firstBlock != stateBlock || startState(block) != firstState)
+    {
+        highlightTimer->start();
+        return;
+    }
+    int count = qMin<qsizetype>(blocks.size(), qMax(0, editedBlock - firstBlock));
 
-    for (const QString &keyword : keywords)
+    // The run stops at the first block whose cached tokens were lexed from
+    // the same start state: from there on the cache is still right, formats
+    // included
+    int number = 0;
+    for (; block.isValid() && number < count; block = block.next(), ++number)
     {
-        rule.pattern = QRegularExpression("\\b" + keyword + "\\b");
-        rule.format = keywordFormat;
-        highlightingRules.append(rule);
+        BlockData *data = ensureBlockData(block);
+        const TokenizedBlock &result = blocks.at(number);
+        int state = number > 0 ? blocks.at(number - 1).endState : firstState;
+        if (data->generation == generation && data->startState == state)
+            break;
+
+        data->startState = state;
+        data->endState = result.endState;
+        data->tokens = result.tokens;
+        data->generation = generation;
+        data->formatGeneration = -1;
     }
+    stateBlock = endOfValidTokens(block, firstBlock + number);
+    scanBlock = qMin(scanBlock, stateBlock);
+    highlightTimer->start();
 }
 
-void SyntaxHighlighter::initializeXmlRules()
+void SyntaxHighlighter::cancelTokenizer()
 {
-    HighlightingRule rule;
+    if (activeTokenizer)
+    {
+        activeTokenizer->cancel();
+    }
+    activeTokenizer = nullptr;
 
-    // Tags
-    rule.pattern = QRegularExpression("<.*?>");
-    rule.format = getFormat("keyword");
-    highlightingRules.append(rule);
-
-    // Attributes
-    rule.pattern = QRegularExpression("\\b[A-Za-z_:][A-Za-z0-9_:.-]*=");
-    rule.format = getFormat("keyword");
-    highlightingRules.append(rule);
-
-    // Strings
-    rule.pattern = QRegularExpression("\".*?\"");
-    rule.format = getFormat("string");
-    highlightingRules.append(rule);
-
-    // Comments
-    rule.pattern = QRegularExpression("<!--.*?-->");
-    rule.format = getFormat("comment");
-    highlightingRules.append(rule);
+    // A result already on its way is dropped too
+    ++tokenizeRequest;
 }
 
-void SyntaxHighlighter::initializeHtmlRules()
+bool SyntaxHighlighter::appliesFormats() const
 {
-    HighlightingRule rule;
+    return enabled && (lexer || !customRules.isEmpty());
+}
 
-    // Tags
-    rule.pattern = QRegularExpression("</?[A-Za-z].*?>");
-    rule.format = getFormat("keyword");
-    highlightingRules.append(rule);
+bool SyntaxHighlighter::lexes() const
+{
+    return enabled && lexer;
+}
 
-    // Strings
-    rule.pattern = QRegularExpression("\".*?\"");
-    rule.format = getFormat("string");
-    highlightingRules.append(rule);
+bool SyntaxHighlighter::isHighlighted(const QTextBlock &block) const
+{
+    const BlockData *data = blockData(block);
+    return data && data->formatGeneration == formatGeneration;
+}
 
-    // Comments
-    rule.pattern = QRegularExpression("<!--.*?-->");
-    rule.format = getFormat("comment");
-    highlightingRules.append(rule);
+int SyntaxHighlighter::endOfValidTokens(QTextBlock block, int number) const
+{
+    // Edited blocks drop out of the generation, so the walk stops at the
+    // next edit or where a block no longer starts in the state it was
+    // lexed from
+    int state = startState(block);
+    for (; block.isValid(); block = block.next(), ++number)
+    {
+        const BlockData *data = blockData(block);
+        if (!data || data->generation != generation || data->startState != state)
+            break;
+        state = data->endState;
+    }
+    return number;
 }
 
-void SyntaxHighlighter::initializeCssRules()
+int SyntaxHighlighter::startState(const QTextBlock &block) const
 {
-    HighlightingRule rule;
+    // Only the previous block's state of this generation carries over
+    const BlockData *data = blockData(block.previous());
+    return (data && data->generation == generation) ? data->endState : 0;
+}
 
-    // Selectors
-    rule.pattern = QRegularExpression("[.#]?[A-Za-z_][A-Za-z0-9_-]*");
-    rule.format = getFormat("keyword");
-    highlightingRules.append(rule);
-
-    // Properties
-    rule.pattern = QRegularExpression("[A-Za-z-]+(?=:)");
-    rule.format = getFormat("keyword");
-    highlightingRules.append(rule);
-
-    // Strings
-    rule.pattern = QRegularExpression("\".*?\"");
-    rule.format = getFormat("string");
-    highlightingRules.append(rule);
-
-    // Comments
-    rule.pattern = QRegularExpression("/\\*.*?\\*/");
-    rule.format = getFormat("comment");
-    highlightingRules.append(rule);
+void SyntaxHighlighter::lexBlock(QTextBlock block)
+{
+    BlockData *data = ensureBlockData(block);
+    data->startState = startState(block);
+    data->tokens.clear();
+    data->endState = lexer->tokenize(block.text(), data->startState, data->tokens);
+    data->generation = generation;
+    data->formatGeneration = -1;
 }
 
-void SyntaxHighlighter::initializeSqlRules()
+void SyntaxHighlighter::highlightBlock(const QString &text)
 {
-    HighlightingRule rule;
+    BlockData *data = static_cast<BlockData *>(currentBlockUserData());
+    if (!data)
+    {
+        data = new BlockData;
+        setCurrentBlockUserData(data);
+    }
+    data->formatGeneration = formatGeneration;
 
-    // Keywords
-    QTextCharFormat keywordFormat = getFormat("keyword");
-    QStringList keywords = {
-        "SELECT", "FROM", "WHERE", "AND", "OR", "NOT", "INSERT", "UPDATE",
-        "DELETE", "CREATE", "ALTER", "DROP", "TABLE", "DATABASE", "PRIMARY",
-        "KEY", "FOREIGN", "JOIN", "LEFT", "RIGHT", "INNER", "OUTER", "ON",
-        "GROUP", "BY", "ORDER", "ASC", "DESC", "LIMIT", "OFFSET", "DISTINCT"};
+    if (!appliesFormats())
+        return;
+    formatsApplied = true;
 
-    for (const QString &keyword : keywords)
+    // Only cached tokens are applied; lexing happens before this is called
+    if (lexes() && data->generation == generation)
     {
-        rule.pattern = QRegularExpression("\\b" + keyword + "\\b", QRegularExpression::CaseInsensitiveOption);
-        rule.format = keywordFormat;
-        highlightingRules.append(rule);
+        for (const Token &token : data->tokens)
+        {
+            setFormat(token.start, token.length, tokenFormats[token.tokenClass]);
+        }
     }
 
-    // Strings
-    rule.pattern = QRegularExpression("'.*?'");
-    rule.format = getFormat("string");
-    highlightingRules.append(rule);
-
-    // Comments
-    rule.pattern = QRegularExpression("--.*");
-    rule.format = getFormat("comment");
-    highlightingRules.append(rule);
+    // Apply custom rules
+    for (const HighlightingRule &rule : customRules)
+    {
+        QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
+        while (matchIterator.hasNext())
+        {
+            QRegularExpressionMatch match = matchIterator.next();
+            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
+        }
+    }
 }
 
 void SyntaxHighlighter::applyTheme(const QString &themeName)
@@ -400,23 +526,23 @@ void SyntaxHighlighter::applyLightTheme()
     // Keyword format
     format.setForeground(Qt::blue);
     format.setFontWeight(QFont::Bold);
-    formats["keyword"] = format;
+    tokenFormats[Lexer::Keyword] = format;
 
     // String format
     format.setForeground(Qt::darkGreen);
     format.setFontWeight(QFont::Normal);
-    formats["string"] = format;
+    tokenFormats[Lexer::String] = format;
 
     // Comment format
     format.setForeground(Qt::gray);
     format.setFontWeight(QFont::Normal);
     format.setFontItalic(true);
-    formats["comment"] = format;
+    tokenFormats[Lexer::Comment] = format;
 
     // Number format
     format.setForeground(Qt::darkMagenta);
     format.setFontWeight(QFont::Normal);
-    formats["number"] = format;
+    tokenFormats[Lexer::Number] = format;
 }
 
 void SyntaxHighlighter::applyDarkTheme()
@@ -426,60 +552,21 @@ void SyntaxHighlighter::applyDarkTheme()
     // Keyword format
     format.setForeground(Qt::cyan);
     format.setFontWeight(QFont::Bold);
-    formats["keyword"] = format;
+    tokenFormats[Lexer::Keyword] = format;
 
     // String format
     format.setForeground(Qt::green);
     format.setFontWeight(QFont::Normal);
-    formats["string"] = format;
+    tokenFormats[Lexer::String] = format;
 
     // Comment format
     format.setForeground(Qt::gray);
     format.setFontWeight(QFont::Normal);
     format.setFontItalic(true);
-    formats["comment"] = format;
+    tokenFormats[Lexer::Comment] = format;
 
     // Number format
     format.setForeground(Qt::magenta);
     format.setFontWeight(QFont::Normal);
-    formats["number"] = format;
-}
-
-QTextCharFormat SyntaxHighlighter::getFormat(const QString &formatType) const
-{
-    return formats.value(formatType, QTextCharFormat());
-}
-
-void SyntaxHighlighter::highlightMultilineComment(const QString &text, const QRegularExpression &startExpression,
-                                                  const QRegularExpression &endExpression, int state)
-{
-    int startIndex = 0;
-    if (previousBlockState() == state)
-    {
-        startIndex = 0;
-    }
-    else
-    {
-        startIndex = text.indexOf(startExpression);
-    }
-
-    while (startIndex >= 0)
-    {
-        QRegularExpressionMatch endMatch = endExpression.match(text, startIndex);
-        int endIndex = endMatch.capturedStart();
-        int commentLength;
-
-        if (endIndex == -1)
-        {
-            setCurrentBlockState(state);
-            commentLength = text.length() - startIndex;
-        }
-        else
-        {
-            commentLength = endIndex - startIndex + endMatch.capturedLength();
-        }
-
-        setFormat(startIndex, commentLength, getFormat("comment"));
-        startIndex = text.indexOf(startExpression, startIndex + commentLength);
-    }
+    tokenFormats[Lexer::Number] = format;
 }
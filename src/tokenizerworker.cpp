@@ -0,0 +1,34 @@
+#include "tokenizerworker.h"
+
+TokenizerWorker::TokenizerWorker(const Lexer *lexer, const QStringList &texts, int startState, int firstBlock,
+                                 int request, QObject *parent)
+    : QObject(parent), lexer(lexer), texts(texts), startState(startState), firstBlock(firstBlock), request(request), cancelled(false)
+{
+}
+
+TokenizerWorker::~TokenizerWorker() = default;
+
+void TokenizerWorker::cancel()
+{
+    cancelled.store(true);
+}
+
+void TokenizerWorker::run()
+{
+    QVector<TokenizedBlock> blocks;
+    blocks.reserve(texts.size());
+
+    int state = startState;
+    for (const QString &text : texts)
+    {
+        if (isCancelled())
+            return;
+
+        TokenizedBlock block;
+        state = lexer->tokenize(text, state, block.tokens);
+        block.endState = state;
+        blocks.append(std::move(block));
+    }
+
+    emit finished(request, firstBlock, startState, blocks);
+}
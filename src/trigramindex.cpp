@@ -0,0 +1,416 @@
+#include "trigramindex.h"
+#include "piecetable.h"
+
+#include <QVarLengthArray>
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+    char16_t foldCase(char16_t c)
+    {
+        if (c < 0x80)
+            return (c >= u'A' && c <= u'Z') ? char16_t(c | 0x20) : c;
+        if (QChar::isSurrogate(c))
+            return c;
+        return char16_t(QChar::toCaseFolded(c));
+    }
+
+    // Maps a 32-bit hash onto [0, bitCount) without a division
+    quint32 bitIndex(quint32 hash, quint32 bitCount)
+    {
+        return quint32((quint64(hash) * bitCount) >> 32);
+    }
+
+    bool testBit(const quint64 *bits, quint32 index)
+    {
+        return bits[index / 64] & (quint64(1) << (index % 64));
+    }
+
+    bool isAllowedClassEscape(QChar c)
+    {
+        // Classes that never match a line feed
+        return c == QLatin1Char('d') || c == QLatin1Char('w') || c == QLatin1Char('S');
+    }
+}
+
+TrigramIndex::TrigramIndex()
+    : heapWords(0), indexedLength(0), memoryLimit(DefaultMemoryLimit), built(false)
+{
+}
+
+TrigramIndex::TrigramIndex(const TrigramIndex &other) = default;
+
+TrigramIndex::~TrigramIndex() = default;
+
+TrigramIndex::LineSignature::LineSignature(const LineSignature &other)
+    : length(other.length), wordCount(other.wordCount), inlineWord(other.inlineWord)
+{
+    if (wordCount > 1)
+    {
+        words = new quint64[std::size_t(wordCount)];
+        std::copy(other.words, other.words + wordCount, words);
+    }
+}
+
+TrigramIndex::LineSignature::LineSignature(LineSignature &&other) noexcept
+    : length(other.length), wordCount(other.wordCount), inlineWord(other.inlineWord)
+{
+    other.wordCount = 0;
+}
+
+TrigramIndex::LineSignature &TrigramIndex::LineSignature::operator=(LineSignature &&other) noexcept
+{
+    if (this != &other)
+    {
+        if (wordCount > 1)
+            delete[] words;
+        length = other.length;
+        wordCount = other.wordCount;
+        inlineWord = other.inlineWord;
+        other.wordCount = 0;
+    }
+    return *this;
+}
+
+TrigramIndex::LineSignature::~LineSignature()
+{
+    if (wordCount > 1)
+        delete[] words;
+}
+
+void TrigramIndex::invalidate()
+{
+    drop();
+}
+
+void TrigramIndex::drop()
+{
+    std::vector<LineSignature>().swap(lines);
+    heapWords = 0;
+    indexedLength = 0;
+    built = false;
+}
+
+void TrigramIndex::update(const PieceTable &table, qsizetype position, qsizetype charsRemoved, QStringView insertedText)
+{
+    if (!built)
+        return;
+
+    // Text before the edit is unchanged, so its line is found in the new table
+    qsizetype firstLine = table.lineAt(position);
+    qsizetype offset = position - table.lineStart(firstLine);
+    if (firstLine >= qsizetype(lines.size()))
+    {
+        drop();
+        return;
+    }
+
+    // The stored line lengths tell how many old lines the removal spanned
+    qsizetype lastLine = firstLine;
+    qsizetype remaining = charsRemoved;
+    while (remaining > lines[lastLine].length - offset && lastLine + 1 < qsizetype(lines.size()))
+    {
+        remaining -= lines[lastLine].length - offset + 1;
+        offset = 0;
+        ++lastLine;
+    }
+
+    qsizetype oldCount = lastLine - firstLine + 1;
+    qsizetype newCount = insertedText.count(QLatin1Char('\n')) + 1;
+    if (qsizetype(lines.size()) - oldCount + newCount != table.lineCount())
+    {
+        // Out of step with the table; start over on the next query
+        drop();
+        return;
+    }
+
+    for (qsizetype i = firstLine; i <= lastLine; ++i)
+    {
+        heapWords -= lines[i].wordCount > 1 ? lines[i].wordCount : 0;
+    }
+
+    auto first = lines.begin() + firstLine;
+    if (newCount < oldCount)
+    {
+        lines.erase(first + newCount, first + oldCount);
+    }
+    else if (newCount > oldCount)
+    {
+        std::vector<LineSignature> added(std::size_t(newCount - oldCount));
+        lines.insert(first + oldCount, std::make_move_iterator(added.begin()), std::make_move_iterator(added.end()));
+    }
+
+    for (qsizetype i = 0; i < newCount; ++i)
+    {
+        lines[firstLine + i] = makeSignature(table.lineText(firstLine + i));
+    }
+    indexedLength = table.length();
+
+    if (memoryUsage() > memoryLimit)
+    {
+        drop();
+    }
+}
+
+bool TrigramIndex::candidateLines(QStringView literal, QVector<int> &candidates, QVector<qsizetype> *lineStarts) const
+{
+    candidates.clear();
+    if (lineStarts)
+        lineStarts->clear();
+    if (!built || literal.size() < 3 || literal.contains(QLatin1Char('\n')))
+        return false;
+
+    // Each trigram sets two bits, taken from the two halves of its hash
+    QVarLengthArray<quint64, 64> hashes;
+    for (qsizetype i = 0; i + 2 < literal.size(); ++i)
+    {
+        char16_t a = literal[i].unicode();
+        char16_t b = literal[i + 1].unicode();
+        char16_t c = literal[i + 2].unicode();
+
+        // Surrogates fold as pairs in a case-insensitive match; leaving out
+        // their trigrams only widens the candidates
+        if (QChar::isSurrogate(a) || QChar::isSurrogate(b) || QChar::isSurrogate(c))
+            continue;
+        hashes.append(trigramHash(foldCase(a), foldCase(b), foldCase(c)));
+    }
+
+    qsizetype lineStart = 0;
+    for (std::size_t line = 0; line < lines.size(); ++line)
+    {
+        const LineSignature &signature = lines[line];
+        qsizetype start = lineStart;
+        lineStart += signature.length + 1;
+        if (signature.length < literal.size())
+            continue;
+
+        const quint64 *bits = signature.bits();
+        quint32 bitCount = quint32(signature.wordCount) * 64;
+        bool candidate = true;
+        for (quint64 hash : hashes)
+        {
+            if (!testBit(bits, bitIndex(quint32(hash), bitCount)) ||
+                !testBit(bits, bitIndex(quint32(hash >> 32), bitCount)))
+            {
+                candidate = false;
+                break;
+            }
+        }
+        if (candidate)
+        {
+            candidates.append(int(line));
+            if (lineStarts)
+                lineStarts->append(start);
+        }
+    }
+    return true;
+}
+
+bool TrigramIndex::build(QStringView text, const std::atomic<bool> *cancelled)
+{
+    drop();
+
+    // Estimate first so an oversized document is not signed just to be dropped
+    qint64 estimate = qint64(text.size()) * BitsPerTrigram / 8;
+    if (estimate > memoryLimit)
+        return false;
+
+    qsizetype start = 0;
+    while (true)
+    {
+        qsizetype end = text.indexOf(QLatin1Char('\n'), start);
+        lines.push_back(makeSignature(text.mid(start, (end < 0 ? text.size() : end) - start)));
+        if (end < 0)
+            break;
+        start = end + 1;
+
+        if (lines.size() % 4096 == 0 && ((cancelled && cancelled->load()) || memoryUsage() > memoryLimit))
+        {
+            drop();
+            return false;
+        }
+    }
+
+    if (memoryUsage() > memoryLimit)
+    {
+        drop();
+        return false;
+    }
+
+    indexedLength = text.size();
+    built = true;
+    return true;
+}
+
+TrigramIndex::LineSignature TrigramIndex::makeSignature(QStringView line)
+{
+    LineSignature signature;
+    signature.length = int(line.size());
+    if (line.size() < 3)
+        return signature;
+
+    qsizetype trigrams = line.size() - 2;
+    signature.wordCount = int((trigrams * BitsPerTrigram + 63) / 64);
+    quint64 *bits = &signature.inlineWord;
+    if (signature.wordCount > 1)
+    {
+        signature.words = new quint64[std::size_t(signature.wordCount)]();
+        bits = signature.words;
+        heapWords += signature.wordCount;
+    }
+
+    quint32 bitCount = quint32(signature.wordCount) * 64;
+    const char16_t *data = line.utf16();
+    char16_t a = foldCase(data[0]);
+    char16_t b = foldCase(data[1]);
+    for (qsizetype i = 2; i < line.size(); ++i)
+    {
+        char16_t c = foldCase(data[i]);
+        quint64 hash = trigramHash(a, b, c);
+        quint32 low = bitIndex(quint32(hash), bitCount);
+        quint32 high = bitIndex(quint32(hash >> 32), bitCount);
+        bits[low / 64] |= quint64(1) << (low % 64);
+        bits[high / 64] |= quint64(1) << (high % 64);
+        a = b;
+        b = c;
+    }
+    return signature;
+}
+
+quint64 TrigramIndex::trigramHash(char16_t a, char16_t b, char16_t c)
+{
+    // Finalizer of MurmurHash3 over the packed trigram
+    quint64 key = (quint64(a) << 32) | (quint64(b) << 16) | quint64(c);
+    key ^= key >> 33;
+    key *= Q_UINT64_C(0xff51afd7ed558ccd);
+    key ^= key >> 33;
+    key *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+    key ^= key >> 33;
+    return key;
+}
+
+qint64 TrigramIndex::memoryUsage() const
+{
+    return qint64(lines.capacity()) * qint64(sizeof(LineSignature)) + heapWords * qint64(sizeof(quint64));
+}
+
+qint64 TrigramIndex::bytesPerMegabyte() const
+{
+    // Relative to the UTF-16 text the index covers
+    qint64 textBytes = qint64(indexedLength) * qint64(sizeof(QChar));
+    return textBytes > 0 ? memoryUsage() * 1024 * 1024 / textBytes : 0;
+}
+
+QString TrigramIndex::requiredLiteral(const QString &pattern)
+{
+    // Only literal runs outside groups count, and any construct that could
+    // match a line feed, anchor to the document or branch disqualifies the
+    // pattern, so every match lies within one line and contains the literal
+    QString best;
+    QString run;
+    int depth = 0;
+    auto endRun = [&]()
+    {
+        if (run.size() > best.size())
+            best = run;
+        run.clear();
+    };
+
+    for (qsizetype i = 0; i < pattern.size(); ++i)
+    {
+        QChar c = pattern.at(i);
+        switch (c.unicode())
+        {
+        case '\\':
+        {
+            if (i + 1 >= pattern.size())
+                return QString();
+            QChar escaped = pattern.at(++i);
+            if (escaped.isLetterOrNumber())
+            {
+                if (!isAllowedClassEscape(escaped) && escaped != QLatin1Char('b') && escaped != QLatin1Char('B'))
+                    return QString();
+                endRun();
+                continue;
+            }
+            c = escaped;
+            break;
+        }
+        case '|':
+        case '^':
+        case '$':
+            return QString();
+        case '(':
+            // Lookarounds and inline options such as (?s) are not simple
+            if (i + 1 < pattern.size() && pattern.at(i + 1) == QLatin1Char('?'))
+                return QString();
+            ++depth;
+            endRun();
+            continue;
+        case ')':
+            --depth;
+            endRun();
+            continue;
+        case '[':
+        {
+            qsizetype j = i + 1;
+            if (j < pattern.size() && pattern.at(j) == QLatin1Char('^'))
+                return QString();
+            if (j < pattern.size() && pattern.at(j) == QLatin1Char(']'))
+                ++j;
+            for (; j < pattern.size() && pattern.at(j) != QLatin1Char(']'); ++j)
+            {
+                if (pattern.at(j) == QLatin1Char('\\'))
+                {
+                    if (j + 1 >= pattern.size())
+                        return QString();
+                    QChar escaped = pattern.at(++j);
+                    if (escaped.isLetterOrNumber() && !isAllowedClassEscape(escaped))
+                        return QString();
+                }
+                else if (pattern.at(j) == QLatin1Char('[') && j + 1 < pattern.size() && pattern.at(j + 1) == QLatin1Char(':'))
+                {
+                    return QString();
+                }
+            }
+            if (j >= pattern.size())
+                return QString();
+            i = j;
+            endRun();
+            continue;
+        }
+        case '.':
+        case '+':
+            endRun();
+            continue;
+        case '*':
+        case '?':
+        case '{':
+            // The quantified character may be absent
+            if (!run.isEmpty())
+                run.chop(1);
+            endRun();
+            if (c == QLatin1Char('{'))
+            {
+                qsizetype close = pattern.indexOf(QLatin1Char('}'), i);
+                if (close < 0)
+                    return QString();
+                i = close;
+            }
+            continue;
+        default:
+            break;
+        }
+
+        if (c == QLatin1Char('\n') || c == QLatin1Char('\r'))
+            return QString();
+        if (depth == 0)
+        {
+            run.append(c);
+        }
+    }
+    endRun();
+
+    return best.size() >= 3 ? best : QString();
+}
@@ -0,0 +1,178 @@
+#include "lexer.h"
+
+#include <QtTest>
+
+namespace
+{
+    // Tokens as "class start length" runs, which read well in a failed compare
+    QString describe(const QVector<Token> &tokens)
+    {
+        static const char *const names[] = {"keyword", "string", "comment", "number"};
+        QStringList runs;
+        for (const Token &token : tokens)
+        {
+            runs.append(QStringLiteral("%1 %2 %3").arg(QLatin1String(names[token.tokenClass])).arg(token.start).arg(token.length));
+        }
+        return runs.join(QStringLiteral(", "));
+    }
+
+    // Lexes @p line from @p state, leaving the state the next line starts in
+    QString lex(const Lexer *lexer, const QString &line, int &state)
+    {
+        QVector<Token> tokens;
+        state = lexer->tokenize(line, state, tokens);
+        return describe(tokens);
+    }
+}
+
+/**
+ * @brief State transitions of the lexers across lines
+ */
+class TestLexer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void blockComment();
+    void blockCommentInOneLine();
+    void tripleQuotedStrings();
+    void singleQuotedStringEndsWithLine();
+    void markupComment();
+    void markupCData();
+    void cssDepth();
+    void cssCommentInsideBlock();
+};
+
+void TestLexer::blockComment()
+{
+    const Lexer *lexer = Lexer::cpp();
+    int state = 0;
+    QCOMPARE(lex(lexer, "int a; /* open", state), QString("keyword 0 3, comment 7 7"));
+    const int inComment = state;
+    QVERIFY(inComment != 0);
+
+    QCOMPARE(lex(lexer, "return 1;", state), QString("comment 0 9"));
+    QCOMPARE(state, inComment);
+
+    QCOMPARE(lex(lexer, "end */ return 0;", state), QString("comment 0 6, keyword 7 6, number 14 1"));
+    QCOMPARE(state, 0);
+}
+
+void TestLexer::blockCommentInOneLine()
+{
+    const Lexer *lexer = Lexer::cpp();
+    int state = 0;
+    QCOMPARE(lex(lexer, "/* a */ int /* b */", state), QString("comment 0 7, keyword 8 3, comment 12 7"));
+    QCOMPARE(state, 0);
+
+    // A line comment hides the opening of a block comment
+    QCOMPARE(lex(lexer, "// not /* open", state), QString("comment 0 14"));
+    QCOMPARE(state, 0);
+}
+
+void TestLexer::tripleQuotedStrings()
+{
+    const Lexer *lexer = Lexer::python();
+    int state = 0;
+    QCOMPARE(lex(lexer, "x = \"\"\"doc", state), QString("string 4 6"));
+    const int inDoubleQuotes = state;
+    QVERIFY(inDoubleQuotes != 0);
+
+    // The other quote does not close the string
+    QCOMPARE(lex(lexer, "it's ''' here", state), QString("string 0 13"));
+    QCOMPARE(state, inDoubleQuotes);
+
+    QCOMPARE(lex(lexer, "end\"\"\" + 1", state), QString("string 0 6, number 9 1"));
+    QCOMPARE(state, 0);
+
+    QCOMPARE(lex(lexer, "y = '''", state), QString("string 4 3"));
+    const int inSingleQuotes = state;
+    QVERIFY(inSingleQuotes != 0);
+    QVERIFY(inSingleQuotes != inDoubleQuotes);
+
+    QCOMPARE(lex(lexer, "\"\"\" still", state), QString("string 0 9"));
+    QCOMPARE(state, inSingleQuotes);
+
+    QCOMPARE(lex(lexer, "''' if", state), QString("string 0 3, keyword 4 2"));
+    QCOMPARE(state, 0);
+}
+
+void TestLexer::singleQuotedStringEndsWithLine()
+{
+    const Lexer *lexer = Lexer::python();
+    int state = 0;
+    QCOMPARE(lex(lexer, "s = 'open", state), QString("string 4 5"));
+    QCOMPARE(state, 0);
+}
+
+void TestLexer::markupComment()
+{
+    const Lexer *lexer = Lexer::markup();
+    int state = 0;
+    QCOMPARE(lex(lexer, "<a><!-- note", state), QString("keyword 0 2, keyword 2 1, comment 3 9"));
+    const int inComment = state;
+    QVERIFY(inComment != 0);
+
+    QCOMPARE(lex(lexer, "<b> is text", state), QString("comment 0 11"));
+    QCOMPARE(state, inComment);
+
+    QCOMPARE(lex(lexer, "--></a>", state), QString("comment 0 3, keyword 3 3, keyword 6 1"));
+    QCOMPARE(state, 0);
+}
+
+void TestLexer::markupCData()
+{
+    const Lexer *lexer = Lexer::markup();
+    int state = 0;
+    QCOMPARE(lex(lexer, "<![CDATA[ x < y", state), QString("keyword 0 9"));
+    const int inCData = state;
+    QVERIFY(inCData != 0);
+
+    // Markup inside the section is text
+    QCOMPARE(lex(lexer, "<!-- <tag>", state), QString());
+    QCOMPARE(state, inCData);
+
+    QCOMPARE(lex(lexer, "]]><b/>", state), QString("keyword 0 3, keyword 3 2, keyword 5 2"));
+    QCOMPARE(state, 0);
+}
+
+void TestLexer::cssDepth()
+{
+    const Lexer *lexer = Lexer::css();
+    int state = 0;
+    QCOMPARE(lex(lexer, "a {", state), QString("keyword 0 1"));
+    const int depthOne = state;
+    QVERIFY(depthOne != 0);
+
+    // Inside a block only property names are keywords
+    QCOMPARE(lex(lexer, "color: red; b {", state), QString("keyword 0 5, keyword 12 1"));
+    const int depthTwo = state;
+    QVERIFY(depthTwo != depthOne);
+
+    QCOMPARE(lex(lexer, "}", state), QString());
+    QCOMPARE(state, depthOne);
+    QCOMPARE(lex(lexer, "}", state), QString());
+    QCOMPARE(state, 0);
+
+    // Unbalanced closing braces do not go below the top level
+    QCOMPARE(lex(lexer, "} p", state), QString("keyword 2 1"));
+    QCOMPARE(state, 0);
+}
+
+void TestLexer::cssCommentInsideBlock()
+{
+    const Lexer *lexer = Lexer::css();
+    int state = 0;
+    QCOMPARE(lex(lexer, "a { /* {", state), QString("keyword 0 1, comment 4 4"));
+    const int inComment = state;
+
+    // Braces in the comment do not count
+    QCOMPARE(lex(lexer, "} }", state), QString("comment 0 3"));
+    QCOMPARE(state, inComment);
+
+    QCOMPARE(lex(lexer, "*/ width: 1px }", state), QString("comment 0 2, keyword 3 5, number 10 3"));
+    QCOMPARE(state, 0);
+}
+
+QTEST_APPLESS_MAIN(TestLexer)
+#include "tst_lexer.moc"
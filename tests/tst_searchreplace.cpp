@@ -0,0 +1,107 @@
+#include "editor.h"
+#include "searchreplace.h"
+
+#include <QElapsedTimer>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QtTest>
+
+namespace
+{
+    // @p count lines holding the needle, each followed by one that does not,
+    // so every match becomes a span of its own in replaceAll()
+    QString separatedMatches(int count)
+    {
+        QString text;
+        text.reserve(qsizetype(count) * 16);
+        for (int i = 0; i < count; ++i)
+        {
+            text += QStringLiteral("needle\nfiller\n");
+        }
+        return text;
+    }
+
+    int positionOfLine(Editor &editor, int line)
+    {
+        return editor.document()->findBlockByNumber(line).position();
+    }
+
+    // Replaces @p count matches while a finished search keeps its matches
+    // cached, which replaceAll() has to keep up to date
+    qint64 replaceAllMilliseconds(int count)
+    {
+        Editor editor;
+        editor.loadText(separatedMatches(count));
+        SearchReplace search;
+        search.find(&editor, QStringLiteral("needle"), SearchReplace::CaseSensitive);
+        if (!QTest::qWaitFor([&]()
+                             { return search.getTotalMatches() == count; }, 60000))
+            return -1;
+
+        QElapsedTimer timer;
+        timer.start();
+        int replaced = search.replaceAll(&editor, QStringLiteral("needle"), QStringLiteral("pin"), SearchReplace::CaseSensitive);
+        qint64 elapsed = timer.elapsed();
+        return replaced == count ? elapsed : -1;
+    }
+}
+
+/**
+ * @brief Match cache maintenance across edits and replace all
+ */
+class TestSearchReplace : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void editsUpdateCachedMatches();
+    void replaceAllScalesLinearly();
+};
+
+void TestSearchReplace::editsUpdateCachedMatches()
+{
+    Editor editor;
+    editor.loadText(separatedMatches(1000));
+    SearchReplace search;
+    search.find(&editor, QStringLiteral("needle"), SearchReplace::CaseSensitive);
+    QTRY_COMPARE(search.getTotalMatches(), 1000);
+
+    // A match added on line 501 shifts the ones below it
+    QTextCursor cursor(editor.document()->findBlockByNumber(501));
+    cursor.insertText(QStringLiteral("needle "));
+    QTRY_COMPARE(search.getTotalMatches(), 1001);
+
+    // A removed line takes its match with it and pulls the rest up
+    cursor = QTextCursor(editor.document()->findBlockByNumber(10));
+    cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+    QTRY_COMPARE(search.getTotalMatches(), 1000);
+
+    // Line 501 moved up to 500
+    cursor = QTextCursor(editor.document()->findBlockByNumber(499));
+    editor.setTextCursor(cursor);
+    QVERIFY(search.findNext(&editor));
+    QCOMPARE(search.getCurrentResult().startPosition, positionOfLine(editor, 500));
+    QCOMPARE(search.getCurrentResult().lineNumber, 500);
+
+    cursor = QTextCursor(editor.document()->findBlockByNumber(1500));
+    editor.setTextCursor(cursor);
+    QVERIFY(search.findNext(&editor));
+    QCOMPARE(search.getCurrentResult().startPosition, positionOfLine(editor, 1501));
+    QCOMPARE(search.getCurrentResult().lineNumber, 1501);
+}
+
+void TestSearchReplace::replaceAllScalesLinearly()
+{
+    // Ten times the matches should take about ten times as long; a cache
+    // rebuilt per span would take a hundred times
+    qint64 small = replaceAllMilliseconds(100000);
+    qint64 large = replaceAllMilliseconds(1000000);
+    QVERIFY(small >= 0);
+    QVERIFY(large >= 0);
+    qInfo("replace all: 100k matches in %lld ms, 1M matches in %lld ms", small, large);
+    QVERIFY2(large <= qMax<qint64>(small, 50) * 30, "replace all grows faster than linearly");
+}
+
+QTEST_MAIN(TestSearchReplace)
+#include "tst_searchreplace.moc"
@@ -0,0 +1,138 @@
+#include "syntaxhighlighter.h"
+
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QtTest>
+
+namespace
+{
+    // Counts the blocks the highlighter re-applies formats to
+    class CountingHighlighter : public SyntaxHighlighter
+    {
+    public:
+        using SyntaxHighlighter::SyntaxHighlighter;
+
+        int calls = 0;
+
+    protected:
+        void highlightBlock(const QString &text) override
+        {
+            ++calls;
+            SyntaxHighlighter::highlightBlock(text);
+        }
+    };
+
+    QString cppLines(int count)
+    {
+        QStringList lines;
+        for (int i = 0; i < count; ++i)
+        {
+            lines.append(QStringLiteral("int value%1 = 42; // note").arg(i));
+        }
+        return lines.join(QLatin1Char('\n'));
+    }
+
+    void insertAtLine(QTextDocument &document, int line, const QString &text)
+    {
+        QTextCursor cursor(document.findBlockByNumber(line));
+        cursor.insertText(text);
+    }
+}
+
+/**
+ * @brief Number of blocks highlighted again after an edit
+ */
+class TestSyntaxHighlighter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void initialPassHighlightsEveryBlock();
+    void typingHighlightsOneBlock();
+    void newLineHighlightsTheNewBlocks();
+    void openCommentHighlightsTheBlocksBelow();
+    void closedCommentStopsWhereStatesMeet();
+
+private:
+    static constexpr int LineCount = 2000;
+
+    std::unique_ptr<QTextDocument> document;
+    std::unique_ptr<CountingHighlighter> highlighter;
+};
+
+void TestSyntaxHighlighter::init()
+{
+    document = std::make_unique<QTextDocument>();
+    document->setPlainText(cppLines(LineCount));
+    highlighter = std::make_unique<CountingHighlighter>(document.get());
+    highlighter->setLanguage(SyntaxHighlighter::CPlusPlus);
+    QTRY_VERIFY(highlighter->isHighlightComplete());
+}
+
+void TestSyntaxHighlighter::cleanup()
+{
+    highlighter.reset();
+    document.reset();
+}
+
+void TestSyntaxHighlighter::initialPassHighlightsEveryBlock()
+{
+    highlighter->calls = 0;
+    highlighter->scheduleRehighlight();
+    QTRY_VERIFY(highlighter->isHighlightComplete());
+    QCOMPARE(highlighter->calls, LineCount);
+}
+
+void TestSyntaxHighlighter::typingHighlightsOneBlock()
+{
+    highlighter->calls = 0;
+    insertAtLine(*document, 1000, QStringLiteral("x"));
+    QTRY_VERIFY(highlighter->isHighlightComplete());
+    QCOMPARE(highlighter->calls, 1);
+}
+
+void TestSyntaxHighlighter::newLineHighlightsTheNewBlocks()
+{
+    highlighter->calls = 0;
+    insertAtLine(*document, 1000, QStringLiteral("int a;\n"));
+    QTRY_VERIFY(highlighter->isHighlightComplete());
+    QCOMPARE(highlighter->calls, 2);
+}
+
+void TestSyntaxHighlighter::openCommentHighlightsTheBlocksBelow()
+{
+    // Every block from the edit to the end of the document changes state
+    highlighter->calls = 0;
+    insertAtLine(*document, 500, QStringLiteral("/*"));
+    QTRY_VERIFY(highlighter->isHighlightComplete());
+    QCOMPARE(highlighter->calls, LineCount - 500);
+
+    const QTextBlock last = document->lastBlock();
+    QVERIFY(!last.layout()->formats().isEmpty());
+    QCOMPARE(last.layout()->formats().constFirst().length, last.length() - 1);
+}
+
+void TestSyntaxHighlighter::closedCommentStopsWhereStatesMeet()
+{
+    insertAtLine(*document, 510, QStringLiteral("end */ "));
+    QTRY_VERIFY(highlighter->isHighlightComplete());
+
+    // Blocks 500 to 510 change; from 511 on the states are as before
+    highlighter->calls = 0;
+    insertAtLine(*document, 500, QStringLiteral("/*"));
+    QTRY_VERIFY(highlighter->isHighlightComplete());
+    QCOMPARE(highlighter->calls, 11);
+
+    highlighter->calls = 0;
+    QTextCursor cursor(document->findBlockByNumber(500));
+    cursor.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor, 2);
+    cursor.removeSelectedText();
+    QTRY_VERIFY(highlighter->isHighlightComplete());
+    QCOMPARE(highlighter->calls, 11);
+}
+
+QTEST_MAIN(TestSyntaxHighlighter)
+#include "tst_syntaxhighlighter.moc"